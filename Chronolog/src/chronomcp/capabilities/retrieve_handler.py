@@ -1,22 +1,35 @@
 # capabilities/retrieve_interaction.py
+import struct
 import utils.config as config
 import utils.helpers as helpers
-import re
 from datetime import datetime
 
 async def retrieve_interaction(
     chronicle_name: str = None,
     story_name: str = None,
     start_time: str = None,
-    end_time: str = None
+    end_time: str = None,
+    limit: int = None,
+    cursor: str = None
 ) -> str:
     chronicle = chronicle_name or config.DEFAULT_CHRONICLE
     story     = story_name     or config.DEFAULT_STORY
 
+    if config.READER_DAEMON:
+        try:
+            records, next_cursor = _read_from_daemon(chronicle, story, start_time, end_time, limit, cursor)
+            return _write_records(chronicle, story, records, next_cursor)
+        except ValueError as e:
+            return f"Reader error: {e}"
+        except (OSError, RuntimeError) as e:
+            # fall back to a one-shot reader run
+            config.logging.warning(f"reader daemon unavailable: {e}")
+
     cmd = [
         "stdbuf", "-o0",
         config.READER_BINARY,
         "-c", config.CONFIG_FILE,
+        "-f", "columnar",
         "-C", chronicle,
         "-S", story
     ]
@@ -26,10 +39,44 @@ async def retrieve_interaction(
     if end_time:
         et_ns = helpers.parse_time_arg(end_time, is_end=True)
         cmd += ["-et", et_ns]
+    # one page of `limit` records; `cursor` continues after the previous page
+    if limit:
+        cmd += ["-n", str(int(limit))]
+    if cursor:
+        cmd += ["-a", cursor]
+
+    out, err = helpers.run_reader(cmd, text=False)
+
+    try:
+        batches, next_cursor = helpers.read_columnar(out)
+    except (ValueError, struct.error) as e:
+        return f"Reader error: {e} {err.decode(errors='replace').strip()}"
+    records = [bytes(record).decode(errors="replace") for batch in batches for record in batch["records"]]
+    return _write_records(chronicle, story, records, next_cursor)
+
+
+def _read_from_daemon(chronicle, story, start_time, end_time, limit, cursor):
+    daemon = helpers.reader_daemon(config.READER_BINARY, config.CONFIG_FILE)
+    arguments = {"chronicle": chronicle, "story": story}
+    if start_time:
+        arguments["start_time"] = helpers.parse_time_arg(start_time, is_end=False)
+    if end_time:
+        arguments["end_time"] = helpers.parse_time_arg(end_time, is_end=True)
+    records = []
+    while True:
+        if cursor:
+            arguments["cursor"] = cursor
+        if limit:
+            arguments["limit"] = int(limit) - len(records)
+        page = daemon.call("read_story", arguments)
+        records += [event["record"] for event in page["events"]]
+        cursor = page.get("next_cursor")
+        # without a limit every page is fetched, as the one-shot reader returns the whole range
+        if not cursor or (limit and len(records) >= int(limit)):
+            return records, cursor
 
-    out, err = helpers.run_reader(cmd)
 
-    records = re.findall(r'record="([^"]*)"', out)
+def _write_records(chronicle, story, records, next_cursor):
     if not records:
         return "No records found."
 
@@ -37,4 +84,6 @@ async def retrieve_interaction(
     filename = f"records_{chronicle}_{story}_{ts}.txt"
     with open(filename, "w") as f:
         f.write("\n".join(records))
+    if next_cursor:
+        return f"{filename}\nnext_cursor={next_cursor}"
     return filename
@@ -0,0 +1,62 @@
+#ifndef CHRONOLOG_ARCHIVEFILEFORMAT_H
+#define CHRONOLOG_ARCHIVEFILEFORMAT_H
+
+#include <cstdint>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <H5Cpp.h>
+
+#define STORY_CHUNK_DATASET "/story_chunks/data.vlen_bytes"
+
+namespace chronolog
+{
+
+// On-disk layout of one archived event. Rows of a story file are stored in
+// (eventTime, clientId, eventIndex) order, the order of the chunk they were
+// archived from.
+struct LogEventHVL
+{
+    uint64_t storyId;
+    uint64_t eventTime;
+    uint32_t clientId;
+    uint32_t eventIndex;
+    hvl_t logRecord;
+};
+
+inline H5::CompType createLogEventType()
+{
+    H5::CompType type(sizeof(LogEventHVL));
+    type.insertMember("storyId", HOFFSET(LogEventHVL, storyId), H5::PredType::NATIVE_UINT64);
+    type.insertMember("eventTime", HOFFSET(LogEventHVL, eventTime), H5::PredType::NATIVE_UINT64);
+    type.insertMember("clientId", HOFFSET(LogEventHVL, clientId), H5::PredType::NATIVE_UINT32);
+    type.insertMember("eventIndex", HOFFSET(LogEventHVL, eventIndex), H5::PredType::NATIVE_UINT32);
+    type.insertMember("logRecord", HOFFSET(LogEventHVL, logRecord), H5::VarLenType(H5::PredType::NATIVE_UINT8));
+    return type;
+}
+
+// HDF5 may only be called by one thread at a time unless it is built
+// thread-safe, and then it serializes on a global lock anyway. All HDF5 calls
+// of the reader, including destroying HDF5 objects, go through this lock.
+inline std::mutex &hdf5Mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Starts the kernel reading [offset, offset + length) of the file, so tasks
+// waiting for the HDF5 lock keep the storage busy in the meantime
+inline void prefetchRange(const std::string &file_name, uint64_t offset, uint64_t length)
+{
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+} // chronolog
+
+#endif //CHRONOLOG_ARCHIVEFILEFORMAT_H
@@ -0,0 +1,255 @@
+#include <charconv>
+#include <vector>
+
+#include "EventWriter.h"
+
+namespace chronolog
+{
+
+namespace
+{
+
+constexpr char kColumnarMagic[8] = {'C', 'H', 'R', 'C', 'O', 'L', '0', '1'};
+constexpr uint32_t kColumnarVersion = 1;
+// rows per columnar batch; a batch with fewer rows is written once the read ends
+constexpr size_t kColumnarBatchRows = 65536;
+
+class TextEventWriter: public EventWriter
+{
+public:
+    explicit TextEventWriter(FILE* out)
+        : EventWriter(out)
+    {}
+
+    void write(LogEvent const &event) override
+    {
+        append("  storyId=");
+        appendNumber(event.storyId);
+        append(", time=");
+        appendNumber(event.eventTime);
+        append(", clientId=");
+        appendNumber(event.clientId);
+        append(", index=");
+        appendNumber(event.eventIndex);
+        append(", record=\"");
+        append(event.logRecord);
+        append("\"\n");
+    }
+
+    void finish(size_t count, StoryEventCursor const *next) override
+    {
+        appendNumber(count);
+        append(" event(s) returned.\n");
+        if(next) {
+            append("next_cursor=" + next->toString() + "\n");
+        }
+        flush();
+    }
+};
+
+class NdjsonEventWriter: public EventWriter
+{
+public:
+    explicit NdjsonEventWriter(FILE* out)
+        : EventWriter(out)
+    {}
+
+    // 64-bit ids and times are written as JSON integers; readers that keep them exact (Python's json does)
+    // need no string round trip
+    void write(LogEvent const &event) override
+    {
+        append("{\"story_id\":");
+        appendNumber(event.storyId);
+        append(",\"time\":");
+        appendNumber(event.eventTime);
+        append(",\"client_id\":");
+        appendNumber(event.clientId);
+        append(",\"index\":");
+        appendNumber(event.eventIndex);
+        append(",\"record\":\"");
+        appendEscaped(event.logRecord);
+        append("\"}\n");
+    }
+
+    void finish(size_t count, StoryEventCursor const *next) override
+    {
+        append("{\"count\":");
+        appendNumber(count);
+        append(",\"next_cursor\":");
+        append(next ? "\"" + next->toString() + "\"" : std::string("null"));
+        append("}\n");
+        flush();
+    }
+
+private:
+    // Escapes quotes, backslashes and control characters; other bytes are copied as they are
+    void appendEscaped(const std::string &text)
+    {
+        static char const hex[] = "0123456789abcdef";
+        size_t copied = 0;
+        for(size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if(c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            append(text.data() + copied, i - copied);
+            copied = i + 1;
+            switch(c) {
+                case '"': append("\\\""); break;
+                case '\\': append("\\\\"); break;
+                case '\n': append("\\n"); break;
+                case '\r': append("\\r"); break;
+                case '\t': append("\\t"); break;
+                default: {
+                    char escape[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                    append(escape, sizeof(escape));
+                }
+            }
+        }
+        append(text.data() + copied, text.size() - copied);
+    }
+};
+
+class ColumnarEventWriter: public EventWriter
+{
+public:
+    explicit ColumnarEventWriter(FILE* out)
+        : EventWriter(out)
+    {
+        uint32_t header[2] = {kColumnarVersion, 0};
+        append(kColumnarMagic, sizeof(kColumnarMagic));
+        append(reinterpret_cast<char const*>(header), sizeof(header));
+    }
+
+    void write(LogEvent const &event) override
+    {
+        story_ids_.push_back(event.storyId);
+        times_.push_back(event.eventTime);
+        client_ids_.push_back(event.clientId);
+        indices_.push_back(event.eventIndex);
+        records_.append(event.logRecord);
+        record_ends_.push_back(records_.size());
+        if(story_ids_.size() == kColumnarBatchRows || records_.size() >= kBufferSize) {
+            writeBatch();
+        }
+    }
+
+    void finish(size_t, StoryEventCursor const *next) override
+    {
+        if(!story_ids_.empty()) {
+            writeBatch();
+        }
+        std::string cursor = next ? next->toString() : std::string();
+        appendColumn(std::vector<uint64_t>{0, cursor.size()});
+        append(cursor);
+        pad();
+        flush();
+    }
+
+private:
+    template <typename T>
+    void appendColumn(std::vector<T> const &column)
+    {
+        append(reinterpret_cast<char const*>(column.data()), column.size() * sizeof(T));
+    }
+
+    void pad()
+    {
+        static char const zeros[8] = {};
+        append(zeros, (8 - (written_ + buffer_.size()) % 8) % 8);
+    }
+
+    void writeBatch()
+    {
+        appendColumn(std::vector<uint64_t>{story_ids_.size()});
+        appendColumn(story_ids_);
+        appendColumn(times_);
+        appendColumn(record_ends_);
+        appendColumn(client_ids_);
+        appendColumn(indices_);
+        pad();
+        append(records_);
+        pad();
+        story_ids_.clear();
+        times_.clear();
+        record_ends_.clear();
+        client_ids_.clear();
+        indices_.clear();
+        records_.clear();
+    }
+
+    std::vector<uint64_t> story_ids_;
+    std::vector<uint64_t> times_;
+    std::vector<uint64_t> record_ends_;
+    std::vector<uint32_t> client_ids_;
+    std::vector<uint32_t> indices_;
+    std::string records_;
+};
+
+} // namespace
+
+bool EventWriter::parseFormat(const std::string &name, Format &format)
+{
+    if(name == "text") {
+        format = Format::Text;
+    }
+    else if(name == "ndjson") {
+        format = Format::Ndjson;
+    }
+    else if(name == "columnar") {
+        format = Format::Columnar;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<EventWriter> EventWriter::create(Format format, FILE* out)
+{
+    switch(format) {
+        case Format::Ndjson:
+            return std::make_unique<NdjsonEventWriter>(out);
+        case Format::Columnar:
+            return std::make_unique<ColumnarEventWriter>(out);
+        case Format::Text:
+        default:
+            return std::make_unique<TextEventWriter>(out);
+    }
+}
+
+EventWriter::EventWriter(FILE* out)
+    : out_(out)
+{
+    buffer_.reserve(kBufferSize);
+}
+
+void EventWriter::append(char const* data, size_t size)
+{
+    buffer_.append(data, size);
+    if(buffer_.size() >= kBufferSize) {
+        drain();
+    }
+}
+
+void EventWriter::appendNumber(uint64_t value)
+{
+    char digits[20];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    append(digits, result.ptr - digits);
+}
+
+void EventWriter::drain()
+{
+    written_ += buffer_.size();
+    std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+    buffer_.clear();
+}
+
+void EventWriter::flush()
+{
+    drain();
+    std::fflush(out_);
+}
+
+} // chronolog
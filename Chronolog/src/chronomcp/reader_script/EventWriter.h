@@ -0,0 +1,80 @@
+#ifndef CHRONOLOG_EVENTWRITER_H
+#define CHRONOLOG_EVENTWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "StoryChunk.h"
+#include "StoryEventStream.h"
+
+namespace chronolog
+{
+
+// Writes the events of a read to a stdio stream in one of the reader's output
+// formats, buffering the output so it is handed to the stream in large
+// writes rather than per event.
+//
+// text      one "  storyId=..., time=..., ..." line per event, then
+//           "N event(s) returned." and "next_cursor=..." if more remain
+// ndjson    one JSON object per event, {"story_id":..,"time":..,"client_id":..,
+//           "index":..,"record":".."}, then {"count":N,"next_cursor":".."|null}
+// columnar  the binary column layout below
+//
+// Columnar layout (native byte order, every part 8-byte aligned):
+// "CHRCOL01", u32 version, u32 reserved, then batches of
+// u64 n, u64 storyId[n], u64 eventTime[n], u64 recordEnd[n], u32 clientId[n],
+// u32 eventIndex[n] and the concatenated record bytes, padded, where
+// recordEnd[i] is the end of record i within the batch's record bytes.
+// A batch with n = 0 ends the stream and is followed by u64 length and the
+// bytes of the next cursor, empty if the read returned everything. A reader
+// can map each column straight onto an array without parsing.
+class EventWriter
+{
+public:
+    enum class Format
+    {
+        Text,
+        Ndjson,
+        Columnar
+    };
+
+    static constexpr size_t kBufferSize = size_t(1) << 20;
+
+    static bool parseFormat(const std::string &name, Format &format);
+
+    static std::unique_ptr<EventWriter> create(Format format, FILE* out);
+
+    virtual ~EventWriter() = default;
+
+    EventWriter(EventWriter const &) = delete;
+    EventWriter &operator=(EventWriter const &) = delete;
+
+    virtual void write(LogEvent const &event) = 0;
+
+    // Ends the output after count events; next is where a following read continues, if more events remain
+    virtual void finish(size_t count, StoryEventCursor const *next) = 0;
+
+protected:
+    explicit EventWriter(FILE* out);
+
+    void append(char const* data, size_t size);
+    void append(char const* text) { append(text, std::strlen(text)); }
+    void append(const std::string &text) { append(text.data(), text.size()); }
+    void appendNumber(uint64_t value);
+    void flush();
+
+    FILE* out_;
+    std::string buffer_;
+    uint64_t written_ = 0;   // bytes handed to out_ so far
+
+private:
+    void drain();
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_EVENTWRITER_H
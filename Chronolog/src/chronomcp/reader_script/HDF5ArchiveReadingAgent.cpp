@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <poll.h>
+#include <thread>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "HDF5ArchiveReadingAgent.h"
+#include "chrono_monitor.h"
+
+namespace chronolog
+{
+
+namespace
+{
+
+// Events of one story file that fall in [start_time, end_time], in a chunk spanning
+// [chunk_start, chunk_end]; nullptr if the file can't be read. filter_all reads every row of every block, for
+// files whose rows are out of time order.
+StoryChunk* readStoryChunkFile(StoryFileCache &cache, const std::string &file_name,
+                               const ChronicleName &chronicle_name, const StoryName &story_name, uint64_t start_time,
+                               uint64_t end_time, uint64_t chunk_start, uint64_t chunk_end, bool filter_all = false)
+{
+    // only the blocks whose time range overlaps the query are read; filter_all asks for every block
+    uint64_t first_block = 0;
+    uint64_t end_block = 0;
+    bool sorted = true;
+    if(!cache.blockRange(file_name, filter_all ? 0 : start_time, filter_all ? kUnknownEndTime : end_time,
+                         first_block, end_block, sorted)) {
+        return nullptr;
+    }
+    sorted = sorted && !filter_all;
+    std::shared_ptr<StoryFileCache::Block const> block;
+    if(first_block < end_block && !(block = cache.block(file_name, first_block))) {
+        return nullptr;
+    }
+
+    StoryId story_id = !block || block->empty() ? 0 : block->front().storyId;
+    // chunk ranges are half-open
+    auto *chunk = new StoryChunk(chronicle_name, story_name, story_id, chunk_start,
+                                 chunk_end == kUnknownEndTime ? chunk_end : chunk_end + 1);
+    for(uint64_t block_index = first_block; block; ) {
+        if(sorted && !cache.inTimeOrder(file_name)) {
+            // the block showed the rows are out of time order after all, so the file is read again in full
+            delete chunk;
+            return readStoryChunkFile(cache, file_name, chronicle_name, story_name, start_time, end_time,
+                                      chunk_start, chunk_end, true);
+        }
+        // rows out of time order can be anywhere in the file, so then every row is filtered
+        auto event = sorted ? std::lower_bound(block->begin(), block->end(), start_time,
+                                               [](LogEvent const &event, uint64_t time) {
+                                                   return event.eventTime < time;
+                                               })
+                            : block->begin();
+        for(; event != block->end(); ++event) {
+            if(event->eventTime > end_time) {
+                if(sorted) {
+                    return chunk;
+                }
+                continue;
+            }
+            if(event->eventTime >= start_time) {
+                chunk->insertEvent(*event);
+            }
+        }
+        if(++block_index >= end_block) {
+            break;
+        }
+        if(!(block = cache.block(file_name, block_index))) {
+            delete chunk;
+            return nullptr;
+        }
+    }
+    return chunk;
+}
+
+} // namespace
+
+int HDF5ArchiveReadingAgent::readArchivedStory(const ChronicleName &chronicle_name, const StoryName &story_name,
+                                               uint64_t start_time, uint64_t end_time,
+                                               std::list<StoryChunk*> &list_of_chunks)
+{
+    // only the files whose range overlaps the query are opened
+    std::vector<StoryFileEntry> files = findStoryFiles(chronicle_name, story_name, start_time, end_time);
+    LOG_DEBUG("[HDF5ArchiveReadingAgent] {} file(s) of {}.{} overlap [{}, {}]", files.size(), chronicle_name,
+              story_name, start_time, end_time);
+
+    // Files come in start-time order. Runs of files whose ranges overlap share one chunk so its events stay
+    // in time order; group[i] is the first file of the run file i belongs to.
+    std::vector<size_t> group(files.size());
+    std::vector<uint64_t> group_end(files.size());
+    for(size_t i = 0; i < files.size(); ++i) {
+        if(i > 0 && files[i].start_time <= group_end[group[i - 1]]) {
+            group[i] = group[i - 1];
+            group_end[group[i]] = std::max(group_end[group[i]], files[i].end_time);
+        }
+        else {
+            group[i] = i;
+            group_end[i] = files[i].end_time;
+        }
+    }
+
+    std::vector<StoryChunk*> chunks(files.size(), nullptr);
+    auto read_file = [&](size_t i) {
+        size_t first = group[i];
+        chunks[i] = readStoryChunkFile(file_cache_, files[i].file_name, chronicle_name, story_name,
+                                       std::max(start_time, files[i].start_time),
+                                       std::min(end_time, files[i].end_time),
+                                       std::max(start_time, files[first].start_time),
+                                       std::min(end_time, group_end[first]));
+    };
+    if(files.size() <= 1) {
+        for(size_t i = 0; i < files.size(); ++i) {
+            read_file(i);
+        }
+    }
+    else {
+        // one task per file; the read pool spreads them across its xstreams
+        std::call_once(read_streams_once_, [this]() { setUpReadStreams(); });
+        std::vector <tl::managed <tl::thread>> tasks;
+        tasks.reserve(files.size());
+        for(size_t i = 0; i < files.size(); ++i) {
+            tasks.push_back(read_pool_->make_thread([&read_file, i]() { read_file(i); }));
+        }
+        for(auto &task: tasks) {
+            task->join();
+        }
+    }
+
+    // fold every run into the chunk of its first readable file
+    for(size_t i = 0; i < files.size(); ++i) {
+        StoryChunk* &target = chunks[group[i]];
+        if(group[i] == i || chunks[i] == nullptr) {
+            continue;
+        }
+        if(target == nullptr) {
+            target = chunks[i];
+        }
+        else {
+            for(auto const &event: *chunks[i]) {
+                target->insertEvent(event.second);
+            }
+            delete chunks[i];
+        }
+        chunks[i] = nullptr;
+    }
+    for(size_t i = 0; i < files.size(); ++i) {
+        if(chunks[i] == nullptr) {
+            continue;
+        }
+        if(chunks[i]->getEventCount() == 0) {
+            delete chunks[i];
+            continue;
+        }
+        list_of_chunks.push_back(chunks[i]);
+    }
+    return 0;
+}
+
+int HDF5ArchiveReadingAgent::setUpReadStreams()
+{
+    unsigned count = read_stream_count_ != 0 ? read_stream_count_ : std::thread::hardware_concurrency();
+    read_pool_ = tl::pool::create(tl::pool::access::mpmc);
+    for(unsigned i = 0; i < std::max(count, 1u); ++i) {
+        read_streams_.push_back(tl::xstream::create(tl::scheduler::predef::basic_wait, *read_pool_));
+    }
+    LOG_DEBUG("[HDF5ArchiveReadingAgent] Reading story files on {} xstream(s).", read_streams_.size());
+    return 0;
+}
+
+int HDF5ArchiveReadingAgent::setUpFsMonitoring()
+{
+    archive_dir_monitoring_stream_ = tl::xstream::create();
+    archive_dir_monitoring_thread_ = archive_dir_monitoring_stream_->make_thread([this]() {
+        fsMonitoringThreadFunc();
+    });
+    return 0;
+}
+
+int HDF5ArchiveReadingAgent::fsMonitoringThreadFunc()
+{
+    int fd = inotify_init1(IN_NONBLOCK);
+    if(fd < 0) {
+        LOG_ERROR("[HDF5ArchiveReadingAgent] inotify_init1 failed: {}", strerror(errno));
+        return -1;
+    }
+    // A file is indexed once its writer closes it, not when it is created, so queries never see a story file
+    // the grapher is still writing; a file created or rewritten under a known name leaves the index until then
+    int wd = inotify_add_watch(fd, archive_path_.c_str(),
+                               IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+    if(wd < 0) {
+        LOG_ERROR("[HDF5ArchiveReadingAgent] Failed to watch {}: {}", archive_path_, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    // Events are coalesced into batches: a batch stays open while events keep arriving within
+    // kBatchQuietMs of each other, for at most kMaxBatchDelay, and is then applied as one index update
+    constexpr int kIdlePollMs = 100;
+    constexpr int kBatchQuietMs = 10;
+    constexpr auto kMaxBatchDelay = std::chrono::milliseconds(100);
+
+    alignas(struct inotify_event) char buffer[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    // net effect of the batch on each file name, true once it is complete; a rename within the directory is a
+    // removal and an addition, a move out of it a removal, so moves need no pairing. Every change, a close
+    // after writing included, drops the file's cached handles and blocks.
+    std::unordered_map<std::string, bool> changes;
+    size_t batch_events = 0;
+    std::chrono::steady_clock::time_point batch_start;
+    bool overflowed = false;
+    while(!stop_monitoring_) {
+        // wake up periodically so shutdown() can stop the thread
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, batch_events == 0 ? kIdlePollMs : kBatchQuietMs);
+        ssize_t length = ready > 0 ? read(fd, buffer, sizeof(buffer)) : 0;
+        for(char* ptr = buffer; ptr < buffer + std::max<ssize_t>(length, 0);) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            if(event->mask & IN_Q_OVERFLOW) {
+                overflowed = true;
+                continue;
+            }
+            if(event->len == 0) {
+                continue;
+            }
+            if(batch_events++ == 0) {
+                batch_start = std::chrono::steady_clock::now();
+            }
+            // same form as the paths directory_iterator produced for the initial scan
+            std::string file_name = (std::filesystem::path(archive_path_) / event->name).string();
+            changes[file_name] = (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0;
+        }
+        if(overflowed) {
+            // the rescan also covers the events of the open batch
+            rescanArchive();
+            changes.clear();
+            batch_events = 0;
+            overflowed = false;
+        }
+        else if(batch_events != 0 &&
+                (ready <= 0 || std::chrono::steady_clock::now() - batch_start >= kMaxBatchDelay)) {
+            applyFileChanges(changes, batch_events, batch_start);
+            changes.clear();
+            batch_events = 0;
+        }
+    }
+
+    inotify_rm_watch(fd, wd);
+    close(fd);
+    return 0;
+}
+
+} // chronolog
@@ -1,14 +1,28 @@
 #ifndef CHRONOLOG_HDF5ARCHIVEREADINGAGENT_H
 #define CHRONOLOG_HDF5ARCHIVEREADINGAGENT_H
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <map>
+#include <vector>
 #include <filesystem>
 #include <thallium.hpp>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "StoryChunkIngestionQueue.h"
+#include "StoryEventStream.h"
+#include "StoryFileCache.h"
+#include "StoryFileCatalog.h"
+#include "StoryFileIndex.h"
+#include "TraceRecorder.h"
 
 namespace tl = thallium;
 
@@ -18,29 +32,91 @@ namespace chronolog
 class HDF5ArchiveReadingAgent
 {
 public:
-    explicit HDF5ArchiveReadingAgent(std::string const &archive_path)
+    // Activity of the archive directory monitor. A batch is the directory events applied as one index update;
+    // lag is the time from reading a batch's first event to readers seeing its update.
+    struct MonitorStats
+    {
+        uint64_t events = 0;
+        uint64_t batches = 0;
+        uint64_t last_batch_size = 0;
+        uint64_t max_batch_size = 0;
+        uint64_t last_lag_ns = 0;
+        uint64_t max_lag_ns = 0;
+        uint64_t overflows = 0;   // times the kernel dropped events because the monitor fell behind, each rescanned
+    };
+
+    // read_stream_count xstreams read story files concurrently, created by the first readArchivedStory
+    // or stream that needs them; 0 uses one per core. cache_budget bounds the
+    // memory of decoded events kept for later queries.
+    explicit HDF5ArchiveReadingAgent(std::string const &archive_path, unsigned read_stream_count = 0,
+                                     size_t cache_budget = StoryFileCache::kDefaultMemoryBudget)
         : archive_path_(archive_path)
+        , file_cache_(cache_budget)
+        , read_stream_count_(read_stream_count)
     {}
 
     ~HDF5ArchiveReadingAgent() = default;
 
     int initialize()
     {
-        LOG_INFO("[HDF5ArchiveReadingAgent] Initializing,scanning archive path {} to create the map ...",
+        LOG_INFO("[HDF5ArchiveReadingAgent] Initializing,scanning archive path {} to create the index ...",
                  archive_path_);
-        createStartTimeFileNameMap();
+        createStoryFileIndex();
         return setUpFsMonitoring();
     }
 
     int shutdown()
     {
-        archive_dir_monitoring_stream_->join();
+        stop_monitoring_ = true;
         archive_dir_monitoring_thread_->join();
+        archive_dir_monitoring_stream_->join();
+        for(auto &stream: read_streams_) {
+            stream->join();
+        }
+        read_streams_.clear();
         return 0;
     }
 
+    // Reads the story files overlapping [start_time, end_time], one task per file on the read xstreams, and
+    // appends their events as chunks in time order
     int readArchivedStory(const ChronicleName&, const StoryName&, uint64_t, uint64_t, std::list<StoryChunk*>&);
 
+    // Events of [start_time, end_time] in time order, pulled one at a time; a valid cursor resumes after it.
+    // The blocks the stream reaches next are read ahead on the read xstreams.
+    std::unique_ptr<StoryEventStream> openStoryStream(const ChronicleName &chronicle_name, const StoryName &story_name,
+                                                      uint64_t start_time, uint64_t end_time,
+                                                      StoryEventCursor const &after = StoryEventCursor())
+    {
+        auto spawn = [this](std::function<void()> work) -> std::function<void()> {
+            std::call_once(read_streams_once_, [this]() { setUpReadStreams(); });
+            auto task = std::make_shared<tl::managed<tl::thread>>(read_pool_->make_thread(std::move(work)));
+            return [task]() { (*task)->join(); };
+        };
+        return std::make_unique<StoryEventStream>(file_cache_,
+                                                  findStoryFiles(chronicle_name, story_name, start_time, end_time),
+                                                  start_time, end_time, after, spawn);
+    }
+
+    // Passes the events of [start_time, end_time] after cursor to callback until it returns false or
+    // max_events (0: no limit) were delivered, and leaves cursor on the last one delivered. Returns the
+    // number of events delivered.
+    size_t streamArchivedStory(const ChronicleName &chronicle_name, const StoryName &story_name, uint64_t start_time,
+                               uint64_t end_time, std::function<bool(LogEvent const &)> const &callback,
+                               size_t max_events, StoryEventCursor &cursor)
+    {
+        auto stream = openStoryStream(chronicle_name, story_name, start_time, end_time, cursor);
+        size_t delivered = 0;
+        LogEvent event;
+        while((max_events == 0 || delivered < max_events) && stream->next(event)) {
+            ++delivered;
+            cursor = stream->cursor();
+            if(!callback(event)) {
+                break;
+            }
+        }
+        return delivered;
+    }
+
     static std::string getChronicleName(const std::string &file_name)
     {
         // Example file name: /home/kfeng/chronolog/Debug/output/chronicle_0_0.story_0_0.1736806500.vlen.h5
@@ -70,69 +146,186 @@ public:
         return std::stoull(start_time_str);
     }
 
+    static bool isStoryFile(const std::string &file_name)
+    {
+        // chronicle.story.start_time.vlen.h5; anything else in the directory is not ours
+        static const std::string suffix = ".vlen.h5";
+        std::string base_name = file_name.substr(file_name.find_last_of("/\\") + 1);
+        if(base_name.size() <= suffix.size() ||
+           base_name.compare(base_name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            return false;
+        }
+        size_t first_dot = base_name.find_first_of('.');
+        size_t second_dot = base_name.find_first_of('.', first_dot + 1);
+        size_t third_dot = base_name.find_first_of('.', second_dot + 1);
+        if(first_dot == 0 || second_dot == std::string::npos || third_dot == std::string::npos ||
+           third_dot == second_dot + 1 || second_dot == first_dot + 1) {
+            return false;
+        }
+        for(size_t i = second_dot + 1; i < third_dot; ++i) {
+            if(!std::isdigit(static_cast<unsigned char>(base_name[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static StoryFileInfo getStoryFileInfo(const std::string &file_name)
+    {
+        StoryFileInfo info;
+        info.chronicle_name = getChronicleName(file_name);
+        info.story_name = getStoryName(file_name);
+        info.start_time = getStartTime(file_name);
+        info.file_name = file_name;
+        return info;
+    }
+
+    std::vector<StoryFileEntry> findStoryFiles(const ChronicleName &chronicle_name, const StoryName &story_name,
+                                               uint64_t start_time, uint64_t end_time) const
+    {
+        TraceSpan span("index.lookup");
+        return story_file_index_.snapshot()->findFiles(chronicle_name, story_name, start_time, end_time);
+    }
+
+    size_t indexedFileCount() const { return story_file_index_.size(); }
+
+    StoryFileCache::Stats cacheStats() const { return file_cache_.stats(); }
+
+    // Drops the open files and decoded blocks, so the next reads start cold
+    void clearCache() { file_cache_.clear(); }
+
+    MonitorStats monitorStats() const
+    {
+        MonitorStats stats;
+        stats.events = monitor_events_;
+        stats.batches = monitor_batches_;
+        stats.last_batch_size = last_batch_size_;
+        stats.max_batch_size = max_batch_size_;
+        stats.last_lag_ns = last_lag_ns_;
+        stats.max_lag_ns = max_lag_ns_;
+        stats.overflows = monitor_overflows_;
+        return stats;
+    }
+
 private:
+    int setUpReadStreams();
+
     int setUpFsMonitoring();
 
     int fsMonitoringThreadFunc();
 
-    int createStartTimeFileNameMap()
+    // the tests drive applyFileChanges and rescanArchive directly
+    friend class HDF5ArchiveReadingAgentTest;
+
+    static bool parseStoryFile(const std::string &file_name, StoryFileInfo &info)
     {
-        // iterate over the HDF5 files in the archive directory to get the list of files
-        // update the start_time_file_name_map_ with the start time and file name
-        std::lock_guard<std::mutex> lock(start_time_file_name_map_mutex_);
-        for(const auto &entry : std::filesystem::directory_iterator(archive_path_)) {
-            std::string chronicle_name = getChronicleName(entry.path().string());
-            std::string story_name = getStoryName(entry.path().string());
-            uint64_t start_time = getStartTime(entry.path().string());
-            start_time_file_name_map_[std::make_tuple(chronicle_name, story_name, start_time)] = entry.path().string();
+        if(!isStoryFile(file_name)) {
+            return false;
         }
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] Created start_time_file_name_map_ with {} entries.",
-                  start_time_file_name_map_.size());
-        return 0;
+        info = getStoryFileInfo(file_name);
+        return true;
     }
 
-    int addFileToStartTimeFileNameMap(const std::string &file_name)
+    int createStoryFileIndex()
     {
-        std::lock_guard<std::mutex> lock(start_time_file_name_map_mutex_);
-        std::string chronicle_name = getChronicleName(file_name);
-        std::string story_name = getStoryName(file_name);
-        uint64_t start_time = getStartTime(file_name);
-        start_time_file_name_map_[std::make_tuple(chronicle_name, story_name, start_time)] = file_name;
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] Added file {} to start_time_file_name_map_.", file_name);
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] start_time_file_name_map_ has {} entries.",
-                  start_time_file_name_map_.size());
+        // the catalog remembers the last scan, so only files added or removed since are looked at
+        StoryFileCatalog catalog(archive_path_);
+        size_t changes = catalog.refresh(parseStoryFile);
+        StoryFileIndex::Update update;
+        update.added.reserve(catalog.entries().size());
+        for(const auto &entry: catalog.entries()) {
+            update.added.push_back(entry.info);
+        }
+        story_file_index_.apply(update);
+        LOG_DEBUG("[HDF5ArchiveReadingAgent] Created story file index with {} entries, {} changed since the last "
+                  "catalog {}.", story_file_index_.size(), changes, catalog.path());
         return 0;
     }
 
-    int removeFileFromStartTimeFileNameMap(const std::string &file_name)
+    // After the kernel dropped directory events: the index is brought in line with a rescan of the directory
+    // in one update, and the whole cache dropped, since any file may have been rewritten unseen
+    int rescanArchive()
     {
-        std::lock_guard<std::mutex> lock(start_time_file_name_map_mutex_);
-        std::string chronicle_name = getChronicleName(file_name);
-        std::string story_name = getStoryName(file_name);
-        uint64_t start_time = getStartTime(file_name);
-        start_time_file_name_map_.erase(std::make_tuple(chronicle_name, story_name, start_time));
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] Removed file {} from start_time_file_name_map_.", file_name);
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] start_time_file_name_map_ has {} entries.",
-                  start_time_file_name_map_.size());
+        StoryFileCatalog catalog(archive_path_);
+        catalog.refresh(parseStoryFile);
+        std::unordered_set<std::string> indexed;
+        for(auto &file_name: story_file_index_.snapshot()->fileNames()) {
+            indexed.insert(std::move(file_name));
+        }
+        StoryFileIndex::Update update;
+        for(const auto &entry: catalog.entries()) {
+            if(indexed.erase(entry.info.file_name) == 0) {
+                update.added.push_back(entry.info);
+            }
+        }
+        for(const auto &file_name: indexed) {
+            update.removed.push_back(getStoryFileInfo(file_name));
+        }
+        story_file_index_.apply(update);
+        clearCache();
+        ++monitor_overflows_;
+        LOG_WARNING("[HDF5ArchiveReadingAgent] Directory events were lost, rescanned {}: {} file(s) added, {} "
+                    "removed, {} entries.", archive_path_, update.added.size(), update.removed.size(),
+                    story_file_index_.size());
         return 0;
     }
 
-    int renameFileInStartTimeFileNameMap(const std::string &old_file_name, const std::string &new_file_name)
+    // Applies the net effect of a batch of directory events, file name -> whether it now exists, as one index
+    // update and one cache invalidation pass, so readers see either none or all of the batch
+    int applyFileChanges(std::unordered_map<std::string, bool> const &changes, size_t event_count,
+                         std::chrono::steady_clock::time_point first_event)
     {
-        removeFileFromStartTimeFileNameMap(old_file_name);
-        addFileToStartTimeFileNameMap(new_file_name);
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] Renamed file {} to {} in start_time_file_name_map_.",
-                  old_file_name, new_file_name);
-        LOG_DEBUG("[HDF5ArchiveReadingAgent] start_time_file_name_map_ has {} entries.",
-                  start_time_file_name_map_.size());
+        StoryFileIndex::Update update;
+        std::vector<std::string> changed;
+        changed.reserve(changes.size());
+        for(auto const &[file_name, exists]: changes) {
+            if(!isStoryFile(file_name)) {
+                continue;
+            }
+            // a file written again under a known name replaces the old contents
+            if(exists) {
+                update.added.push_back(getStoryFileInfo(file_name));
+            }
+            else {
+                update.removed.push_back(getStoryFileInfo(file_name));
+            }
+            changed.push_back(file_name);
+        }
+        story_file_index_.apply(update);
+        file_cache_.invalidate(changed);
+
+        uint64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                            first_event).count();
+        monitor_events_ += event_count;
+        ++monitor_batches_;
+        last_batch_size_ = event_count;
+        max_batch_size_ = std::max<uint64_t>(max_batch_size_, event_count);
+        last_lag_ns_ = lag;
+        max_lag_ns_ = std::max<uint64_t>(max_lag_ns_, lag);
+        LOG_DEBUG("[HDF5ArchiveReadingAgent] Applied {} directory event(s): {} file(s) added, {} removed, {} "
+                  "entries, {} ns after the first event.", event_count, update.added.size(), update.removed.size(),
+                  story_file_index_.size(), lag);
         return 0;
     }
 
     std::string archive_path_;
-    std::map<std::tuple<std::string, std::string, uint64_t>, std::string> start_time_file_name_map_;
-    std::mutex start_time_file_name_map_mutex_;
+    StoryFileIndex story_file_index_;
+    StoryFileCache file_cache_;
+    std::atomic<bool> stop_monitoring_{false};
     tl::managed <tl::xstream> archive_dir_monitoring_stream_;
     tl::managed <tl::thread> archive_dir_monitoring_thread_;
+    unsigned read_stream_count_;
+    std::once_flag read_streams_once_;
+    tl::managed <tl::pool> read_pool_;
+    std::vector <tl::managed <tl::xstream>> read_streams_;
+    // written by the monitoring thread only
+    std::atomic<uint64_t> monitor_events_{0};
+    std::atomic<uint64_t> monitor_batches_{0};
+    std::atomic<uint64_t> last_batch_size_{0};
+    std::atomic<uint64_t> max_batch_size_{0};
+    std::atomic<uint64_t> last_lag_ns_{0};
+    std::atomic<uint64_t> max_lag_ns_{0};
+    std::atomic<uint64_t> monitor_overflows_{0};
 };
 
 } // chronolog
@@ -0,0 +1,185 @@
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "HDF5ArchiveReadingAgent.h"
+#include "ReaderService.h"
+#include "mcp_server.hpp"
+
+namespace chronolog
+{
+
+namespace
+{
+
+// Page size when a query gives no limit, so one call can't return a whole archive
+constexpr size_t kDefaultPageSize = 1000;
+
+std::string stringArgument(json::Value const &params, const std::string &key, const std::string &fallback)
+{
+    auto const &object = params.as_object();
+    auto it = object.find(key);
+    if(it == object.end() || it->second.is_null()) {
+        return fallback;
+    }
+    if(!it->second.is_string()) {
+        throw std::runtime_error("'" + key + "' must be a string");
+    }
+    return it->second.as_string();
+}
+
+// Nanosecond times don't fit a JSON double exactly, so they are passed as decimal strings; small integers
+// are accepted as well
+uint64_t timeArgument(json::Value const &params, const std::string &key, uint64_t fallback)
+{
+    auto const &object = params.as_object();
+    auto it = object.find(key);
+    if(it == object.end() || it->second.is_null()) {
+        return fallback;
+    }
+    if(it->second.is_int() && it->second.as_int() >= 0) {
+        return static_cast<uint64_t>(it->second.as_int());
+    }
+    if(it->second.is_string()) {
+        const std::string &text = it->second.as_string();
+        size_t used = 0;
+        try {
+            uint64_t value = std::stoull(text, &used);
+            if(used == text.size() && !text.empty() && text[0] != '-') {
+                return value;
+            }
+        }
+        catch(std::exception const &) {
+        }
+    }
+    throw std::runtime_error("'" + key + "' must be a time in nanoseconds, given as a decimal string");
+}
+
+size_t limitArgument(json::Value const &params)
+{
+    auto const &object = params.as_object();
+    auto it = object.find("limit");
+    if(it == object.end() || it->second.is_null()) {
+        return kDefaultPageSize;
+    }
+    if(!it->second.is_int() || it->second.as_int() <= 0) {
+        throw std::runtime_error("'limit' must be a positive integer");
+    }
+    return static_cast<size_t>(it->second.as_int());
+}
+
+json::Value eventToJson(LogEvent const &event)
+{
+    json::Value value;
+    value["story_id"] = std::to_string(event.storyId);
+    value["time"] = std::to_string(event.eventTime);
+    value["client_id"] = static_cast<double>(event.clientId);
+    value["index"] = static_cast<double>(event.eventIndex);
+    value["record"] = event.logRecord;
+    return value;
+}
+
+json::Value readStory(HDF5ArchiveReadingAgent &agent, json::Value const &params)
+{
+    if(!params.is_object()) {
+        throw std::runtime_error("Expected an object of arguments");
+    }
+    std::string chronicle_name = stringArgument(params, "chronicle", "");
+    std::string story_name = stringArgument(params, "story", "");
+    if(chronicle_name.empty() || story_name.empty()) {
+        throw std::runtime_error("Missing 'chronicle' or 'story' parameter");
+    }
+    uint64_t start_time = timeArgument(params, "start_time", 0);
+    uint64_t end_time = timeArgument(params, "end_time", std::numeric_limits<uint64_t>::max());
+    size_t limit = limitArgument(params);
+    StoryEventCursor cursor;
+    if(!StoryEventCursor::parse(stringArgument(params, "cursor", ""), cursor)) {
+        throw std::runtime_error("'cursor' must be a next_cursor value returned by read_story");
+    }
+
+    auto stream = agent.openStoryStream(chronicle_name, story_name, start_time, end_time, cursor);
+    json::Array events;
+    LogEvent event;
+    while(events.size() < limit && stream->next(event)) {
+        events.push_back(eventToJson(event));
+    }
+
+    size_t count = events.size();
+    json::Value result;
+    result["count"] = static_cast<double>(count);
+    result["events"] = std::move(events);
+    // a page that filled up says where the next one starts, if there is one
+    StoryEventCursor last = stream->cursor();
+    if(count == limit && stream->next(event)) {
+        result["next_cursor"] = last.toString();
+    }
+    else {
+        result["next_cursor"] = json::Value();
+    }
+    return result;
+}
+
+json::Value archiveStatus(HDF5ArchiveReadingAgent &agent)
+{
+    json::Value result;
+    result["indexed_files"] = static_cast<double>(agent.indexedFileCount());
+    StoryFileCache::Stats cache = agent.cacheStats();
+    result["cache"]["open_files"] = static_cast<double>(cache.open_files);
+    result["cache"]["file_opens"] = static_cast<double>(cache.file_opens);
+    result["cache"]["cached_blocks"] = static_cast<double>(cache.cached_blocks);
+    result["cache"]["cached_bytes"] = static_cast<double>(cache.cached_bytes);
+    result["cache"]["block_hits"] = static_cast<double>(cache.block_hits);
+    result["cache"]["block_misses"] = static_cast<double>(cache.block_misses);
+    HDF5ArchiveReadingAgent::MonitorStats monitor = agent.monitorStats();
+    result["monitor"]["events"] = static_cast<double>(monitor.events);
+    result["monitor"]["batches"] = static_cast<double>(monitor.batches);
+    result["monitor"]["last_batch_size"] = static_cast<double>(monitor.last_batch_size);
+    result["monitor"]["max_batch_size"] = static_cast<double>(monitor.max_batch_size);
+    result["monitor"]["last_lag_ms"] = monitor.last_lag_ns / 1e6;
+    result["monitor"]["max_lag_ms"] = monitor.max_lag_ns / 1e6;
+    result["monitor"]["overflows"] = static_cast<double>(monitor.overflows);
+    return result;
+}
+
+} // namespace
+
+int runReaderService(HDF5ArchiveReadingAgent &agent, size_t worker_threads)
+{
+    mcp::ServerOptions options;
+    options.worker_threads = worker_threads;
+    mcp::Server server("chronolog-reader", "1.0.0", options);
+
+    json::Value read_schema;
+    read_schema["type"] = "object";
+    read_schema["properties"]["chronicle"]["type"] = "string";
+    read_schema["properties"]["story"]["type"] = "string";
+    read_schema["properties"]["start_time"]["type"] = "string";
+    read_schema["properties"]["start_time"]["description"] = "First event time in nanoseconds, as a decimal string";
+    read_schema["properties"]["end_time"]["type"] = "string";
+    read_schema["properties"]["end_time"]["description"] = "Last event time in nanoseconds, as a decimal string";
+    read_schema["properties"]["limit"]["type"] = "integer";
+    read_schema["properties"]["limit"]["description"] = "Events per page (default 1000)";
+    read_schema["properties"]["cursor"]["type"] = "string";
+    read_schema["properties"]["cursor"]["description"] = "next_cursor of the previous page";
+    read_schema["required"] = json::Value(json::Array{"chronicle", "story"});
+
+    server.register_tool("read_story",
+        "Read the archived events of a story in time order, one page at a time. Times and story ids are "
+        "decimal strings; next_cursor is set when more events remain",
+        read_schema,
+        [&agent](json::Value const &params) -> json::Value { return readStory(agent, params); });
+
+    json::Value status_schema;
+    status_schema["type"] = "object";
+    server.register_tool("archive_status",
+        "Describe the archive the reader serves, its cache of open files and decoded events, and the monitor "
+        "applying directory changes in batches",
+        status_schema,
+        [&agent](json::Value const &) -> json::Value { return archiveStatus(agent); });
+
+    server.run();
+    return 0;
+}
+
+} // chronolog
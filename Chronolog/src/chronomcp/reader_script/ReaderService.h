@@ -0,0 +1,19 @@
+#ifndef CHRONOLOG_READERSERVICE_H
+#define CHRONOLOG_READERSERVICE_H
+
+#include <cstddef>
+
+namespace chronolog
+{
+
+class HDF5ArchiveReadingAgent;
+
+// Serves queries against an initialized agent as MCP JSON-RPC on stdin and
+// stdout, using the mcp::Server framing, until stdin is closed. The agent,
+// its index and the monitor stay up between queries, so a query costs a
+// dispatch rather than a process start. Returns the process exit code.
+int runReaderService(HDF5ArchiveReadingAgent &agent, size_t worker_threads);
+
+} // chronolog
+
+#endif //CHRONOLOG_READERSERVICE_H
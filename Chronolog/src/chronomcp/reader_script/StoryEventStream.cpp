@@ -0,0 +1,269 @@
+#include <algorithm>
+
+#include "StoryEventStream.h"
+#include "chrono_monitor.h"
+
+namespace chronolog
+{
+
+struct StoryEventStream::Source
+{
+    size_t file = 0;
+    uint64_t end_block = 0;
+    uint64_t next_block = 0;
+    std::shared_ptr<StoryFileCache::Block const> block;
+    size_t position = 0;
+    bool unsorted = false;      // gathered by loadUnsortedSource
+    StoryEventCursor after;     // events at or before this were returned already
+
+    LogEvent const &head() const { return (*block)[position]; }
+};
+
+namespace
+{
+
+bool headAfter(LogEvent const &a, LogEvent const &b)
+{
+    if(a.eventTime != b.eventTime) {
+        return a.eventTime > b.eventTime;
+    }
+    return a.clientId != b.clientId ? a.clientId > b.clientId : a.eventIndex > b.eventIndex;
+}
+
+} // namespace
+
+StoryEventStream::StoryEventStream(StoryFileCache &cache, std::vector<StoryFileEntry> files, uint64_t start_time,
+                                   uint64_t end_time, StoryEventCursor const &after, Spawn spawn)
+    : cache_(cache)
+    , files_(std::move(files))
+    , start_time_(start_time)
+    , end_time_(end_time)
+    , after_(after)
+    , cursor_(after)
+    , spawn_(cache.memoryBudget() != 0 ? std::move(spawn) : Spawn())
+{
+    // files that end before the cursor have nothing left to return
+    if(after_.valid) {
+        files_.erase(std::remove_if(files_.begin(), files_.end(), [&](StoryFileEntry const &file) {
+            return file.end_time < after_.event_time;
+        }), files_.end());
+        start_time_ = std::max(start_time_, after_.event_time);
+    }
+}
+
+StoryEventStream::~StoryEventStream()
+{
+    // the reads in flight use the file list
+    for(auto &prefetch: prefetches_) {
+        prefetch.wait();
+    }
+}
+
+bool StoryEventStream::next(LogEvent &event)
+{
+    // Every event of a file comes at or after the file's start time, so a file only has to be open once the
+    // smallest buffered event reaches that time
+    while(next_file_ < files_.size() &&
+          (heap_.empty() || files_[next_file_].start_time <= sources_[heap_.front()]->head().eventTime)) {
+        openSource(next_file_++);
+    }
+    // the first blocks of the files the merge reaches next are read meanwhile
+    prefetched_files_ = std::max(prefetched_files_, next_file_);
+    for(; spawn_ && prefetched_files_ < std::min(files_.size(), next_file_ + kPrefetchFiles); ++prefetched_files_) {
+        prefetch(prefetched_files_, kFirstBlock);
+    }
+    if(heap_.empty()) {
+        return false;
+    }
+
+    size_t index = heap_.front();
+    popSource();
+    Source &source = *sources_[index];
+    event = source.head();
+    ++source.position;
+    cursor_.valid = true;
+    cursor_.event_time = event.eventTime;
+    cursor_.client_id = event.clientId;
+    cursor_.event_index = event.eventIndex;
+    if(settleSource(source)) {
+        pushSource(index);
+    }
+    else {
+        sources_[index].reset();
+    }
+    return true;
+}
+
+// The work reads through the cache a file name of files_, so the destructor waits for it
+void StoryEventStream::prefetch(size_t file, uint64_t block)
+{
+    if(!spawn_) {
+        return;
+    }
+    for(auto const &prefetch: prefetches_) {
+        if(prefetch.file == file && prefetch.block == block) {
+            return;
+        }
+    }
+    if(prefetches_.size() >= kPrefetchDepth) {
+        prefetches_.front().wait();
+        prefetches_.pop_front();
+    }
+    StoryFileCache &cache = cache_;
+    std::string const &file_name = files_[file].file_name;
+    uint64_t start_time = start_time_;
+    uint64_t end_time = end_time_;
+    std::function<void()> work;
+    if(block == kFirstBlock) {
+        work = [&cache, &file_name, start_time, end_time]() {
+            uint64_t first_block = 0;
+            uint64_t end_block = 0;
+            bool sorted = true;
+            if(cache.blockRange(file_name, start_time, end_time, first_block, end_block, sorted) &&
+               first_block < end_block) {
+                cache.block(file_name, first_block);
+            }
+        };
+    }
+    else {
+        work = [&cache, &file_name, block]() { cache.block(file_name, block); };
+    }
+    prefetches_.push_back(Prefetch{file, block, spawn_(std::move(work))});
+}
+
+void StoryEventStream::waitForPrefetch(size_t file, uint64_t block)
+{
+    for(auto it = prefetches_.begin(); it != prefetches_.end(); ++it) {
+        if(it->file == file && it->block == block) {
+            it->wait();
+            prefetches_.erase(it);
+            return;
+        }
+    }
+}
+
+// A block being prefetched is waited for rather than read a second time
+std::shared_ptr<StoryFileCache::Block const> StoryEventStream::loadBlock(size_t file, uint64_t block)
+{
+    waitForPrefetch(file, block);
+    return cache_.block(files_[file].file_name, block);
+}
+
+bool StoryEventStream::openSource(size_t file)
+{
+    waitForPrefetch(file, kFirstBlock);
+    auto source = std::make_unique<Source>();
+    source->file = file;
+    source->after = after_;
+    bool sorted = true;
+    if(!cache_.blockRange(files_[file].file_name, start_time_, end_time_, source->next_block, source->end_block,
+                          sorted)) {
+        ++failed_files_;
+        return false;
+    }
+    if(!sorted && !loadUnsortedSource(*source)) {
+        ++failed_files_;
+        return false;
+    }
+    if(!settleSource(*source)) {
+        return false;
+    }
+    sources_.push_back(std::move(source));
+    pushSource(sources_.size() - 1);
+    return true;
+}
+
+// A file whose rows are out of time order can't be merged block by block, so its events in range are gathered
+// from every block into one block of their own, sorted the way the merge orders events
+bool StoryEventStream::loadUnsortedSource(Source &source)
+{
+    source.unsorted = true;
+    auto events = std::make_shared<StoryFileCache::Block>();
+    for(; source.next_block < source.end_block; ++source.next_block) {
+        if(source.next_block + 1 < source.end_block) {
+            prefetch(source.file, source.next_block + 1);
+        }
+        auto block = loadBlock(source.file, source.next_block);
+        if(!block) {
+            return false;
+        }
+        for(auto const &event: *block) {
+            if(event.eventTime >= start_time_ && event.eventTime <= end_time_) {
+                events->push_back(event);
+            }
+        }
+    }
+    std::sort(events->begin(), events->end(), [](LogEvent const &a, LogEvent const &b) {
+        return headAfter(b, a);
+    });
+    source.block = std::move(events);
+    return true;
+}
+
+// Moves the source to its next event in range, loading blocks as needed; false once it has none left
+bool StoryEventStream::settleSource(Source &source)
+{
+    while(true) {
+        if(source.block) {
+            auto const &events = *source.block;
+            for(; source.position < events.size(); ++source.position) {
+                LogEvent const &event = events[source.position];
+                if(event.eventTime > end_time_) {
+                    source.block.reset();
+                    return false;
+                }
+                if(event.eventTime >= start_time_ &&
+                   source.after.isBefore(event.eventTime, event.clientId, event.eventIndex)) {
+                    return true;
+                }
+            }
+        }
+        if(source.next_block >= source.end_block) {
+            source.block.reset();
+            return false;
+        }
+        source.block = loadBlock(source.file, source.next_block++);
+        if(!source.block) {
+            ++failed_files_;
+            return false;
+        }
+        if(source.next_block < source.end_block) {
+            prefetch(source.file, source.next_block);
+        }
+        if(!source.unsorted && !cache_.inTimeOrder(files_[source.file].file_name)) {
+            // The block showed the file is out of time order after all: gather the whole file and go on after
+            // the last event returned. Events of this file before that position can't be returned in order.
+            source.after = cursor_;
+            bool sorted = true;
+            if(!cache_.blockRange(files_[source.file].file_name, start_time_, end_time_, source.next_block,
+                                  source.end_block, sorted) || !loadUnsortedSource(source)) {
+                ++failed_files_;
+                return false;
+            }
+            source.position = 0;
+            continue;
+        }
+        // rows are in time order, so the events before the window are skipped by binary search
+        source.position = std::lower_bound(source.block->begin(), source.block->end(), start_time_,
+                                           [](LogEvent const &event, uint64_t time) { return event.eventTime < time; })
+                          - source.block->begin();
+    }
+}
+
+void StoryEventStream::pushSource(size_t source)
+{
+    heap_.push_back(source);
+    std::push_heap(heap_.begin(), heap_.end(), [this](size_t a, size_t b) {
+        return headAfter(sources_[a]->head(), sources_[b]->head());
+    });
+}
+
+void StoryEventStream::popSource()
+{
+    std::pop_heap(heap_.begin(), heap_.end(), [this](size_t a, size_t b) {
+        return headAfter(sources_[a]->head(), sources_[b]->head());
+    });
+    heap_.pop_back();
+}
+
+} // chronolog
@@ -0,0 +1,155 @@
+#ifndef CHRONOLOG_STORYEVENTSTREAM_H
+#define CHRONOLOG_STORYEVENTSTREAM_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "StoryChunk.h"
+#include "StoryFileCache.h"
+#include "StoryFileIndex.h"
+
+namespace chronolog
+{
+
+// Position in a story, given by the (eventTime, clientId, eventIndex) of the
+// last event returned. A stream opened after a cursor starts with the event
+// that follows it, so a range can be read in pages.
+struct StoryEventCursor
+{
+    bool valid = false;
+    uint64_t event_time = 0;
+    uint32_t client_id = 0;
+    uint32_t event_index = 0;
+
+    // "time:client:index", or empty for the start of the story
+    std::string toString() const
+    {
+        if(!valid) {
+            return std::string();
+        }
+        return std::to_string(event_time) + ":" + std::to_string(client_id) + ":" + std::to_string(event_index);
+    }
+
+    static bool parse(const std::string &text, StoryEventCursor &cursor)
+    {
+        cursor = StoryEventCursor();
+        if(text.empty()) {
+            return true;
+        }
+        size_t first = text.find(':');
+        if(first == std::string::npos) {
+            return false;
+        }
+        size_t second = text.find(':', first + 1);
+        if(second == std::string::npos) {
+            return false;
+        }
+        try {
+            size_t used = 0;
+            cursor.event_time = std::stoull(text.substr(0, first), &used);
+            bool ok = used == first;
+            cursor.client_id = static_cast<uint32_t>(std::stoul(text.substr(first + 1, second - first - 1), &used));
+            ok = ok && used == second - first - 1;
+            cursor.event_index = static_cast<uint32_t>(std::stoul(text.substr(second + 1), &used));
+            ok = ok && used == text.size() - second - 1;
+            cursor.valid = ok;
+            return ok;
+        }
+        catch(std::exception const &) {
+            return false;
+        }
+    }
+
+    bool isBefore(uint64_t time, uint32_t client, uint32_t index) const
+    {
+        if(!valid) {
+            return true;
+        }
+        if(event_time != time) {
+            return event_time < time;
+        }
+        return client_id != client ? client_id < client : event_index < index;
+    }
+};
+
+// Pull-based reader of a story's archived events in time order. It k-way
+// merges the story files of the range, opening a file only once the merge
+// reaches its start time and holding one block of rows per open file, so
+// memory stays bounded by the files open at once rather than the range, and
+// the first event is ready after one block of one file. Blocks come from the
+// cache, which must outlive the stream.
+//
+// Given a way to run work elsewhere, the stream also has the next block of
+// each open file and the first block of the next files read and decoded into
+// the cache while it merges, with at most kPrefetchDepth reads in flight.
+class StoryEventStream
+{
+public:
+    // Runs work off the calling thread and returns a function that waits for it
+    using Spawn = std::function<std::function<void()>(std::function<void()>)>;
+
+    static constexpr size_t kPrefetchDepth = 4;
+    static constexpr size_t kPrefetchFiles = 2;
+
+    // files as returned by the story file index for [start_time, end_time]; without spawn nothing is read
+    // ahead, nor with a cache that keeps no blocks
+    StoryEventStream(StoryFileCache &cache, std::vector<StoryFileEntry> files, uint64_t start_time,
+                     uint64_t end_time, StoryEventCursor const &after = StoryEventCursor(), Spawn spawn = Spawn());
+
+    ~StoryEventStream();
+
+    StoryEventStream(StoryEventStream const &) = delete;
+    StoryEventStream &operator=(StoryEventStream const &) = delete;
+
+    // Copies the next event into event; false once the range is exhausted
+    bool next(LogEvent &event);
+
+    // Position after the last event next() returned
+    StoryEventCursor const &cursor() const { return cursor_; }
+
+    // Files the stream could not read and skipped
+    size_t failedFiles() const { return failed_files_; }
+
+private:
+    struct Source;
+
+    struct Prefetch
+    {
+        size_t file;
+        uint64_t block;   // kFirstBlock for the first block in range of a file not opened yet
+        std::function<void()> wait;
+    };
+
+    static constexpr uint64_t kFirstBlock = ~uint64_t(0);
+
+    void prefetch(size_t file, uint64_t block);
+    void waitForPrefetch(size_t file, uint64_t block);
+    std::shared_ptr<StoryFileCache::Block const> loadBlock(size_t file, uint64_t block);
+    bool openSource(size_t file);
+    bool loadUnsortedSource(Source &source);
+    bool settleSource(Source &source);
+    void pushSource(size_t source);
+    void popSource();
+
+    StoryFileCache &cache_;
+    std::vector<StoryFileEntry> files_;
+    uint64_t start_time_;
+    uint64_t end_time_;
+    StoryEventCursor after_;
+    StoryEventCursor cursor_;
+    size_t next_file_ = 0;    // files_ before this one have been opened
+    size_t failed_files_ = 0;
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<size_t> heap_;   // sources with buffered events, smallest head first
+    Spawn spawn_;
+    std::deque<Prefetch> prefetches_;   // in flight, oldest first
+    size_t prefetched_files_ = 0;       // files_ before this one were prefetched or opened
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_STORYEVENTSTREAM_H
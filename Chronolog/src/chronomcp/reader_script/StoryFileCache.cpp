@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+#include <sys/stat.h>
+
+#include "ArchiveFileFormat.h"
+#include "StoryFileCache.h"
+#include "TraceRecorder.h"
+#include "chrono_monitor.h"
+
+namespace chronolog
+{
+
+// HDF5 handles of one story file; released under the HDF5 lock by whoever drops the last reference
+struct StoryFileCache::OpenFile
+{
+    explicit OpenFile(const std::string &file_name)
+        : file(file_name, H5F_ACC_RDONLY)
+        , dataset(file.openDataSet(STORY_CHUNK_DATASET))
+        , type(createLogEventType())
+    {
+        dataset.getSpace().getSimpleExtentDims(&row_count);
+        data_offset = dataset.getOffset();
+        row_bytes = dataset.getDataType().getSize();
+        readBlockTimes();
+        int* fd = nullptr;
+        struct stat status;
+        file.getVFDHandle(reinterpret_cast<void**>(&fd));
+        if(fd != nullptr && fstat(*fd, &status) == 0) {
+            device = status.st_dev;
+            inode = status.st_ino;
+        }
+    }
+
+    // Whether file_name still names the file this handle has open
+    bool isFileAt(const std::string &file_name) const
+    {
+        struct stat status;
+        return inode != 0 && stat(file_name.c_str(), &status) == 0 && status.st_dev == device &&
+               status.st_ino == inode;
+    }
+
+    // Reads only the eventTime member of the first row of every block and of the last row, so the
+    // vlen records are not touched
+    void readBlockTimes()
+    {
+        if(row_count == 0) {
+            sorted = true;
+            return;
+        }
+        std::vector<hsize_t> rows;
+        for(hsize_t row = 0; row < row_count; row += kRowsPerBlock) {
+            rows.push_back(row);
+        }
+        rows.push_back(row_count - 1);
+
+        H5::CompType time_type(sizeof(uint64_t));
+        time_type.insertMember("eventTime", 0, H5::PredType::NATIVE_UINT64);
+        H5::DataSpace file_space = dataset.getSpace();
+        file_space.selectElements(H5S_SELECT_SET, rows.size(), rows.data());
+        hsize_t count = rows.size();
+        H5::DataSpace memory_space(1, &count);
+        std::vector<uint64_t> times(rows.size());
+        dataset.read(times.data(), time_type, memory_space, file_space);
+
+        last_time = times.back();
+        times.pop_back();
+        block_first_times = std::move(times);
+        sorted = std::is_sorted(block_first_times.begin(), block_first_times.end()) &&
+                 block_first_times.back() <= last_time;
+    }
+
+    H5::H5File file;
+    H5::DataSet dataset;
+    H5::CompType type;
+    hsize_t row_count = 0;
+    // file offset of the rows when they are stored contiguously, HADDR_UNDEF otherwise
+    haddr_t data_offset = HADDR_UNDEF;
+    size_t row_bytes = 0;
+    // eventTime of the first row of each block, and of the last row
+    std::vector<uint64_t> block_first_times;
+    uint64_t last_time = 0;
+    dev_t device = 0;
+    ino_t inode = 0;
+    // rows in time order, which the block times rely on; otherwise every block is read. Checked on the
+    // sampled times at open and on every decoded block, which may clear it later.
+    std::atomic<bool> sorted{false};
+
+    struct Deleter
+    {
+        StoryFileCache* cache;
+        std::string file_name;
+
+        void operator()(OpenFile* open_file) const
+        {
+            std::lock_guard<std::mutex> lock(hdf5Mutex());
+            auto live = cache->live_files_.find(file_name);
+            if(live != cache->live_files_.end() && live->second.open_file == open_file) {
+                cache->live_files_.erase(live);
+            }
+            delete open_file;
+            cache->file_closed_.notify_all();
+        }
+    };
+};
+
+StoryFileCache::StoryFileCache(size_t memory_budget, size_t max_open_files)
+    : memory_budget_(memory_budget)
+    , max_open_files_(std::max<size_t>(max_open_files, 1))
+{}
+
+StoryFileCache::~StoryFileCache()
+{
+    clear();
+}
+
+std::shared_ptr<StoryFileCache::OpenFile> StoryFileCache::openFile(const std::string &file_name)
+{
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(file_name);
+        if(it != files_.end()) {
+            file_lru_.splice(file_lru_.begin(), file_lru_, it->second.second);
+            return it->second.first;
+        }
+        generation = generation_;
+    }
+
+    std::shared_ptr<OpenFile> open_file;
+    // a handle of a file since replaced, released after the HDF5 lock since it may be the last reference
+    std::shared_ptr<OpenFile> replaced;
+    bool opened = false;
+    {
+        TraceSpan span("hdf5.open");
+        std::unique_lock<std::mutex> lock(hdf5Mutex());
+        // HDF5 shares one file structure between all opens of a file, and a dataset opened through two of
+        // them keeps pointing at the first: closing that one while the other is in use crashes its reads.
+        // So a handle still held by a reader (one that lost a race to cache it, or was invalidated) is
+        // reused while the name still points at its file, and one being closed is waited for.
+        auto live = live_files_.find(file_name);
+        while(live != live_files_.end() && !(open_file = live->second.handle.lock())) {
+            file_closed_.wait(lock);
+            live = live_files_.find(file_name);
+        }
+        if(open_file && !open_file->isFileAt(file_name)) {
+            replaced = std::move(open_file);
+        }
+        if(!open_file) {
+            try {
+                open_file = std::shared_ptr<OpenFile>(new OpenFile(file_name), OpenFile::Deleter{this, file_name});
+            }
+            catch(H5::Exception const &e) {
+                LOG_ERROR("[StoryFileCache] Failed to open story file {}: {}", file_name, e.getDetailMsg());
+                return nullptr;
+            }
+            live_files_[file_name] = LiveFile{open_file, open_file.get()};
+            opened = true;
+        }
+    }
+
+    // evicted handles are closed after the cache lock is released
+    std::vector<std::shared_ptr<OpenFile>> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_opens_ += opened;
+    if(generation != generation_) {
+        // the file may have been replaced while it was opened; the handle serves this read only
+        return open_file;
+    }
+    auto it = files_.find(file_name);
+    if(it != files_.end()) {
+        // another thread opened it meanwhile
+        evicted.push_back(std::move(open_file));
+        return it->second.first;
+    }
+    file_lru_.push_front(file_name);
+    files_.emplace(file_name, std::make_pair(open_file, file_lru_.begin()));
+    while(files_.size() > max_open_files_) {
+        auto victim = files_.find(file_lru_.back());
+        evicted.push_back(std::move(victim->second.first));
+        files_.erase(victim);
+        file_lru_.pop_back();
+    }
+    return open_file;
+}
+
+bool StoryFileCache::blockRange(const std::string &file_name, uint64_t start_time, uint64_t end_time,
+                                uint64_t &first_block, uint64_t &end_block, bool &sorted)
+{
+    std::shared_ptr<OpenFile> open_file = openFile(file_name);
+    if(!open_file) {
+        return false;
+    }
+    auto const &firsts = open_file->block_first_times;
+    first_block = 0;
+    end_block = firsts.size();
+    sorted = open_file->sorted;
+    if(!sorted || firsts.empty()) {
+        return true;
+    }
+    if(start_time > open_file->last_time || end_time < firsts.front()) {
+        end_block = 0;
+        return true;
+    }
+    // Block b holds times in [firsts[b], firsts[b + 1]] (equal times may straddle a boundary), so the
+    // first block needed is the one before the first block starting at or after start_time
+    auto first = std::lower_bound(firsts.begin(), firsts.end(), start_time);
+    first_block = first == firsts.begin() ? 0 : uint64_t(first - firsts.begin()) - 1;
+    end_block = std::upper_bound(firsts.begin(), firsts.end(), end_time) - firsts.begin();
+    return true;
+}
+
+bool StoryFileCache::inTimeOrder(const std::string &file_name)
+{
+    std::shared_ptr<OpenFile> open_file = openFile(file_name);
+    return open_file && open_file->sorted;
+}
+
+std::shared_ptr<StoryFileCache::Block const> StoryFileCache::block(const std::string &file_name, uint64_t block_index)
+{
+    auto key = std::make_pair(file_name, block_index);
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = blocks_.find(key);
+        if(it != blocks_.end()) {
+            ++block_hits_;
+            block_lru_.splice(block_lru_.begin(), block_lru_, it->second.lru);
+            return it->second.block;
+        }
+        ++block_misses_;
+        generation = generation_;
+    }
+
+    std::shared_ptr<OpenFile> open_file = openFile(file_name);
+    if(!open_file) {
+        return nullptr;
+    }
+    hsize_t offset = block_index * kRowsPerBlock;
+    if(offset >= open_file->row_count) {
+        return std::make_shared<Block>();
+    }
+    hsize_t count = std::min<hsize_t>(kRowsPerBlock, open_file->row_count - offset);
+    // only the rows of this block, not the whole file; the records they point to are read on demand
+    if(open_file->data_offset != HADDR_UNDEF) {
+        prefetchRange(file_name, open_file->data_offset + offset * open_file->row_bytes, count * open_file->row_bytes);
+    }
+    std::vector<LogEventHVL> rows(count);
+    std::unique_ptr<H5::DataSpace> memory_space;
+    {
+        TraceSpan span("hdf5.read");
+        std::lock_guard<std::mutex> lock(hdf5Mutex());
+        try {
+            H5::DataSpace file_space = open_file->dataset.getSpace();
+            file_space.selectHyperslab(H5S_SELECT_SET, &count, &offset);
+            memory_space = std::make_unique<H5::DataSpace>(1, &count);
+            open_file->dataset.read(rows.data(), open_file->type, *memory_space, file_space);
+        }
+        catch(H5::Exception const &e) {
+            LOG_ERROR("[StoryFileCache] Failed to read story file {}: {}", file_name, e.getDetailMsg());
+            memory_space.reset();
+            return nullptr;
+        }
+    }
+
+    auto block = std::make_shared<Block>();
+    size_t bytes = sizeof(Block) + count * sizeof(LogEvent);
+    {
+        TraceSpan span("decode");
+        block->reserve(count);
+        for(auto const &row: rows) {
+            block->emplace_back(row.storyId, row.eventTime, row.clientId, row.eventIndex,
+                                std::string(static_cast<char const*>(row.logRecord.p), row.logRecord.len));
+            bytes += block->back().logRecord.capacity();
+        }
+        // rows out of order within the block, or outside its sampled time range, make the file unsorted
+        uint64_t next_first = block_index + 1 < open_file->block_first_times.size()
+                                  ? open_file->block_first_times[block_index + 1]
+                                  : open_file->last_time;
+        bool in_order = std::is_sorted(block->begin(), block->end(), [](LogEvent const &a, LogEvent const &b) {
+            return a.eventTime < b.eventTime;
+        });
+        if(open_file->sorted && (!in_order || (!block->empty() && block->back().eventTime > next_first))) {
+            open_file->sorted = false;
+            LOG_WARNING("[StoryFileCache] Rows of story file {} are not in time order, reading it in full",
+                        file_name);
+        }
+        std::lock_guard<std::mutex> lock(hdf5Mutex());
+        H5::DataSet::vlenReclaim(rows.data(), open_file->type, *memory_space);
+        memory_space.reset();
+    }
+
+    std::vector<std::shared_ptr<Block const>> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(bytes > memory_budget_ || generation != generation_ || blocks_.count(key) != 0) {
+        return block;
+    }
+    block_lru_.push_front(key);
+    blocks_.emplace(key, BlockEntry{block, bytes, block_lru_.begin()});
+    cached_bytes_ += bytes;
+    while(cached_bytes_ > memory_budget_) {
+        auto victim = blocks_.find(block_lru_.back());
+        cached_bytes_ -= victim->second.bytes;
+        evicted.push_back(std::move(victim->second.block));
+        blocks_.erase(victim);
+        block_lru_.pop_back();
+    }
+    return block;
+}
+
+void StoryFileCache::invalidate(const std::string &file_name)
+{
+    invalidate(std::vector<std::string>{file_name});
+}
+
+void StoryFileCache::invalidate(std::vector<std::string> const &file_names)
+{
+    if(file_names.empty()) {
+        return;
+    }
+    std::unordered_set<std::string> names(file_names.begin(), file_names.end());
+    std::vector<std::shared_ptr<OpenFile>> closed;
+    std::vector<std::shared_ptr<Block const>> dropped;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    for(auto const &file_name: names) {
+        auto it = files_.find(file_name);
+        if(it != files_.end()) {
+            closed.push_back(std::move(it->second.first));
+            file_lru_.erase(it->second.second);
+            files_.erase(it);
+        }
+    }
+    if(blocks_.empty()) {
+        return;
+    }
+    for(auto block = blocks_.begin(); block != blocks_.end();) {
+        if(names.count(block->first.first) != 0) {
+            cached_bytes_ -= block->second.bytes;
+            dropped.push_back(std::move(block->second.block));
+            block_lru_.erase(block->second.lru);
+            block = blocks_.erase(block);
+        }
+        else {
+            ++block;
+        }
+    }
+}
+
+void StoryFileCache::clear()
+{
+    decltype(files_) files;
+    decltype(blocks_) blocks;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    files.swap(files_);
+    blocks.swap(blocks_);
+    file_lru_.clear();
+    block_lru_.clear();
+    cached_bytes_ = 0;
+}
+
+StoryFileCache::Stats StoryFileCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.block_hits = block_hits_;
+    stats.block_misses = block_misses_;
+    stats.file_opens = file_opens_;
+    stats.open_files = files_.size();
+    stats.cached_blocks = blocks_.size();
+    stats.cached_bytes = cached_bytes_;
+    return stats;
+}
+
+} // chronolog
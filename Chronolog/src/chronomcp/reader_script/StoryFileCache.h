@@ -0,0 +1,127 @@
+#ifndef CHRONOLOG_STORYFILECACHE_H
+#define CHRONOLOG_STORYFILECACHE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "StoryChunk.h"
+
+namespace chronolog
+{
+
+// Bounded cache of the archive reader: open HDF5 file/dataset handles and
+// decoded blocks of rows, each evicted least recently used first. A story
+// file is read in blocks of kRowsPerBlock rows; since rows are in time order
+// a block is a time sub-range of its file, and any later query touching it
+// reuses the decoded events instead of opening and decoding the file again.
+// Opening a file also reads the time of each block's first row, so a query
+// only reads the hyperslabs of the blocks its window overlaps. Files whose
+// rows turn out not to be in time order are read, and filtered, in full.
+// Thread-safe; HDF5 calls take the reader's HDF5 lock, decoding does not.
+class StoryFileCache
+{
+public:
+    static constexpr size_t kRowsPerBlock = 4096;
+    static constexpr size_t kDefaultMemoryBudget = size_t(256) << 20;
+    static constexpr size_t kDefaultOpenFiles = 64;
+
+    using Block = std::vector<LogEvent>;
+
+    struct Stats
+    {
+        uint64_t block_hits = 0;
+        uint64_t block_misses = 0;
+        uint64_t file_opens = 0;
+        size_t open_files = 0;
+        size_t cached_blocks = 0;
+        size_t cached_bytes = 0;
+    };
+
+    // memory_budget bounds the decoded blocks; 0 disables block caching
+    explicit StoryFileCache(size_t memory_budget = kDefaultMemoryBudget, size_t max_open_files = kDefaultOpenFiles);
+
+    ~StoryFileCache();
+
+    StoryFileCache(StoryFileCache const &) = delete;
+    StoryFileCache &operator=(StoryFileCache const &) = delete;
+
+    // Blocks [first_block, end_block) of the file that can hold events in [start_time, end_time], found by
+    // binary search over the time of each block's first row; false if the file can't be opened. sorted is
+    // false when the file's rows are not in time order: then every block is returned, and callers must
+    // filter every row rather than search the blocks.
+    bool blockRange(const std::string &file_name, uint64_t start_time, uint64_t end_time, uint64_t &first_block,
+                    uint64_t &end_block, bool &sorted);
+
+    // Whether the file's rows are still known to be in time order; a decoded block can show they are not
+    bool inTimeOrder(const std::string &file_name);
+
+    // Rows [block_index * kRowsPerBlock, ...) of the file, decoded; nullptr if they can't be read
+    std::shared_ptr<Block const> block(const std::string &file_name, uint64_t block_index);
+
+    // Drops the handles and blocks of a file that was changed, renamed or removed
+    void invalidate(const std::string &file_name);
+
+    // Same for several files, in one pass over the cached blocks
+    void invalidate(std::vector<std::string> const &file_names);
+
+    void clear();
+
+    Stats stats() const;
+
+    size_t memoryBudget() const { return memory_budget_; }
+
+private:
+    struct OpenFile;
+
+    struct BlockEntry
+    {
+        std::shared_ptr<Block const> block;
+        size_t bytes;
+        std::list<std::pair<std::string, uint64_t>>::iterator lru;
+    };
+
+    struct BlockKeyHash
+    {
+        size_t operator()(std::pair<std::string, uint64_t> const &key) const
+        {
+            return std::hash<std::string>()(key.first) ^ (std::hash<uint64_t>()(key.second) * 0x9e3779b97f4a7c15ULL);
+        }
+    };
+
+    std::shared_ptr<OpenFile> openFile(const std::string &file_name);
+
+    size_t memory_budget_;
+    size_t max_open_files_;
+
+    mutable std::mutex mutex_;
+    // most recently used first
+    std::list<std::string> file_lru_;
+    std::unordered_map<std::string, std::pair<std::shared_ptr<OpenFile>, std::list<std::string>::iterator>> files_;
+    std::list<std::pair<std::string, uint64_t>> block_lru_;
+    std::unordered_map<std::pair<std::string, uint64_t>, BlockEntry, BlockKeyHash> blocks_;
+    size_t cached_bytes_ = 0;
+    // the last handle opened of each file until it is closed, whether cached or not; guarded by the HDF5 lock
+    struct LiveFile
+    {
+        std::weak_ptr<OpenFile> handle;
+        OpenFile const* open_file;
+    };
+    std::unordered_map<std::string, LiveFile> live_files_;
+    std::condition_variable file_closed_;
+    // bumped by every invalidation, so a handle opened or a block read while one happened is not cached stale
+    uint64_t generation_ = 0;
+    uint64_t block_hits_ = 0;
+    uint64_t block_misses_ = 0;
+    uint64_t file_opens_ = 0;
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_STORYFILECACHE_H
@@ -0,0 +1,267 @@
+#ifndef CHRONOLOG_STORYFILECATALOG_H
+#define CHRONOLOG_STORYFILECATALOG_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "StoryFileIndex.h"
+
+namespace chronolog
+{
+
+// Persistent catalog of the story files of an archive directory, so a reader
+// does not have to list and parse the whole directory on every start.
+//
+// Layout (native byte order): "CHRCAT01", u32 version, u32 entry count,
+// i64 directory mtime, i64 time the catalog was built, then per file
+// u64 start_time, u64 end_time and the u16-length-prefixed
+// chronicle, story and file base names, and a trailing FNV-1a checksum of
+// everything before it.
+//
+// The catalog lives in a subdirectory of the archive, so writing it modifies
+// neither the archive directory's mtime nor anything its monitor watches. If
+// the directory mtime still matches the recorded one the catalog is taken as
+// is; otherwise the directory is listed and only names the catalog does not
+// know are parsed. Everything an entry holds comes from the file name, so a
+// file rewritten under the same name needs no update.
+class StoryFileCatalog
+{
+public:
+    struct Entry
+    {
+        StoryFileInfo info;   // file_name holds the full path
+    };
+
+    // Parses a story file path, false if it is not one
+    using FileParser = std::function<bool(const std::string &, StoryFileInfo &)>;
+
+    static constexpr uint32_t kVersion = 2;
+    // A directory changed this close to when the catalog was built may have
+    // changed again within the same timestamp tick, so it is rescanned
+    static constexpr int64_t kRacyWindowNs = 2000000000LL;
+
+    explicit StoryFileCatalog(std::string const &archive_path)
+        : archive_path_(archive_path)
+        , catalog_path_((std::filesystem::path(archive_path) / ".chronolog_catalog" / "story_files.bin").string())
+    {}
+
+    std::string const &path() const { return catalog_path_; }
+
+    std::vector<Entry> const &entries() const { return entries_; }
+
+    // Brings the catalog up to date with the archive directory, rewriting the
+    // file if anything changed. Returns the number of files added or removed.
+    size_t refresh(FileParser const &parse)
+    {
+        bool loaded = load();
+        int64_t dir_mtime = 0;
+        if(!mtimeOf(archive_path_, dir_mtime)) {
+            entries_.clear();
+            return 0;
+        }
+        if(loaded && dir_mtime == dir_mtime_ns_ && dir_mtime + kRacyWindowNs < built_ns_) {
+            return 0;
+        }
+
+        // taken before listing, so a change made while listing shows up as a newer mtime next time
+        int64_t now = nowNs();
+        std::unordered_map<std::string, size_t> known;
+        for(size_t i = 0; i < entries_.size(); ++i) {
+            known.emplace(entries_[i].info.file_name, i);
+        }
+        std::vector<Entry> updated;
+        updated.reserve(entries_.size());
+        size_t kept = 0, added = 0;
+        std::error_code ec;
+        for(auto const &dir_entry: std::filesystem::directory_iterator(archive_path_, ec)) {
+            std::string file_name = dir_entry.path().string();
+            auto it = known.find(file_name);
+            if(it != known.end()) {
+                updated.push_back(std::move(entries_[it->second]));
+                ++kept;
+                continue;
+            }
+            Entry entry;
+            if(!parse(file_name, entry.info)) {
+                continue;
+            }
+            updated.push_back(std::move(entry));
+            ++added;
+        }
+        size_t changes = added + (known.size() - kept);
+        entries_ = std::move(updated);
+        dir_mtime_ns_ = dir_mtime;
+        built_ns_ = now;
+
+        // even without changes, a new build time lets the next start skip the listing
+        save();
+        return changes;
+    }
+
+    // Reads the catalog file; false, with no entries, if it is missing, of
+    // another version or damaged
+    bool load()
+    {
+        entries_.clear();
+        std::ifstream in(catalog_path_, std::ios::binary);
+        if(!in) {
+            return false;
+        }
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if(data.size() < kHeaderSize + sizeof(uint64_t) || data.compare(0, 8, kMagic) != 0) {
+            return false;
+        }
+        uint64_t checksum;
+        std::memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+        if(checksum != fnv1a(data.data(), data.size() - sizeof(checksum))) {
+            return false;
+        }
+
+        Reader reader{data.data() + 8, data.data() + data.size() - sizeof(checksum)};
+        uint32_t version = 0, count = 0;
+        if(!reader.get(version) || version != kVersion || !reader.get(count) || !reader.get(dir_mtime_ns_) ||
+           !reader.get(built_ns_)) {
+            return false;
+        }
+        std::filesystem::path dir(archive_path_);
+        std::vector<Entry> entries(count);
+        for(auto &entry: entries) {
+            std::string base_name;
+            if(!reader.get(entry.info.start_time) || !reader.get(entry.info.end_time) ||
+               !reader.get(entry.info.chronicle_name) || !reader.get(entry.info.story_name) ||
+               !reader.get(base_name)) {
+                return false;
+            }
+            entry.info.file_name = (dir / base_name).string();
+        }
+        if(reader.pos != reader.end) {
+            return false;
+        }
+        entries_ = std::move(entries);
+        return true;
+    }
+
+    // Written to a temporary file of this process and renamed over the old
+    // catalog, so a reader never sees a partial one and readers starting
+    // together don't write into each other's; failures only cost the next
+    // start a full scan
+    bool save() const
+    {
+        std::string data(kMagic, 8);
+        put(data, kVersion);
+        put(data, static_cast<uint32_t>(entries_.size()));
+        put(data, dir_mtime_ns_);
+        put(data, built_ns_);
+        for(auto const &entry: entries_) {
+            put(data, entry.info.start_time);
+            put(data, entry.info.end_time);
+            put(data, entry.info.chronicle_name);
+            put(data, entry.info.story_name);
+            put(data, std::filesystem::path(entry.info.file_name).filename().string());
+        }
+        put(data, fnv1a(data.data(), data.size()));
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(catalog_path_).parent_path(), ec);
+        std::string temp_path = catalog_path_ + ".tmp." + std::to_string(getpid());
+        bool written;
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            written = bool(out.write(data.data(), static_cast<std::streamsize>(data.size())));
+        }
+        if(!written || std::rename(temp_path.c_str(), catalog_path_.c_str()) != 0) {
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr char kMagic[] = "CHRCAT01";
+    static constexpr size_t kHeaderSize = 8 + 2 * sizeof(uint32_t) + 2 * sizeof(int64_t);
+
+    struct Reader
+    {
+        char const* pos;
+        char const* end;
+
+        template <typename T>
+        bool get(T &value)
+        {
+            if(size_t(end - pos) < sizeof(T)) {
+                return false;
+            }
+            std::memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+            return true;
+        }
+
+        bool get(std::string &value)
+        {
+            uint16_t length;
+            if(!get(length) || size_t(end - pos) < length) {
+                return false;
+            }
+            value.assign(pos, length);
+            pos += length;
+            return true;
+        }
+    };
+
+    template <typename T>
+    static void put(std::string &data, T value)
+    {
+        data.append(reinterpret_cast<char const*>(&value), sizeof(T));
+    }
+
+    static void put(std::string &data, std::string const &value)
+    {
+        put(data, static_cast<uint16_t>(value.size()));
+        data.append(value, 0, uint16_t(value.size()));
+    }
+
+    static uint64_t fnv1a(char const* data, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for(size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    static bool mtimeOf(std::string const &path, int64_t &mtime_ns)
+    {
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0) {
+            return false;
+        }
+        mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::string archive_path_;
+    std::string catalog_path_;
+    std::vector<Entry> entries_;
+    int64_t dir_mtime_ns_ = 0;
+    int64_t built_ns_ = 0;
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_STORYFILECATALOG_H
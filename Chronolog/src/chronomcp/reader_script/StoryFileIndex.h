@@ -0,0 +1,321 @@
+#ifndef CHRONOLOG_STORYFILEINDEX_H
+#define CHRONOLOG_STORYFILEINDEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace chronolog
+{
+
+// Story file names only carry a start time; a file whose last event time is
+// not known yet is taken to end where the next file of its story starts
+constexpr uint64_t kUnknownEndTime = std::numeric_limits<uint64_t>::max();
+
+struct StoryFileInfo
+{
+    std::string chronicle_name;
+    std::string story_name;
+    uint64_t start_time = 0;
+    uint64_t end_time = kUnknownEndTime;
+    std::string file_name;
+};
+
+struct StoryFileEntry
+{
+    uint64_t start_time;
+    uint64_t end_time;   // inclusive bound on the event times in the file
+    std::string file_name;
+};
+
+// All archived files of one story, sorted by start time. max_end_time[i] is
+// the largest end_time among entries[0..i]; it never decreases, so the first
+// file that can reach a given time is found by binary search even when file
+// ranges overlap.
+struct StoryFiles
+{
+    std::vector<StoryFileEntry> entries;
+    std::vector<uint64_t> max_end_time;
+    // Raw end times as reported, kUnknownEndTime where the name is all we have
+    std::vector<uint64_t> reported_end_time;
+
+    void rebuildBounds()
+    {
+        max_end_time.resize(entries.size());
+        uint64_t running = 0;
+        for(size_t i = 0; i < entries.size(); ++i) {
+            uint64_t end = reported_end_time[i];
+            if(end == kUnknownEndTime && i + 1 < entries.size()) {
+                end = entries[i + 1].start_time > entries[i].start_time ? entries[i + 1].start_time - 1
+                                                                        : entries[i].start_time;
+            }
+            entries[i].end_time = end;
+            running = std::max(running, end);
+            max_end_time[i] = running;
+        }
+    }
+};
+
+// Immutable state of the index. Readers hold a snapshot for as long as they
+// need it while updates publish new ones, so a query never waits on the
+// file-system monitor and always sees a consistent set of files.
+class StoryFileIndexSnapshot
+{
+public:
+    // Files of the story whose time range overlaps [start_time, end_time], in
+    // start-time order: O(log n + k) for a story of n files and k results
+    std::vector<StoryFileEntry> findFiles(std::string const &chronicle_name, std::string const &story_name,
+                                          uint64_t start_time, uint64_t end_time) const
+    {
+        std::vector<StoryFileEntry> result;
+        StoryFiles const* files = findStory(chronicle_name, story_name);
+        if(files == nullptr || start_time > end_time) {
+            return result;
+        }
+
+        auto const &entries = files->entries;
+        auto first = std::lower_bound(files->max_end_time.begin(), files->max_end_time.end(), start_time);
+        for(size_t i = first - files->max_end_time.begin(); i < entries.size() && entries[i].start_time <= end_time; ++i) {
+            if(entries[i].end_time >= start_time) {
+                result.push_back(entries[i]);
+            }
+        }
+        return result;
+    }
+
+    StoryFiles const* findStory(std::string const &chronicle_name, std::string const &story_name) const
+    {
+        uint32_t key;
+        if(!lookupKey(chronicle_name, story_name, key) || key >= stories_.size() || !stories_[key]) {
+            return nullptr;
+        }
+        return stories_[key].get();
+    }
+
+    size_t fileCount() const { return file_count_; }
+
+    // Names of every file in the index, in no particular order
+    std::vector<std::string> fileNames() const
+    {
+        std::vector<std::string> names;
+        names.reserve(file_count_);
+        for(auto const &files: stories_) {
+            if(files) {
+                for(auto const &entry: files->entries) {
+                    names.push_back(entry.file_name);
+                }
+            }
+        }
+        return names;
+    }
+
+private:
+    friend class StoryFileIndex;
+
+    // Interned names; shared between snapshots until a new name shows up
+    struct Names
+    {
+        std::unordered_map<std::string, uint32_t> chronicles;
+        std::unordered_map<std::string, uint32_t> stories;
+        // (chronicle id << 32 | story name id) -> dense story key
+        std::unordered_map<uint64_t, uint32_t> story_keys;
+    };
+
+    bool lookupKey(std::string const &chronicle_name, std::string const &story_name, uint32_t &key) const
+    {
+        auto chronicle = names_->chronicles.find(chronicle_name);
+        auto story = names_->stories.find(story_name);
+        if(chronicle == names_->chronicles.end() || story == names_->stories.end()) {
+            return false;
+        }
+        auto it = names_->story_keys.find((uint64_t(chronicle->second) << 32) | story->second);
+        if(it == names_->story_keys.end()) {
+            return false;
+        }
+        key = it->second;
+        return true;
+    }
+
+    std::shared_ptr<Names const> names_ = std::make_shared<Names>();
+    std::vector<std::shared_ptr<StoryFiles const>> stories_;
+    size_t file_count_ = 0;
+};
+
+// Two-level index of the archive: interned chronicle/story ids pointing at a
+// sorted array of (start_time, end_time, file) per story. Updates are
+// copy-on-write: only the arrays of the stories they touch are copied, the
+// interned names only when a new one is added, and the result is published
+// as a new snapshot in one atomic swap.
+class StoryFileIndex
+{
+public:
+    // A set of changes applied together as a single new snapshot. A removal
+    // names the file's chronicle and story as well, which is how the index
+    // finds it; start and end times of removals are not used.
+    struct Update
+    {
+        std::vector<StoryFileInfo> added;
+        std::vector<StoryFileInfo> removed;
+
+        bool empty() const { return added.empty() && removed.empty(); }
+    };
+
+    StoryFileIndex()
+        : current_(std::make_shared<StoryFileIndexSnapshot>())
+    {}
+
+    std::shared_ptr<StoryFileIndexSnapshot const> snapshot() const { return std::atomic_load(&current_); }
+
+    // Removals are applied before additions, so a rename is one update that
+    // removes the old name and adds the new one; adding a file name the story
+    // already has replaces its entry. The cost is that of copying the stories
+    // touched, plus the interned names when the update brings a new one.
+    void apply(Update const &update)
+    {
+        if(update.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(update_mutex_);
+        auto const base = snapshot();
+        auto next = std::make_shared<StoryFileIndexSnapshot>(*base);
+
+        std::shared_ptr<StoryFileIndexSnapshot::Names> names;
+        auto writable_names = [&]() -> StoryFileIndexSnapshot::Names & {
+            if(!names) {
+                names = std::make_shared<StoryFileIndexSnapshot::Names>(*base->names_);
+                next->names_ = names;
+            }
+            return *names;
+        };
+
+        // Stories copied by this update, with the names removed from each, made sorted again at the end
+        std::unordered_map<uint32_t, std::shared_ptr<StoryFiles>> touched;
+        std::unordered_map<uint32_t, std::unordered_set<std::string>> removed;
+        auto writable_story = [&](uint32_t key) -> StoryFiles & {
+            auto it = touched.find(key);
+            if(it != touched.end()) {
+                return *it->second;
+            }
+            auto files = key < next->stories_.size() && next->stories_[key]
+                             ? std::make_shared<StoryFiles>(*next->stories_[key])
+                             : std::make_shared<StoryFiles>();
+            next->file_count_ -= files->entries.size();
+            touched.emplace(key, files);
+            return *files;
+        };
+
+        for(auto const &info : update.removed) {
+            uint32_t key;
+            if(next->lookupKey(info.chronicle_name, info.story_name, key)) {
+                writable_story(key);
+                removed[key].insert(info.file_name);
+            }
+        }
+        // one pass per story, however many of its files go
+        for(auto const &[key, file_names] : removed) {
+            StoryFiles &files = *touched[key];
+            size_t kept = 0;
+            for(size_t i = 0; i < files.entries.size(); ++i) {
+                if(file_names.count(files.entries[i].file_name) != 0) {
+                    continue;
+                }
+                if(kept != i) {
+                    files.entries[kept] = std::move(files.entries[i]);
+                    files.reported_end_time[kept] = files.reported_end_time[i];
+                }
+                ++kept;
+            }
+            files.entries.resize(kept);
+            files.reported_end_time.resize(kept);
+        }
+
+        for(auto const &info : update.added) {
+            uint32_t key;
+            if(!next->lookupKey(info.chronicle_name, info.story_name, key)) {
+                auto &n = writable_names();
+                uint32_t chronicle = n.chronicles.emplace(info.chronicle_name, uint32_t(n.chronicles.size()))
+                                             .first->second;
+                uint32_t story = n.stories.emplace(info.story_name, uint32_t(n.stories.size())).first->second;
+                key = n.story_keys.emplace((uint64_t(chronicle) << 32) | story, uint32_t(n.story_keys.size()))
+                              .first->second;
+                if(key >= next->stories_.size()) {
+                    next->stories_.resize(key + 1);
+                }
+            }
+            StoryFiles &files = writable_story(key);
+            files.entries.push_back(StoryFileEntry{info.start_time, info.end_time, info.file_name});
+            files.reported_end_time.push_back(info.end_time);
+        }
+
+        for(auto &[key, files] : touched) {
+            sortEntries(*files);
+            files->rebuildBounds();
+            next->file_count_ += files->entries.size();
+            next->stories_[key] = std::move(files);
+        }
+        std::atomic_store(&current_, std::shared_ptr<StoryFileIndexSnapshot const>(std::move(next)));
+    }
+
+    void add(StoryFileInfo info)
+    {
+        Update update;
+        update.added.push_back(std::move(info));
+        apply(update);
+    }
+
+    void remove(StoryFileInfo info)
+    {
+        Update update;
+        update.removed.push_back(std::move(info));
+        apply(update);
+    }
+
+    size_t size() const { return snapshot()->fileCount(); }
+
+private:
+    // Sorts by start time and drops all but the last added entry of a file name; the names of one story
+    // carry its start time, so entries of the same file end up next to each other
+    static void sortEntries(StoryFiles &files)
+    {
+        std::vector<size_t> order(files.entries.size());
+        for(size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return files.entries[a].start_time != files.entries[b].start_time
+                       ? files.entries[a].start_time < files.entries[b].start_time
+                       : files.entries[a].file_name < files.entries[b].file_name;
+        });
+        std::vector<StoryFileEntry> entries;
+        std::vector<uint64_t> reported;
+        entries.reserve(order.size());
+        reported.reserve(order.size());
+        for(size_t i : order) {
+            if(!entries.empty() && entries.back().file_name == files.entries[i].file_name &&
+               entries.back().start_time == files.entries[i].start_time) {
+                entries.back() = std::move(files.entries[i]);
+                reported.back() = files.reported_end_time[i];
+                continue;
+            }
+            entries.push_back(std::move(files.entries[i]));
+            reported.push_back(files.reported_end_time[i]);
+        }
+        files.entries = std::move(entries);
+        files.reported_end_time = std::move(reported);
+    }
+
+    std::shared_ptr<StoryFileIndexSnapshot const> current_;
+    std::mutex update_mutex_;
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_STORYFILEINDEX_H
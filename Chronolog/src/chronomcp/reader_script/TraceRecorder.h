@@ -0,0 +1,118 @@
+#ifndef CHRONOLOG_TRACERECORDER_H
+#define CHRONOLOG_TRACERECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace chronolog
+{
+
+// Process-wide recorder of timed spans of the read path, written out in the
+// Chrome trace event format (chrome://tracing, Perfetto). Recording is off
+// until enable() is called; a span then costs one atomic load.
+class TraceRecorder
+{
+public:
+    static TraceRecorder &instance()
+    {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    void enable() { enabled_.store(true, std::memory_order_relaxed); }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Microseconds since the recorder was created
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin_)
+                .count();
+    }
+
+    // name must outlive the recorder; spans use string literals
+    void record(char const* name, int64_t start_us, int64_t duration_us)
+    {
+        static std::atomic<uint32_t> next_thread{0};
+        thread_local uint32_t thread = next_thread++;
+        std::lock_guard<std::mutex> lock(mutex_);
+        spans_.push_back(Span{name, start_us, duration_us, thread});
+    }
+
+    // Writes {"traceEvents": [...]} with one complete ("X") event per span; false if the file can't be written
+    bool writeChromeTrace(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if(!out) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        out << "{\"traceEvents\":[";
+        for(size_t i = 0; i < spans_.size(); ++i) {
+            Span const &span = spans_[i];
+            out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << span.name << "\",\"cat\":\"chronolog.read\","
+                << "\"ph\":\"X\",\"ts\":" << span.start_us << ",\"dur\":" << span.duration_us
+                << ",\"pid\":1,\"tid\":" << span.thread << "}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return bool(out);
+    }
+
+    size_t spanCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return spans_.size();
+    }
+
+private:
+    struct Span
+    {
+        char const* name;
+        int64_t start_us;
+        int64_t duration_us;
+        uint32_t thread;
+    };
+
+    TraceRecorder()
+        : origin_(std::chrono::steady_clock::now())
+    {}
+
+    std::atomic<bool> enabled_{false};
+    std::chrono::steady_clock::time_point origin_;
+    mutable std::mutex mutex_;
+    std::vector<Span> spans_;
+};
+
+// Records the time from its construction to its destruction as a span, if tracing is enabled
+class TraceSpan
+{
+public:
+    explicit TraceSpan(char const* name)
+        : name_(TraceRecorder::instance().enabled() ? name : nullptr)
+        , start_us_(name_ ? TraceRecorder::instance().now() : 0)
+    {}
+
+    ~TraceSpan()
+    {
+        if(name_) {
+            TraceRecorder &recorder = TraceRecorder::instance();
+            recorder.record(name_, start_us_, recorder.now() - start_us_);
+        }
+    }
+
+    TraceSpan(TraceSpan const &) = delete;
+    TraceSpan &operator=(TraceSpan const &) = delete;
+
+private:
+    char const* name_;
+    int64_t start_us_;
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_TRACERECORDER_H
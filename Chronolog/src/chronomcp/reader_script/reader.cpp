@@ -4,19 +4,21 @@
 #include <list>
 #include <climits>
 
+#include "EventWriter.h"
 #include "HDF5ArchiveReadingAgent.h"
 #include "ConfigurationManager.h"
+#ifdef CHRONOLOG_READER_SERVICE
+#include "ReaderService.h"
+#endif
 #include "chrono_monitor.h"
 
 namespace tl = thallium;
 
 std::atomic<bool> running(true);
-std::list<chronolog::StoryChunk*> list_of_chunks;
 chronolog::HDF5ArchiveReadingAgent* agent_ptr = nullptr;
 
 void signalHandler(int sig) {
     std::cout << "Interrupt (" << sig << ")\n";
-    for(auto *c : list_of_chunks) delete c;
     if(agent_ptr) agent_ptr->shutdown(), delete agent_ptr;
     std::exit(sig);
 }
@@ -28,6 +30,12 @@ int main(int argc, char** argv) {
     std::string story_name     = "conversation";
     uint64_t start_time = 1736800000000000000ULL;
     uint64_t end_time   = 1745539189396295796ULL + 1000000000000000ULL;
+    size_t limit = 0;            // 0: the whole range
+    std::string after;
+    std::string format_name = "text";
+    bool serve = false;          // answer JSON-RPC queries on stdin instead of one read
+    size_t service_workers = 0;
+    size_t cache_mb = chronolog::StoryFileCache::kDefaultMemoryBudget >> 20;
 
     // ── simple flag loop ──
     for(int i = 1; i < argc; ++i) {
@@ -42,6 +50,18 @@ int main(int argc, char** argv) {
             start_time = std::stoull(argv[++i]);
         } else if((a == "-et" || a == "--end") && i+1 < argc) {
             end_time = std::stoull(argv[++i]);
+        } else if((a == "-n" || a == "--limit") && i+1 < argc) {
+            limit = std::stoull(argv[++i]);
+        } else if((a == "-a" || a == "--after") && i+1 < argc) {
+            after = argv[++i];
+        } else if(a == "--serve") {
+            serve = true;
+        } else if((a == "-w" || a == "--workers") && i+1 < argc) {
+            service_workers = std::stoul(argv[++i]);
+        } else if(a == "--cache-mb" && i+1 < argc) {
+            cache_mb = std::stoull(argv[++i]);
+        } else if((a == "-f" || a == "--format") && i+1 < argc) {
+            format_name = argv[++i];
         }
         // else: ignore unknowns
     }
@@ -49,14 +69,33 @@ int main(int argc, char** argv) {
         std::cerr << "Usage: " << argv[0]
                   << " -c <config.json>"
                   << " [-C chronicle] [-S story]"
-                  << " [-s startTime] [-e endTime]\n";
+                  << " [-s startTime] [-e endTime]"
+                  << " [-n limit] [-a cursor] [-f text|ndjson|columnar]"
+                  << " [--serve [-w workers]] [--cache-mb MB]\n";
+        return EXIT_FAILURE;
+    }
+    chronolog::EventWriter::Format format;
+    if(!chronolog::EventWriter::parseFormat(format_name, format)) {
+        std::cerr << "Unknown output format \"" << format_name << "\", expected text, ndjson or columnar\n";
+        return EXIT_FAILURE;
+    }
+#ifndef CHRONOLOG_READER_SERVICE
+    if(serve) {
+        std::cerr << "Built without service mode; reconfigure with MCP_SERVER_ROOT set\n";
+        return EXIT_FAILURE;
+    }
+#endif
+    chronolog::StoryEventCursor cursor;
+    if(!chronolog::StoryEventCursor::parse(after, cursor)) {
+        std::cerr << "Invalid cursor \"" << after << "\", expected time:clientId:index\n";
         return EXIT_FAILURE;
     }
 
     // ── initialize logger ──
     ChronoLog::ConfigurationManager conf(conf_file);
+    // stdout carries the JSON-RPC stream when serving, so logs go to the log file
     int r = chronolog::chrono_monitor::initialize(
-        conf.CLIENT_CONF.CLIENT_LOG_CONF.LOGTYPE,
+        serve ? "file" : conf.CLIENT_CONF.CLIENT_LOG_CONF.LOGTYPE,
         conf.CLIENT_CONF.CLIENT_LOG_CONF.LOGFILE,
         conf.CLIENT_CONF.CLIENT_LOG_CONF.LOGLEVEL,
         conf.CLIENT_CONF.CLIENT_LOG_CONF.LOGNAME,
@@ -71,36 +110,41 @@ int main(int argc, char** argv) {
 
     // ── read & print ──
     std::string archive_path = conf.GRAPHER_CONF.EXTRACTOR_CONF.story_files_dir;
-    agent_ptr = new chronolog::HDF5ArchiveReadingAgent(archive_path);
+    agent_ptr = new chronolog::HDF5ArchiveReadingAgent(archive_path, 0, cache_mb << 20);
     agent_ptr->initialize();
 
-    std::cout << "Reading [" << start_time << "," << end_time << "] from "
-              << chronicle_name << "." << story_name << "\n";
-
-    agent_ptr->readArchivedStory(
-        chronicle_name, story_name, start_time, end_time, list_of_chunks
-    );
+#ifdef CHRONOLOG_READER_SERVICE
+    if(serve) {
+        // the agent, its index and the monitor stay warm until the client closes stdin
+        int code = chronolog::runReaderService(*agent_ptr, service_workers);
+        agent_ptr->shutdown();
+        delete agent_ptr;
+        agent_ptr = nullptr;
+        return code;
+    }
+#endif
 
-    std::cout << list_of_chunks.size() << " chunk(s) returned.\n";
-    for(auto *chunk : list_of_chunks) {
-        std::cout << "Chunk with " << chunk->getEventCount() << " events:\n";
-        for(auto const &kv : *chunk) {
-            auto const &e = kv.second;
-            std::cout
-                << "  storyId="   << e.storyId
-                << ", time="     << e.eventTime
-                << ", clientId=" << e.clientId
-                << ", index="    << e.eventIndex
-                << ", record=\"" << e.logRecord << "\"\n";
-        }
-        delete chunk;
+    // the machine-readable formats carry nothing but the events on stdout
+    if(format == chronolog::EventWriter::Format::Text) {
+        std::cout << "Reading [" << start_time << "," << end_time << "] from "
+                  << chronicle_name << "." << story_name << std::endl;
     }
 
-    // clean up story-chunks
-    for(auto *chunk : list_of_chunks) {
-        delete chunk;
+    // events are written as the merge produces them, so output starts after the first block is read
+    auto stream = agent_ptr->openStoryStream(chronicle_name, story_name, start_time, end_time, cursor);
+    auto writer = chronolog::EventWriter::create(format, stdout);
+    size_t count = 0;
+    chronolog::LogEvent e;
+    while((limit == 0 || count < limit) && stream->next(e)) {
+        ++count;
+        writer->write(e);
     }
-    list_of_chunks.clear();
+    // a full page says where the next one starts, if there is one
+    cursor = stream->cursor();
+    bool more = limit != 0 && count == limit && stream->next(e);
+    writer->finish(count, more ? &cursor : nullptr);
+    writer.reset();
+    stream.reset();
 
     // shut down the archive-reader threads and delete
     agent_ptr->shutdown();                // joins the monitoring thread :contentReference[oaicite:0]{index=0}:contentReference[oaicite:1]{index=1}
@@ -0,0 +1,352 @@
+// End-to-end benchmark of the archive read path. Generates a synthetic
+// archive of story files, then measures the catalog build, range queries
+// through the event stream (cold and warm cache) and through the parallel
+// chunk reader, reporting latency percentiles and event and byte rates.
+// With --trace, spans of the read path are written as a Chrome trace.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ArchiveFileFormat.h"
+#include "EventWriter.h"
+#include "HDF5ArchiveReadingAgent.h"
+#include "StoryFileCatalog.h"
+#include "TraceRecorder.h"
+#include "chrono_monitor.h"
+
+namespace tl = thallium;
+
+namespace
+{
+
+constexpr uint64_t kArchiveStartTime = 1736800000000000000ULL;
+constexpr uint64_t kEventSpacingNs = 1000;
+// bytes of an event besides its record: storyId, eventTime, clientId, eventIndex
+constexpr size_t kEventHeaderBytes = 24;
+
+struct Options
+{
+    std::string dir = "/tmp/chronolog_reader_bench";
+    size_t files = 64;
+    size_t events_per_file = 100000;
+    size_t record_bytes = 128;
+    size_t stories = 4;
+    size_t queries = 200;
+    double window = 0.01;   // fraction of a story's time span covered by one query
+    unsigned jobs = 0;
+    size_t cache_mb = chronolog::StoryFileCache::kDefaultMemoryBudget >> 20;
+    std::string trace;
+    bool keep = false;
+    uint64_t seed = 1;
+};
+
+struct Query
+{
+    std::string story;
+    uint64_t start_time;
+    uint64_t end_time;
+};
+
+struct PhaseResult
+{
+    std::vector<double> latencies_ms;
+    size_t events = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string storyName(size_t story)
+{
+    return "story_" + std::to_string(story);
+}
+
+uint64_t fileSpan(Options const &options)
+{
+    return options.events_per_file * kEventSpacingNs;
+}
+
+// Files of story k are consecutive in time; file i of the archive belongs to story i % stories
+void generateArchive(Options const &options)
+{
+    std::filesystem::create_directories(options.dir);
+    std::vector<std::string> records(64);
+    std::mt19937_64 random(options.seed);
+    for(auto &record: records) {
+        record.resize(options.record_bytes);
+        for(auto &c: record) {
+            c = static_cast<char>('a' + random() % 26);
+        }
+    }
+
+    H5::CompType type = chronolog::createLogEventType();
+    std::vector<chronolog::LogEventHVL> rows(options.events_per_file);
+    for(size_t file = 0; file < options.files; ++file) {
+        size_t story = file % options.stories;
+        uint64_t start_time = kArchiveStartTime + (file / options.stories) * fileSpan(options);
+        std::string file_name = (std::filesystem::path(options.dir) /
+                                 ("bench." + storyName(story) + "." + std::to_string(start_time) + ".vlen.h5"))
+                .string();
+        for(size_t row = 0; row < rows.size(); ++row) {
+            std::string const &record = records[row % records.size()];
+            rows[row] = chronolog::LogEventHVL{story + 1, start_time + row * kEventSpacingNs, uint32_t(row % 4),
+                                               uint32_t(row), {record.size(), const_cast<char*>(record.data())}};
+        }
+        H5::H5File h5_file(file_name, H5F_ACC_TRUNC);
+        h5_file.createGroup("/story_chunks");
+        hsize_t count = rows.size();
+        H5::DataSpace space(1, &count);
+        h5_file.createDataSet(STORY_CHUNK_DATASET, type, space).write(rows.data(), type);
+    }
+}
+
+// Removes what generateArchive and the reader wrote, and nothing else
+void removeArchive(Options const &options)
+{
+    std::error_code error;
+    for(auto const &entry: std::filesystem::directory_iterator(options.dir, error)) {
+        std::string name = entry.path().filename().string();
+        if(name.rfind("bench.", 0) == 0 && chronolog::HDF5ArchiveReadingAgent::isStoryFile(name)) {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+    std::filesystem::remove_all(std::filesystem::path(options.dir) / ".chronolog_catalog", error);
+}
+
+std::vector<Query> makeQueries(Options const &options)
+{
+    uint64_t story_span = ((options.files + options.stories - 1) / options.stories) * fileSpan(options);
+    uint64_t window = std::max<uint64_t>(uint64_t(story_span * options.window), kEventSpacingNs);
+    std::mt19937_64 random(options.seed + 1);
+    std::vector<Query> queries;
+    for(size_t i = 0; i < options.queries; ++i) {
+        uint64_t start_time = kArchiveStartTime + (window < story_span ? random() % (story_span - window) : 0);
+        queries.push_back(Query{storyName(random() % options.stories), start_time, start_time + window - 1});
+    }
+    return queries;
+}
+
+void addEvent(PhaseResult &result, chronolog::LogEvent const &event)
+{
+    ++result.events;
+    result.bytes += kEventHeaderBytes + event.logRecord.size();
+}
+
+// Queries through the event stream; events are collected first so output gets a span of its own
+PhaseResult runStreamQueries(chronolog::HDF5ArchiveReadingAgent &agent, std::vector<Query> const &queries,
+                             bool cold, FILE* sink)
+{
+    PhaseResult result;
+    std::vector<chronolog::LogEvent> events;
+    auto phase_start = std::chrono::steady_clock::now();
+    for(auto const &query: queries) {
+        if(cold) {
+            agent.clearCache();
+        }
+        auto start = std::chrono::steady_clock::now();
+        events.clear();
+        auto stream = agent.openStoryStream("bench", query.story, query.start_time, query.end_time);
+        chronolog::LogEvent event;
+        {
+            chronolog::TraceSpan span("stream");
+            while(stream->next(event)) {
+                events.push_back(event);
+            }
+        }
+        {
+            chronolog::TraceSpan span("output");
+            auto writer = chronolog::EventWriter::create(chronolog::EventWriter::Format::Columnar, sink);
+            for(auto const &e: events) {
+                writer->write(e);
+                addEvent(result, e);
+            }
+            writer->finish(events.size(), nullptr);
+        }
+        result.latencies_ms.push_back(secondsSince(start) * 1e3);
+    }
+    result.seconds = secondsSince(phase_start);
+    return result;
+}
+
+// Queries through readArchivedStory, which reads the files of a query in parallel on the read xstreams
+PhaseResult runChunkQueries(chronolog::HDF5ArchiveReadingAgent &agent, std::vector<Query> const &queries, FILE* sink)
+{
+    PhaseResult result;
+    auto phase_start = std::chrono::steady_clock::now();
+    for(auto const &query: queries) {
+        agent.clearCache();
+        auto start = std::chrono::steady_clock::now();
+        std::list<chronolog::StoryChunk*> chunks;
+        agent.readArchivedStory("bench", query.story, query.start_time, query.end_time, chunks);
+        {
+            chronolog::TraceSpan span("output");
+            auto writer = chronolog::EventWriter::create(chronolog::EventWriter::Format::Columnar, sink);
+            size_t count = 0;
+            for(auto* chunk: chunks) {
+                for(auto const &event: *chunk) {
+                    writer->write(event.second);
+                    addEvent(result, event.second);
+                    ++count;
+                }
+                delete chunk;
+            }
+            writer->finish(count, nullptr);
+        }
+        result.latencies_ms.push_back(secondsSince(start) * 1e3);
+    }
+    result.seconds = secondsSince(phase_start);
+    return result;
+}
+
+double percentile(std::vector<double> sorted, double fraction)
+{
+    if(sorted.empty()) {
+        return 0;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = std::min(sorted.size() - 1, size_t(std::max(0.0, fraction * sorted.size() - 1e-9)));
+    return sorted[index];
+}
+
+void printResult(const std::string &phase, PhaseResult const &result)
+{
+    std::printf("%-24s %8zu %9.3f %9.3f %9.3f %9.3f %12.0f %10.1f\n", phase.c_str(), result.latencies_ms.size(),
+                percentile(result.latencies_ms, 0.50), percentile(result.latencies_ms, 0.90),
+                percentile(result.latencies_ms, 0.99), percentile(result.latencies_ms, 1.0),
+                result.seconds > 0 ? result.events / result.seconds : 0,
+                result.seconds > 0 ? result.bytes / result.seconds / (1 << 20) : 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for(int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if((a == "-d" || a == "--dir") && i + 1 < argc) {
+            options.dir = argv[++i];
+        } else if((a == "-f" || a == "--files") && i + 1 < argc) {
+            options.files = std::stoull(argv[++i]);
+        } else if((a == "-e" || a == "--events") && i + 1 < argc) {
+            options.events_per_file = std::stoull(argv[++i]);
+        } else if((a == "-r" || a == "--record-bytes") && i + 1 < argc) {
+            options.record_bytes = std::stoull(argv[++i]);
+        } else if((a == "-s" || a == "--stories") && i + 1 < argc) {
+            options.stories = std::stoull(argv[++i]);
+        } else if((a == "-q" || a == "--queries") && i + 1 < argc) {
+            options.queries = std::stoull(argv[++i]);
+        } else if((a == "-w" || a == "--window") && i + 1 < argc) {
+            options.window = std::stod(argv[++i]);
+        } else if((a == "-j" || a == "--jobs") && i + 1 < argc) {
+            options.jobs = std::stoul(argv[++i]);
+        } else if(a == "--cache-mb" && i + 1 < argc) {
+            options.cache_mb = std::stoull(argv[++i]);
+        } else if(a == "--trace" && i + 1 < argc) {
+            options.trace = argv[++i];
+        } else if(a == "--keep") {
+            options.keep = true;
+        } else if(a == "--seed" && i + 1 < argc) {
+            options.seed = std::stoull(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-d dir] [-f files] [-e eventsPerFile] [-r recordBytes] [-s stories]"
+                      << " [-q queries] [-w windowFraction] [-j readStreams] [--cache-mb MB]"
+                      << " [--trace trace.json] [--keep] [--seed N]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(options.files == 0 || options.events_per_file == 0 || options.stories == 0) {
+        std::cerr << "files, events per file and stories must be positive\n";
+        return EXIT_FAILURE;
+    }
+    options.stories = std::min(options.stories, options.files);
+
+    int r = chronolog::chrono_monitor::initialize("console", "reader_bench.log", spdlog::level::warn, "reader_bench",
+                                                  1048576, 1, spdlog::level::warn);
+    if(r == 1) return EXIT_FAILURE;
+    tl::abt scope;
+
+    std::printf("archive %s: %zu files x %zu events, %zu-byte records, %zu stories\n", options.dir.c_str(),
+                options.files, options.events_per_file, options.record_bytes, options.stories);
+    removeArchive(options);
+    auto start = std::chrono::steady_clock::now();
+    generateArchive(options);
+    std::printf("generated in %.2f s\n", secondsSince(start));
+
+    if(!options.trace.empty()) {
+        chronolog::TraceRecorder::instance().enable();
+    }
+
+    // the catalog is what a reader start costs; the second refresh finds nothing new to parse
+    auto parser = [](const std::string &file_name, chronolog::StoryFileInfo &info) {
+        if(!chronolog::HDF5ArchiveReadingAgent::isStoryFile(file_name)) {
+            return false;
+        }
+        info = chronolog::HDF5ArchiveReadingAgent::getStoryFileInfo(file_name);
+        return true;
+    };
+    {
+        chronolog::StoryFileCatalog catalog(options.dir);
+        start = std::chrono::steady_clock::now();
+        size_t changes;
+        {
+            chronolog::TraceSpan span("catalog.build");
+            changes = catalog.refresh(parser);
+        }
+        std::printf("catalog build:   %9.3f ms (%zu files)\n", secondsSince(start) * 1e3, changes);
+        chronolog::StoryFileCatalog reloaded(options.dir);
+        start = std::chrono::steady_clock::now();
+        {
+            chronolog::TraceSpan span("catalog.refresh");
+            reloaded.refresh(parser);
+        }
+        std::printf("catalog refresh: %9.3f ms\n", secondsSince(start) * 1e3);
+    }
+
+    chronolog::HDF5ArchiveReadingAgent agent(options.dir, options.jobs, options.cache_mb << 20);
+    start = std::chrono::steady_clock::now();
+    agent.initialize();
+    std::printf("agent start:     %9.3f ms (%zu files indexed)\n\n", secondsSince(start) * 1e3,
+                agent.indexedFileCount());
+
+    FILE* sink = std::fopen("/dev/null", "wb");
+    std::vector<Query> queries = makeQueries(options);
+    std::printf("%-24s %8s %9s %9s %9s %9s %12s %10s\n", "phase", "queries", "p50 ms", "p90 ms", "p99 ms", "max ms",
+                "events/s", "MiB/s");
+    printResult("stream, cold cache", runStreamQueries(agent, queries, true, sink));
+    // the cold pass leaves the last query's blocks cached; one untimed pass caches the rest, budget permitting
+    runStreamQueries(agent, queries, false, sink);
+    printResult("stream, warm cache", runStreamQueries(agent, queries, false, sink));
+    printResult("parallel chunks, cold", runChunkQueries(agent, queries, sink));
+    std::fclose(sink);
+
+    chronolog::StoryFileCache::Stats cache = agent.cacheStats();
+    std::printf("\ncache: %lu block hits, %lu misses, %lu file opens\n", (unsigned long)cache.block_hits,
+                (unsigned long)cache.block_misses, (unsigned long)cache.file_opens);
+    agent.shutdown();
+
+    if(!options.trace.empty()) {
+        chronolog::TraceRecorder &recorder = chronolog::TraceRecorder::instance();
+        if(!recorder.writeChromeTrace(options.trace)) {
+            std::cerr << "Failed to write trace " << options.trace << "\n";
+            return EXIT_FAILURE;
+        }
+        std::printf("trace: %zu spans written to %s\n", recorder.spanCount(), options.trace.c_str());
+    }
+    if(!options.keep) {
+        removeArchive(options);
+    }
+    return 0;
+}
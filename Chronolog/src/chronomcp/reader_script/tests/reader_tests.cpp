@@ -0,0 +1,969 @@
+// Tests of the reader's index, catalog, event stream, cache and output formats on
+// small archives generated in a temporary directory. Built against the stub
+// headers in stubs/, so only HDF5 is needed; see CMakeLists.txt.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "ArchiveFileFormat.h"
+#include "EventWriter.h"
+#include "HDF5ArchiveReadingAgent.h"
+#include "StoryEventStream.h"
+#include "StoryFileCache.h"
+#include "StoryFileCatalog.h"
+#include "StoryFileIndex.h"
+
+namespace chronolog
+{
+
+// Feeds the agent directory events without inotify
+class HDF5ArchiveReadingAgentTest
+{
+public:
+    static void applyFileChanges(HDF5ArchiveReadingAgent &agent, std::unordered_map<std::string, bool> const &changes,
+                                 size_t event_count)
+    {
+        agent.applyFileChanges(changes, event_count, std::chrono::steady_clock::now());
+    }
+
+    static void rescanArchive(HDF5ArchiveReadingAgent &agent) { agent.rescanArchive(); }
+};
+
+} // chronolog
+
+namespace
+{
+
+using namespace chronolog;
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                   \
+    do {                                                                                                   \
+        if(!(condition)) {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl;     \
+            ++failures;                                                                                    \
+        }                                                                                                  \
+    } while(0)
+
+#define CHECK_EQ(actual, expected)                                                                         \
+    do {                                                                                                   \
+        auto const actual_value = (actual);                                                                \
+        auto const expected_value = (expected);                                                            \
+        if(!(actual_value == expected_value)) {                                                            \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is " << actual_value << ", expected " \
+                      << expected_value << std::endl;                                                      \
+            ++failures;                                                                                    \
+        }                                                                                                  \
+    } while(0)
+
+constexpr uint64_t kFileSpan = 1000000;
+constexpr uint64_t kEventSpacing = 100;
+// more rows than one cache block, so reads cross block boundaries
+constexpr size_t kEventsPerFile = StoryFileCache::kRowsPerBlock * 2 + 500;
+
+enum class RowOrder
+{
+    Sorted,
+    Reversed,
+    // shuffled within each block, first row of each block left in place
+    ShuffledBlocks
+};
+
+// A fresh directory under the system temp directory, removed with everything in it at the end of the scope
+struct TempDirectory
+{
+    std::filesystem::path path;
+
+    explicit TempDirectory(std::string const &name)
+        : path(std::filesystem::temp_directory_path() / (name + "." + std::to_string(getpid())))
+    {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+    }
+
+    ~TempDirectory()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+
+    std::string file(std::string const &name) const { return (path / name).string(); }
+};
+
+// Writes chronicle.story.<start_time>.vlen.h5 with events start_time + i * kEventSpacing and returns its path
+std::string writeStoryFile(TempDirectory const &dir, std::string const &chronicle, std::string const &story,
+                           uint64_t start_time, RowOrder order = RowOrder::Sorted)
+{
+    std::string file_name = dir.file(chronicle + "." + story + "." + std::to_string(start_time) + ".vlen.h5");
+    std::vector<std::string> records(kEventsPerFile);
+    std::vector<LogEventHVL> rows(kEventsPerFile);
+    for(size_t i = 0; i < rows.size(); ++i) {
+        records[i] = story + "-" + std::to_string(start_time + i * kEventSpacing);
+        rows[i] = LogEventHVL{7, start_time + i * kEventSpacing, uint32_t(i % 3), uint32_t(i),
+                              {records[i].size(), const_cast<char*>(records[i].data())}};
+    }
+    if(order == RowOrder::Reversed) {
+        std::reverse(rows.begin(), rows.end());
+    }
+    else if(order == RowOrder::ShuffledBlocks) {
+        std::mt19937 random(1);
+        for(size_t first = 0; first < rows.size(); first += StoryFileCache::kRowsPerBlock) {
+            std::shuffle(rows.begin() + first + 1,
+                         rows.begin() + std::min(rows.size(), first + StoryFileCache::kRowsPerBlock), random);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5Mutex());
+    H5::CompType type = createLogEventType();
+    H5::H5File h5_file(file_name, H5F_ACC_TRUNC);
+    h5_file.createGroup("/story_chunks");
+    hsize_t count = rows.size();
+    H5::DataSpace space(1, &count);
+    h5_file.createDataSet(STORY_CHUNK_DATASET, type, space).write(rows.data(), type);
+    return file_name;
+}
+
+// Replaces file_name, by rename as the archiver does, with a file whose events start at start_time
+void replaceStoryFile(TempDirectory const &staging, std::string const &file_name, uint64_t start_time)
+{
+    std::filesystem::rename(writeStoryFile(staging, "c", "s", start_time), file_name);
+}
+
+// Number of events a file written by writeStoryFile has in [start_time, end_time]
+size_t eventsInRange(uint64_t file_start, uint64_t start_time, uint64_t end_time)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < kEventsPerFile; ++i) {
+        uint64_t time = file_start + i * kEventSpacing;
+        count += time >= start_time && time <= end_time;
+    }
+    return count;
+}
+
+struct ReadResult
+{
+    size_t count = 0;
+    bool ordered = true;
+    uint64_t first_time = 0;
+    uint64_t last_time = 0;
+};
+
+ReadResult drain(StoryEventStream &stream, size_t limit = 0)
+{
+    ReadResult result;
+    LogEvent event;
+    StoryEventCursor previous;
+    while((limit == 0 || result.count < limit) && stream.next(event)) {
+        if(!previous.isBefore(event.eventTime, event.clientId, event.eventIndex)) {
+            result.ordered = false;
+        }
+        previous = stream.cursor();
+        if(result.count == 0) {
+            result.first_time = event.eventTime;
+        }
+        result.last_time = event.eventTime;
+        ++result.count;
+    }
+    return result;
+}
+
+void testIndexLookup()
+{
+    StoryFileIndex index;
+    StoryFileIndex::Update update;
+    for(uint64_t i = 0; i < 10; ++i) {
+        update.added.push_back({"c", "s", i * 100, kUnknownEndTime, "s" + std::to_string(i)});
+    }
+    update.added.push_back({"c", "t", 50, kUnknownEndTime, "t0"});
+    index.apply(update);
+    CHECK_EQ(index.size(), size_t(11));
+
+    // an unknown end is taken to be just before the next file of the story
+    auto files = index.snapshot()->findFiles("c", "s", 250, 420);
+    CHECK_EQ(files.size(), size_t(3));
+    CHECK_EQ(files.front().file_name, std::string("s2"));
+    CHECK_EQ(files.front().end_time, uint64_t(299));
+    CHECK_EQ(files.back().file_name, std::string("s4"));
+    // the last file of a story may run to the end of time
+    auto last = index.snapshot()->findFiles("c", "s", 5000, 6000);
+    CHECK_EQ(last.size(), size_t(1));
+    CHECK_EQ(last.front().end_time, kUnknownEndTime);
+    CHECK(index.snapshot()->findFiles("c", "s", 420, 250).empty());
+    CHECK(index.snapshot()->findFiles("x", "s", 0, 1000).empty());
+    CHECK(index.snapshot()->findFiles("c", "t", 0, 10).empty());
+    CHECK_EQ(index.snapshot()->findFiles("c", "t", 0, 60).size(), size_t(1));
+}
+
+void testIndexUpdates()
+{
+    StoryFileIndex index;
+    for(uint64_t i = 0; i < 5; ++i) {
+        index.add({"c", "s", i * 100, kUnknownEndTime, "s" + std::to_string(i)});
+    }
+    auto before = index.snapshot();
+
+    // a removed file's range is covered by the file before it; the old snapshot doesn't change
+    index.remove({"c", "s", 200, kUnknownEndTime, "s2"});
+    auto files = index.snapshot()->findFiles("c", "s", 250, 260);
+    CHECK_EQ(files.size(), size_t(1));
+    CHECK_EQ(files.front().file_name, std::string("s1"));
+    CHECK_EQ(files.front().end_time, uint64_t(299));
+    CHECK_EQ(before->findFiles("c", "s", 250, 260).front().file_name, std::string("s2"));
+    CHECK_EQ(before->fileCount(), size_t(5));
+    CHECK_EQ(index.size(), size_t(4));
+
+    // adding a known name replaces its entry
+    index.add({"c", "s", 300, 350, "s3"});
+    CHECK_EQ(index.size(), size_t(4));
+    files = index.snapshot()->findFiles("c", "s", 360, 370);
+    CHECK(files.empty());
+
+    // removals go first, so a rename is one update
+    StoryFileIndex::Update rename;
+    rename.removed.push_back({"c", "s", 400, kUnknownEndTime, "s4"});
+    rename.added.push_back({"c", "s", 400, kUnknownEndTime, "s4.renamed"});
+    index.apply(rename);
+    CHECK_EQ(index.size(), size_t(4));
+    CHECK_EQ(index.snapshot()->findFiles("c", "s", 450, 450).front().file_name, std::string("s4.renamed"));
+
+    // removing what isn't there changes nothing
+    index.remove({"c", "nope", 0, kUnknownEndTime, "s0"});
+    index.remove({"c", "s", 0, kUnknownEndTime, "missing"});
+    CHECK_EQ(index.size(), size_t(4));
+}
+
+void testIndexOverlaps()
+{
+    // files of known, overlapping ranges across a few stories, checked against a scan of all of them
+    std::mt19937 random(7);
+    StoryFileIndex::Update update;
+    for(size_t i = 0; i < 20000; ++i) {
+        uint64_t start = random() % 1000000;
+        std::string story = "s" + std::to_string(i % 5);
+        update.added.push_back({"c", story, start, start + random() % 5000, story + "." + std::to_string(i)});
+    }
+    StoryFileIndex index;
+    index.apply(update);
+    CHECK_EQ(index.size(), update.added.size());
+    CHECK_EQ(index.snapshot()->fileNames().size(), update.added.size());
+
+    for(int query = 0; query < 200; ++query) {
+        uint64_t start_time = random() % 1000000;
+        uint64_t end_time = start_time + random() % 20000;
+        std::string story = "s" + std::to_string(query % 5);
+        std::vector<std::string> expected;
+        for(auto const &info: update.added) {
+            if(info.story_name == story && info.start_time <= end_time && info.end_time >= start_time) {
+                expected.push_back(info.file_name);
+            }
+        }
+        auto files = index.snapshot()->findFiles("c", story, start_time, end_time);
+        CHECK(std::is_sorted(files.begin(), files.end(), [](StoryFileEntry const &a, StoryFileEntry const &b) {
+            return a.start_time < b.start_time;
+        }));
+        std::vector<std::string> found;
+        for(auto const &file: files) {
+            found.push_back(file.file_name);
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        CHECK(found == expected);
+    }
+}
+
+void testCatalog()
+{
+    TempDirectory dir("reader_tests.catalog");
+    for(uint64_t i = 0; i < 3; ++i) {
+        std::ofstream(dir.file("c.s." + std::to_string(i * kFileSpan) + ".vlen.h5")).put('x');
+    }
+    std::ofstream(dir.file("notes.txt")).put('x');
+    auto parse = [](std::string const &file_name, StoryFileInfo &info) {
+        if(!HDF5ArchiveReadingAgent::isStoryFile(file_name)) {
+            return false;
+        }
+        info = HDF5ArchiveReadingAgent::getStoryFileInfo(file_name);
+        return true;
+    };
+
+    StoryFileCatalog catalog(dir.path.string());
+    CHECK_EQ(catalog.refresh(parse), size_t(3));
+    CHECK_EQ(catalog.entries().size(), size_t(3));
+
+    StoryFileCatalog reloaded(dir.path.string());
+    CHECK(reloaded.load());
+    CHECK_EQ(reloaded.entries().size(), size_t(3));
+    std::vector<uint64_t> starts;
+    for(auto const &entry: reloaded.entries()) {
+        CHECK_EQ(entry.info.chronicle_name, std::string("c"));
+        CHECK_EQ(entry.info.story_name, std::string("s"));
+        starts.push_back(entry.info.start_time);
+    }
+    std::sort(starts.begin(), starts.end());
+    CHECK(starts == (std::vector<uint64_t>{0, kFileSpan, 2 * kFileSpan}));
+
+    std::filesystem::remove(dir.file("c.s.0.vlen.h5"));
+    std::ofstream(dir.file("c.s." + std::to_string(3 * kFileSpan) + ".vlen.h5")).put('x');
+    CHECK_EQ(StoryFileCatalog(dir.path.string()).refresh(parse), size_t(2));
+
+    // no temporary file is left next to the catalog
+    size_t catalog_files = 0;
+    for(auto const &entry: std::filesystem::directory_iterator(std::filesystem::path(catalog.path()).parent_path())) {
+        ++catalog_files;
+        CHECK_EQ(entry.path().filename().string(), std::string("story_files.bin"));
+    }
+    CHECK_EQ(catalog_files, size_t(1));
+
+    // a damaged catalog is not loaded, and the next refresh rebuilds it
+    std::string data;
+    {
+        std::ifstream in(catalog.path(), std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::string damaged = data;
+    damaged[damaged.size() / 2] ^= 0x40;
+    std::ofstream(catalog.path(), std::ios::binary | std::ios::trunc) << damaged;
+    CHECK(!StoryFileCatalog(dir.path.string()).load());
+    StoryFileCatalog rebuilt(dir.path.string());
+    CHECK_EQ(rebuilt.refresh(parse), size_t(3));
+    CHECK(StoryFileCatalog(dir.path.string()).load());
+
+    // so is one of another version, even with a valid checksum
+    StoryFileCatalog current(dir.path.string());
+    CHECK(current.load());
+    {
+        std::ifstream in(catalog.path(), std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint32_t other_version = StoryFileCatalog::kVersion + 1;
+    std::memcpy(&data[8], &other_version, sizeof(other_version));
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i + sizeof(uint64_t) < data.size(); ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+    }
+    std::memcpy(&data[data.size() - sizeof(hash)], &hash, sizeof(hash));
+    std::ofstream(catalog.path(), std::ios::binary | std::ios::trunc) << data;
+    CHECK(!StoryFileCatalog(dir.path.string()).load());
+
+    std::ofstream(catalog.path(), std::ios::binary | std::ios::trunc) << "CHRCAT01";
+    CHECK(!StoryFileCatalog(dir.path.string()).load());
+}
+
+void testCatalogIncremental()
+{
+    TempDirectory dir("reader_tests.catalog_incremental");
+    for(uint64_t i = 0; i < 3; ++i) {
+        std::ofstream(dir.file("c.s." + std::to_string(i * kFileSpan) + ".vlen.h5")).put('x');
+    }
+    // story files parsed; the other names, such as the catalog's own directory, are parsed on every listing
+    size_t parsed = 0;
+    auto parse = [&parsed](std::string const &file_name, StoryFileInfo &info) {
+        if(!HDF5ArchiveReadingAgent::isStoryFile(file_name)) {
+            return false;
+        }
+        ++parsed;
+        info = HDF5ArchiveReadingAgent::getStoryFileInfo(file_name);
+        return true;
+    };
+    CHECK_EQ(StoryFileCatalog(dir.path.string()).refresh(parse), size_t(3));
+    CHECK_EQ(parsed, size_t(3));
+
+    // a later start only parses the names the catalog doesn't know
+    parsed = 0;
+    std::ofstream(dir.file("c.s." + std::to_string(3 * kFileSpan) + ".vlen.h5")).put('x');
+    std::filesystem::remove(dir.file("c.s.0.vlen.h5"));
+    StoryFileCatalog catalog(dir.path.string());
+    CHECK_EQ(catalog.refresh(parse), size_t(2));
+    CHECK_EQ(parsed, size_t(1));
+    CHECK_EQ(catalog.entries().size(), size_t(3));
+
+    // once the directory is older than the catalog by more than the racy window, it isn't even listed: a
+    // file added behind an unchanged mtime goes unseen
+    auto set_directory_mtime = [&dir](time_t seconds) {
+        struct timespec times[2] = {{seconds, 0}, {seconds, 0}};
+        CHECK_EQ(utimensat(AT_FDCWD, dir.path.c_str(), times, 0), 0);
+    };
+    set_directory_mtime(1700000000);
+    CHECK_EQ(StoryFileCatalog(dir.path.string()).refresh(parse), size_t(0));
+    parsed = 0;
+    std::ofstream(dir.file("c.s." + std::to_string(4 * kFileSpan) + ".vlen.h5")).put('x');
+    set_directory_mtime(1700000000);
+    StoryFileCatalog unlisted(dir.path.string());
+    CHECK_EQ(unlisted.refresh(parse), size_t(0));
+    CHECK_EQ(parsed, size_t(0));
+    CHECK_EQ(unlisted.entries().size(), size_t(3));
+
+    // any change of the directory's mtime brings it back
+    set_directory_mtime(1700000060);
+    StoryFileCatalog listed(dir.path.string());
+    CHECK_EQ(listed.refresh(parse), size_t(1));
+    CHECK_EQ(parsed, size_t(1));
+    CHECK_EQ(listed.entries().size(), size_t(4));
+}
+
+void testCursorText()
+{
+    StoryEventCursor cursor;
+    CHECK(StoryEventCursor::parse("", cursor));
+    CHECK(!cursor.valid);
+    CHECK(StoryEventCursor::parse("1745539189396295796:3:17", cursor));
+    CHECK(cursor.valid);
+    CHECK_EQ(cursor.event_time, uint64_t(1745539189396295796ULL));
+    CHECK_EQ(cursor.client_id, uint32_t(3));
+    CHECK_EQ(cursor.event_index, uint32_t(17));
+    CHECK_EQ(cursor.toString(), std::string("1745539189396295796:3:17"));
+    CHECK(cursor.isBefore(1745539189396295796ULL, 3, 18));
+    CHECK(!cursor.isBefore(1745539189396295796ULL, 3, 17));
+    CHECK(!cursor.isBefore(1745539189396295795ULL, 9, 99));
+
+    for(char const* bad: {"12", "12:3", "a:1:2", "1:2:3x", "1::2", ":1:2"}) {
+        CHECK(!StoryEventCursor::parse(bad, cursor));
+        CHECK(!cursor.valid);
+    }
+}
+
+void testStreamRange()
+{
+    TempDirectory dir("reader_tests.stream");
+    StoryFileIndex index;
+    for(uint64_t i = 0; i < 3; ++i) {
+        index.add(HDF5ArchiveReadingAgent::getStoryFileInfo(writeStoryFile(dir, "c", "s", i * kFileSpan)));
+    }
+    StoryFileCache cache(size_t(1) << 20, 2);
+
+    // a range starting inside the first file's second block and ending inside the last file
+    uint64_t start_time = 5000 * kEventSpacing + 50;
+    uint64_t end_time = 2 * kFileSpan + 4100 * kEventSpacing;
+    size_t expected = 0;
+    for(uint64_t i = 0; i < 3; ++i) {
+        expected += eventsInRange(i * kFileSpan, start_time, end_time);
+    }
+    auto files = index.snapshot()->findFiles("c", "s", start_time, end_time);
+    CHECK_EQ(files.size(), size_t(3));
+    StoryEventStream stream(cache, files, start_time, end_time);
+    ReadResult all = drain(stream);
+    CHECK_EQ(all.count, expected);
+    CHECK(all.ordered);
+    CHECK_EQ(all.first_time, uint64_t(5001 * kEventSpacing));
+    CHECK_EQ(all.last_time, end_time);
+    CHECK_EQ(stream.failedFiles(), size_t(0));
+
+    // read again in pages, each resuming after the previous page's cursor
+    size_t paged = 0;
+    size_t pages = 0;
+    StoryEventCursor cursor;
+    while(true) {
+        StoryEventCursor resumed;
+        CHECK(StoryEventCursor::parse(cursor.toString(), resumed));
+        StoryEventStream page(cache, files, start_time, end_time, resumed);
+        ReadResult part = drain(page, 3000);
+        if(part.count == 0) {
+            break;
+        }
+        CHECK(part.ordered);
+        CHECK(!cursor.valid || part.first_time >= cursor.event_time);
+        paged += part.count;
+        cursor = page.cursor();
+        ++pages;
+    }
+    CHECK_EQ(paged, expected);
+    CHECK_EQ(pages, (expected + 2999) / 3000);
+
+    // a file listed twice yields its events twice; one that is gone is counted as failed
+    std::vector<StoryFileEntry> doubled = {files[0], files[0]};
+    StoryEventStream twice(cache, doubled, start_time, files[0].end_time);
+    CHECK_EQ(drain(twice).count, 2 * eventsInRange(0, start_time, files[0].end_time));
+    std::vector<StoryFileEntry> missing = {{0, kFileSpan - 1, dir.file("c.s.7.vlen.h5")}};
+    StoryEventStream gone(cache, missing, 0, kFileSpan);
+    CHECK_EQ(drain(gone).count, size_t(0));
+    CHECK_EQ(gone.failedFiles(), size_t(1));
+}
+
+void testStreamPrefetch()
+{
+    TempDirectory dir("reader_tests.prefetch");
+    StoryFileIndex index;
+    for(uint64_t i = 0; i < 4; ++i) {
+        index.add(HDF5ArchiveReadingAgent::getStoryFileInfo(writeStoryFile(dir, "c", "s", i * kFileSpan)));
+    }
+    auto files = index.snapshot()->findFiles("c", "s", 0, kUnknownEndTime);
+    size_t spawned = 0;
+    StoryEventStream::Spawn spawn = [&spawned](std::function<void()> work) -> std::function<void()> {
+        ++spawned;
+        auto task = std::make_shared<std::thread>(std::move(work));
+        return [task]() { task->join(); };
+    };
+
+    // reading ahead changes nothing in what is returned, and the merge finds the blocks decoded
+    StoryFileCache cache(size_t(64) << 20, 8);
+    {
+        StoryEventStream stream(cache, files, 0, kUnknownEndTime, StoryEventCursor(), spawn);
+        ReadResult result = drain(stream);
+        CHECK_EQ(result.count, 4 * kEventsPerFile);
+        CHECK(result.ordered);
+        CHECK_EQ(stream.failedFiles(), size_t(0));
+    }
+    CHECK(spawned >= 4 * 3 - 1);
+    StoryFileCache::Stats stats = cache.stats();
+    CHECK(stats.block_hits > 0);
+    CHECK_EQ(stats.cached_blocks, size_t(4 * 3));
+
+    // a stream left early waits for its reads in flight
+    StoryFileCache early(size_t(64) << 20, 8);
+    {
+        StoryEventStream stream(early, files, kFileSpan / 2, kUnknownEndTime, StoryEventCursor(), spawn);
+        CHECK_EQ(drain(stream, 10).count, size_t(10));
+    }
+
+    // with a cache that keeps no blocks there would be nothing to gain
+    spawned = 0;
+    StoryFileCache uncached(0, 8);
+    StoryEventStream stream(uncached, files, 0, kUnknownEndTime, StoryEventCursor(), spawn);
+    CHECK_EQ(drain(stream).count, 4 * kEventsPerFile);
+    CHECK_EQ(spawned, size_t(0));
+}
+
+void testStreamUnsortedFiles()
+{
+    TempDirectory dir("reader_tests.unsorted");
+    // the first rows of each block of the shuffled file look sorted, so only decoding a block tells
+    for(RowOrder order: {RowOrder::Reversed, RowOrder::ShuffledBlocks}) {
+        std::string story = order == RowOrder::Reversed ? "reversed" : "shuffled";
+        std::string file = writeStoryFile(dir, "u", story, 0, order);
+        std::vector<StoryFileEntry> files = {{0, kFileSpan - 1, file}};
+        uint64_t start_time = 2500 * kEventSpacing;
+        uint64_t end_time = 7500 * kEventSpacing;
+        StoryFileCache cache(size_t(1) << 20, 2);
+        for(int pass = 0; pass < 2; ++pass) {
+            StoryEventStream stream(cache, files, start_time, end_time);
+            ReadResult result = drain(stream);
+            CHECK_EQ(result.count, size_t(5001));
+            CHECK(result.ordered);
+            CHECK_EQ(result.first_time, start_time);
+            CHECK_EQ(result.last_time, end_time);
+        }
+    }
+}
+
+void testCacheInvalidate()
+{
+    TempDirectory dir("reader_tests.invalidate");
+    TempDirectory staging("reader_tests.invalidate.staging");
+    std::string file = writeStoryFile(dir, "c", "s", 0);
+    std::string other = writeStoryFile(dir, "c", "s", kFileSpan);
+    StoryFileCache cache(size_t(16) << 20, 4);
+    CHECK_EQ(cache.block(file, 0)->front().eventTime, uint64_t(0));
+    CHECK(cache.block(other, 0) != nullptr);
+    CHECK_EQ(cache.stats().cached_blocks, size_t(2));
+
+    // only the invalidated file's handle and blocks go, and its next read sees the new contents
+    replaceStoryFile(staging, file, 5 * kFileSpan);
+    cache.invalidate(file);
+    StoryFileCache::Stats stats = cache.stats();
+    CHECK_EQ(stats.open_files, size_t(1));
+    CHECK_EQ(stats.cached_blocks, size_t(1));
+    CHECK_EQ(cache.block(file, 0)->front().eventTime, 5 * kFileSpan);
+    CHECK_EQ(cache.stats().block_hits, uint64_t(0));
+    cache.block(other, 0);
+    CHECK_EQ(cache.stats().block_hits, uint64_t(1));
+
+    cache.invalidate(std::vector<std::string>{file, other});
+    CHECK_EQ(cache.stats().open_files, size_t(0));
+    CHECK_EQ(cache.stats().cached_blocks, size_t(0));
+    CHECK_EQ(cache.stats().cached_bytes, size_t(0));
+}
+
+void testCacheGeneration()
+{
+    // readers race a file being replaced and invalidated; a handle or block read from the old file
+    // while an invalidation happened must not be cached, so once the last one is done every read
+    // sees the last version. Readers also open the same file at once, which HDF5 only survives
+    // if the cache shares one open between them.
+    TempDirectory dir("reader_tests.generation");
+    TempDirectory staging("reader_tests.generation.staging");
+    std::string file = writeStoryFile(dir, "c", "s", 0);
+    StoryFileCache cache(size_t(16) << 20, 4);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 4; ++i) {
+        readers.emplace_back([&cache, &done, &file, i] {
+            while(!done) {
+                cache.block(file, i % 2);
+            }
+        });
+    }
+    constexpr uint64_t kVersions = 20;
+    for(uint64_t version = 1; version <= kVersions; ++version) {
+        replaceStoryFile(staging, file, version * kFileSpan);
+        cache.invalidate(file);
+    }
+    done = true;
+    for(auto &reader: readers) {
+        reader.join();
+    }
+    CHECK_EQ(cache.block(file, 0)->front().eventTime, kVersions * kFileSpan);
+    CHECK_EQ(cache.block(file, 1)->front().eventTime,
+             kVersions * kFileSpan + StoryFileCache::kRowsPerBlock * kEventSpacing);
+    uint64_t first_block = 0;
+    uint64_t end_block = 0;
+    bool sorted = false;
+    CHECK(cache.blockRange(file, kVersions * kFileSpan, kVersions * kFileSpan, first_block, end_block, sorted));
+    CHECK_EQ(end_block, uint64_t(1));
+}
+
+void testCacheLimits()
+{
+    TempDirectory dir("reader_tests.limits");
+    std::vector<std::string> files;
+    for(uint64_t i = 0; i < 3; ++i) {
+        files.push_back(writeStoryFile(dir, "c", "s", i * kFileSpan));
+    }
+    size_t block_bytes = 0;
+    {
+        StoryFileCache cache;
+        cache.block(files[0], 0);
+        block_bytes = cache.stats().cached_bytes;
+    }
+    CHECK(block_bytes > StoryFileCache::kRowsPerBlock * sizeof(LogEvent));
+
+    // room for two full blocks: a third evicts the least recently used
+    StoryFileCache cache(block_bytes * 2 + block_bytes / 2, 8);
+    cache.block(files[0], 0);
+    cache.block(files[0], 1);
+    cache.block(files[0], 0);
+    cache.block(files[1], 0);
+    StoryFileCache::Stats stats = cache.stats();
+    CHECK_EQ(stats.cached_blocks, size_t(2));
+    CHECK(stats.cached_bytes <= block_bytes * 2 + block_bytes / 2);
+    CHECK_EQ(stats.block_hits, uint64_t(1));
+    CHECK_EQ(stats.block_misses, uint64_t(3));
+    cache.block(files[0], 0);
+    CHECK_EQ(cache.stats().block_hits, uint64_t(2));
+    cache.block(files[0], 1);
+    CHECK_EQ(cache.stats().block_misses, uint64_t(4));
+
+    // a budget of 0 caches no blocks, but still returns them
+    StoryFileCache uncached(0, 8);
+    CHECK_EQ(uncached.block(files[0], 0)->size(), StoryFileCache::kRowsPerBlock);
+    CHECK_EQ(uncached.block(files[0], 0)->size(), StoryFileCache::kRowsPerBlock);
+    CHECK_EQ(uncached.stats().cached_blocks, size_t(0));
+    CHECK_EQ(uncached.stats().block_hits, uint64_t(0));
+
+    // at most two handles stay open, the least recently used closed first
+    StoryFileCache handles(size_t(16) << 20, 2);
+    CHECK(handles.inTimeOrder(files[0]));
+    CHECK(handles.inTimeOrder(files[1]));
+    CHECK(handles.inTimeOrder(files[0]));
+    CHECK(handles.inTimeOrder(files[2]));
+    CHECK_EQ(handles.stats().open_files, size_t(2));
+    CHECK_EQ(handles.stats().file_opens, uint64_t(3));
+    CHECK(handles.inTimeOrder(files[0]));
+    CHECK_EQ(handles.stats().file_opens, uint64_t(3));
+    CHECK(handles.inTimeOrder(files[1]));
+    CHECK_EQ(handles.stats().file_opens, uint64_t(4));
+    CHECK_EQ(handles.stats().open_files, size_t(2));
+}
+
+void testAgentReads()
+{
+    TempDirectory dir("reader_tests.agent");
+    for(uint64_t i = 0; i < 4; ++i) {
+        writeStoryFile(dir, "c", "s", i * kFileSpan);
+    }
+    writeStoryFile(dir, "c", "other", 0);
+    std::ofstream(dir.file("c.s.not_a_time.vlen.h5")).put('x');
+
+    HDF5ArchiveReadingAgent agent(dir.path.string(), 2);
+    agent.initialize();
+    CHECK_EQ(agent.indexedFileCount(), size_t(5));
+
+    uint64_t start_time = kFileSpan / 2;
+    uint64_t end_time = 3 * kFileSpan + kFileSpan / 4;
+    size_t expected = 0;
+    for(uint64_t i = 0; i < 4; ++i) {
+        expected += eventsInRange(i * kFileSpan, start_time, end_time);
+    }
+
+    // the parallel chunk read and the stream agree
+    std::list<StoryChunk*> chunks;
+    agent.readArchivedStory("c", "s", start_time, end_time, chunks);
+    size_t chunk_events = 0;
+    uint64_t previous_end = 0;
+    for(StoryChunk* chunk: chunks) {
+        chunk_events += chunk->getEventCount();
+        if(chunk->getEventCount() != 0) {
+            CHECK(chunk->begin()->second.eventTime >= previous_end);
+            previous_end = std::prev(chunk->end())->second.eventTime;
+        }
+        delete chunk;
+    }
+    CHECK_EQ(chunk_events, expected);
+
+    auto stream = agent.openStoryStream("c", "s", start_time, end_time);
+    ReadResult result = drain(*stream);
+    CHECK_EQ(result.count, expected);
+    CHECK(result.ordered);
+
+    StoryEventCursor cursor;
+    size_t delivered = agent.streamArchivedStory("c", "s", start_time, end_time,
+                                                 [](LogEvent const &) { return true; }, 100, cursor);
+    CHECK_EQ(delivered, size_t(100));
+    CHECK_EQ(cursor.event_time, start_time + 99 * kEventSpacing);
+    agent.shutdown();
+}
+
+std::vector<std::string> indexedFiles(HDF5ArchiveReadingAgent const &agent)
+{
+    std::vector<std::string> names;
+    for(auto const &entry: agent.findStoryFiles("c", "s", 0, kUnknownEndTime)) {
+        names.push_back(std::filesystem::path(entry.file_name).filename().string());
+    }
+    return names;
+}
+
+void testAgentFileChanges()
+{
+    TempDirectory dir("reader_tests.changes");
+    std::vector<std::string> files;
+    for(uint64_t i = 0; i < 3; ++i) {
+        files.push_back(writeStoryFile(dir, "c", "s", i * kFileSpan));
+    }
+    // not initialized, so no monitor runs and the index only changes through the calls below
+    HDF5ArchiveReadingAgent agent(dir.path.string(), 1);
+    HDF5ArchiveReadingAgentTest::rescanArchive(agent);
+    CHECK_EQ(agent.indexedFileCount(), size_t(3));
+    CHECK_EQ(agent.monitorStats().overflows, uint64_t(1));
+    auto read_all = [&agent]() {
+        auto stream = agent.openStoryStream("c", "s", 0, kUnknownEndTime);
+        return drain(*stream).count;
+    };
+    CHECK_EQ(read_all(), 3 * kEventsPerFile);
+    CHECK_EQ(agent.cacheStats().open_files, size_t(3));
+
+    // one batch renaming the second file, deleting the third and rewriting the first, which also saw a
+    // create and a modification before its close; other files in the directory are ignored
+    std::string renamed = dir.file("c.s." + std::to_string(kFileSpan + kFileSpan / 2) + ".vlen.h5");
+    std::filesystem::rename(files[1], renamed);
+    std::filesystem::remove(files[2]);
+    std::ofstream(dir.file("notes.txt")).put('x');
+    std::unordered_map<std::string, bool> changes = {
+            {files[0], true}, {files[1], false}, {renamed, true}, {files[2], false}, {dir.file("notes.txt"), true}};
+    HDF5ArchiveReadingAgentTest::applyFileChanges(agent, changes, 7);
+    CHECK(indexedFiles(agent) == (std::vector<std::string>{"c.s.0.vlen.h5", "c.s.1500000.vlen.h5"}));
+    CHECK_EQ(agent.findStoryFiles("c", "s", kFileSpan, kFileSpan).front().end_time, kFileSpan + kFileSpan / 2 - 1);
+    StoryFileCache::Stats cache = agent.cacheStats();
+    CHECK_EQ(cache.open_files, size_t(0));
+    CHECK_EQ(cache.cached_blocks, size_t(0));
+    CHECK_EQ(read_all(), 2 * kEventsPerFile);
+
+    // the net effect of a create and a close of the same file
+    HDF5ArchiveReadingAgentTest::applyFileChanges(agent, {{renamed, true}}, 2);
+    HDF5ArchiveReadingAgent::MonitorStats stats = agent.monitorStats();
+    CHECK_EQ(stats.events, uint64_t(9));
+    CHECK_EQ(stats.batches, uint64_t(2));
+    CHECK_EQ(stats.last_batch_size, uint64_t(2));
+    CHECK_EQ(stats.max_batch_size, uint64_t(7));
+    CHECK(stats.max_lag_ns >= stats.last_lag_ns);
+    CHECK_EQ(agent.indexedFileCount(), size_t(2));
+
+    // changes the monitor never heard of are found by the rescan after an overflow, and the cache dropped
+    std::filesystem::remove(renamed);
+    writeStoryFile(dir, "c", "s", 3 * kFileSpan);
+    CHECK_EQ(drain(*agent.openStoryStream("c", "s", 0, kEventSpacing)).count, size_t(2));
+    CHECK(agent.cacheStats().open_files != size_t(0));
+    HDF5ArchiveReadingAgentTest::rescanArchive(agent);
+    CHECK(indexedFiles(agent) == (std::vector<std::string>{"c.s.0.vlen.h5", "c.s.3000000.vlen.h5"}));
+    CHECK_EQ(agent.cacheStats().open_files, size_t(0));
+    CHECK_EQ(agent.monitorStats().overflows, uint64_t(2));
+    CHECK_EQ(agent.monitorStats().batches, uint64_t(2));
+    CHECK_EQ(read_all(), 2 * kEventsPerFile);
+}
+
+std::string readFile(FILE* file)
+{
+    std::string data;
+    std::rewind(file);
+    char buffer[4096];
+    size_t read;
+    while((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.append(buffer, read);
+    }
+    return data;
+}
+
+template <typename T>
+T at(std::string const &data, size_t offset)
+{
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+void testColumnarOutput()
+{
+    FILE* out = std::tmpfile();
+    CHECK(out != nullptr);
+    if(out == nullptr) {
+        return;
+    }
+    EventWriter::Format format;
+    CHECK(EventWriter::parseFormat("columnar", format));
+    CHECK(!EventWriter::parseFormat("csv", format));
+    StoryEventCursor next;
+    next.valid = true;
+    next.event_time = 20;
+    next.client_id = 1;
+    next.event_index = 2;
+    {
+        auto writer = EventWriter::create(format, out);
+        writer->write(LogEvent(5, 10, 1, 1, "abc"));
+        writer->write(LogEvent(5, 20, 1, 2, std::string("d\0e", 3)));
+        writer->finish(2, &next);
+    }
+    std::string data = readFile(out);
+    std::fclose(out);
+
+    CHECK_EQ(data.compare(0, 8, "CHRCOL01"), 0);
+    CHECK_EQ(at<uint32_t>(data, 8), uint32_t(1));
+    CHECK_EQ(data.size() % 8, size_t(0));
+    size_t offset = 16;
+    CHECK_EQ(at<uint64_t>(data, offset), uint64_t(2));
+    offset += 8;
+    CHECK_EQ(at<uint64_t>(data, offset), uint64_t(5));              // storyId
+    CHECK_EQ(at<uint64_t>(data, offset + 16 + 8), uint64_t(20));    // eventTime[1]
+    CHECK_EQ(at<uint64_t>(data, offset + 32), uint64_t(3));         // recordEnd[0]
+    CHECK_EQ(at<uint64_t>(data, offset + 40), uint64_t(6));         // recordEnd[1]
+    CHECK_EQ(at<uint32_t>(data, offset + 48 + 4), uint32_t(1));     // clientId[1]
+    CHECK_EQ(at<uint32_t>(data, offset + 56 + 4), uint32_t(2));     // eventIndex[1]
+    offset += 64;
+    CHECK_EQ(data.substr(offset, 6), std::string("abcd\0e", 6));
+    offset += 8;
+    CHECK_EQ(at<uint64_t>(data, offset), uint64_t(0));
+    CHECK_EQ(at<uint64_t>(data, offset + 8), uint64_t(next.toString().size()));
+    CHECK_EQ(data.substr(offset + 16, next.toString().size()), next.toString());
+}
+
+void testColumnarBatches()
+{
+    FILE* out = std::tmpfile();
+    CHECK(out != nullptr);
+    if(out == nullptr) {
+        return;
+    }
+    // one full batch of 65536 rows, then the 3 left over when the read ends
+    size_t const kRows = 65536;
+    {
+        auto writer = EventWriter::create(EventWriter::Format::Columnar, out);
+        for(size_t i = 0; i < kRows + 3; ++i) {
+            writer->write(LogEvent(5, i, 1, uint32_t(i), "x"));
+        }
+        writer->finish(kRows + 3, nullptr);
+    }
+    std::string data = readFile(out);
+    std::fclose(out);
+
+    size_t offset = 16;
+    CHECK_EQ(at<uint64_t>(data, offset), uint64_t(kRows));
+    CHECK_EQ(at<uint64_t>(data, offset + 8 + 8 * (kRows - 1)), uint64_t(5));                // storyId[last]
+    CHECK_EQ(at<uint64_t>(data, offset + 8 + 8 * (2 * kRows - 1)), uint64_t(kRows - 1));    // eventTime[last]
+    offset += 8 + kRows * (3 * 8 + 2 * 4) + kRows;
+    CHECK_EQ(at<uint64_t>(data, offset), uint64_t(3));
+    CHECK_EQ(at<uint64_t>(data, offset + 8 + 3 * 8), uint64_t(kRows));                      // eventTime[0]
+    CHECK_EQ(at<uint64_t>(data, offset + 8 + 6 * 8 + 2 * 8), uint64_t(3));                  // recordEnd[2]
+    offset += 8 + 3 * (3 * 8 + 2 * 4) + 8;
+    CHECK_EQ(at<uint64_t>(data, offset), uint64_t(0));
+    CHECK_EQ(at<uint64_t>(data, offset + 8), uint64_t(0));
+    CHECK_EQ(data.size(), offset + 16);
+}
+
+void testTextOutput()
+{
+    FILE* out = std::tmpfile();
+    CHECK(out != nullptr);
+    if(out == nullptr) {
+        return;
+    }
+    StoryEventCursor next;
+    next.valid = true;
+    next.event_time = 20;
+    next.client_id = 1;
+    next.event_index = 2;
+    {
+        auto writer = EventWriter::create(EventWriter::Format::Text, out);
+        writer->write(LogEvent(5, 10, 1, 1, "abc"));
+        writer->finish(1, &next);
+    }
+    std::string data = readFile(out);
+    std::fclose(out);
+    CHECK_EQ(data, "  storyId=5, time=10, clientId=1, index=1, record=\"abc\"\n1 event(s) returned.\nnext_cursor=" +
+                           next.toString() + "\n");
+}
+
+void testNdjsonOutput()
+{
+    FILE* out = std::tmpfile();
+    CHECK(out != nullptr);
+    if(out == nullptr) {
+        return;
+    }
+    {
+        auto writer = EventWriter::create(EventWriter::Format::Ndjson, out);
+        writer->write(LogEvent(5, 10, 1, 1, "say \"hi\"\n\x01"));
+        writer->finish(1, nullptr);
+    }
+    std::string data = readFile(out);
+    std::fclose(out);
+    CHECK_EQ(data, std::string("{\"story_id\":5,\"time\":10,\"client_id\":1,\"index\":1,"
+                               "\"record\":\"say \\\"hi\\\"\\n\\u0001\"}\n{\"count\":1,\"next_cursor\":null}\n"));
+}
+
+} // namespace
+
+int main()
+{
+    // a missing file is one of the cases tested; HDF5's own report of it is noise here
+    H5::Exception::dontPrint();
+    std::vector<std::pair<char const*, std::function<void()>>> tests = {
+            {"index lookup", testIndexLookup},
+            {"index updates", testIndexUpdates},
+            {"index overlaps", testIndexOverlaps},
+            {"catalog", testCatalog},
+            {"catalog incremental", testCatalogIncremental},
+            {"cursor text", testCursorText},
+            {"stream range", testStreamRange},
+            {"stream prefetch", testStreamPrefetch},
+            {"stream unsorted files", testStreamUnsortedFiles},
+            {"cache invalidate", testCacheInvalidate},
+            {"cache generation", testCacheGeneration},
+            {"cache limits", testCacheLimits},
+            {"agent reads", testAgentReads},
+            {"agent file changes", testAgentFileChanges},
+            {"columnar output", testColumnarOutput},
+            {"columnar batches", testColumnarBatches},
+            {"text output", testTextOutput},
+            {"ndjson output", testNdjsonOutput},
+    };
+    for(auto const &[name, test]: tests) {
+        int before = failures;
+        test();
+        std::cout << (failures == before ? "PASS " : "FAIL ") << name << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#ifndef CHRONOLOG_TESTS_STORYCHUNK_H
+#define CHRONOLOG_TESTS_STORYCHUNK_H
+
+// Stand-in for chrono_common's StoryChunk with the members the reader uses:
+// events keyed by (eventTime, clientId, eventIndex) in a map.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+
+namespace chronolog
+{
+
+typedef uint64_t StoryId;
+typedef std::string ChronicleName;
+typedef std::string StoryName;
+
+struct LogEvent
+{
+    uint64_t storyId = 0;
+    uint64_t eventTime = 0;
+    uint32_t clientId = 0;
+    uint32_t eventIndex = 0;
+    std::string logRecord;
+
+    LogEvent() = default;
+
+    LogEvent(uint64_t story_id, uint64_t event_time, uint32_t client_id, uint32_t event_index,
+             std::string const &record)
+        : storyId(story_id)
+        , eventTime(event_time)
+        , clientId(client_id)
+        , eventIndex(event_index)
+        , logRecord(record)
+    {}
+};
+
+typedef std::tuple<uint64_t, uint32_t, uint32_t> EventSequence;
+
+class StoryChunk
+{
+public:
+    StoryChunk(ChronicleName const &, StoryName const &, StoryId const &, uint64_t start_time, uint64_t end_time)
+        : startTime(start_time)
+        , endTime(end_time)
+    {}
+
+    int insertEvent(LogEvent const &event)
+    {
+        logEvents.emplace(EventSequence(event.eventTime, event.clientId, event.eventIndex), event);
+        return 1;
+    }
+
+    size_t getEventCount() const { return logEvents.size(); }
+
+    uint64_t getStartTime() const { return startTime; }
+
+    uint64_t getEndTime() const { return endTime; }
+
+    std::map<EventSequence, LogEvent>::iterator begin() { return logEvents.begin(); }
+
+    std::map<EventSequence, LogEvent>::iterator end() { return logEvents.end(); }
+
+private:
+    uint64_t startTime;
+    uint64_t endTime;
+    std::map<EventSequence, LogEvent> logEvents;
+};
+
+} // chronolog
+
+#endif //CHRONOLOG_TESTS_STORYCHUNK_H
@@ -0,0 +1,7 @@
+#ifndef CHRONOLOG_TESTS_STORYCHUNKINGESTIONQUEUE_H
+#define CHRONOLOG_TESTS_STORYCHUNKINGESTIONQUEUE_H
+
+// The agent only needs the logging macros this header brings in with ChronoPlayer's
+#include "chrono_monitor.h"
+
+#endif //CHRONOLOG_TESTS_STORYCHUNKINGESTIONQUEUE_H
@@ -0,0 +1,23 @@
+#ifndef CHRONOLOG_TESTS_CHRONO_MONITOR_H
+#define CHRONOLOG_TESTS_CHRONO_MONITOR_H
+
+// Logging of the reader compiled out, errors aside; the tests check results, not log lines. The arguments are
+// still evaluated, so what is only computed for a log line doesn't count as unused.
+
+#include <cstdio>
+
+namespace chronolog_tests
+{
+
+template <typename... Args>
+inline void discardLog(Args const &...)
+{}
+
+} // chronolog_tests
+
+#define LOG_ERROR(...) (std::fprintf(stderr, "[error] %s\n", #__VA_ARGS__), chronolog_tests::discardLog(__VA_ARGS__))
+#define LOG_WARNING(...) chronolog_tests::discardLog(__VA_ARGS__)
+#define LOG_INFO(...) chronolog_tests::discardLog(__VA_ARGS__)
+#define LOG_DEBUG(...) chronolog_tests::discardLog(__VA_ARGS__)
+
+#endif //CHRONOLOG_TESTS_CHRONO_MONITOR_H
@@ -0,0 +1,71 @@
+#ifndef CHRONOLOG_TESTS_THALLIUM_HPP
+#define CHRONOLOG_TESTS_THALLIUM_HPP
+
+// The few thallium types the reading agent uses, backed by std::thread, so
+// the tests build without Argobots: every task and xstream gets a thread.
+
+#include <memory>
+#include <thread>
+
+namespace thallium
+{
+
+template <typename T>
+using managed = std::shared_ptr<T>;
+
+struct thread
+{
+    std::thread handle;
+
+    void join()
+    {
+        if(handle.joinable()) {
+            handle.join();
+        }
+    }
+};
+
+struct spawner
+{
+    template <typename F>
+    managed<thread> make_thread(F f)
+    {
+        auto task = std::make_shared<thread>();
+        task->handle = std::thread(std::move(f));
+        return task;
+    }
+};
+
+struct pool: spawner
+{
+    enum class access
+    {
+        mpmc
+    };
+
+    static managed<pool> create(access) { return std::make_shared<pool>(); }
+};
+
+struct scheduler
+{
+    enum class predef
+    {
+        basic_wait
+    };
+};
+
+struct xstream: spawner
+{
+    static managed<xstream> create() { return std::make_shared<xstream>(); }
+
+    static managed<xstream> create(scheduler::predef, pool &) { return std::make_shared<xstream>(); }
+
+    void join() {}
+};
+
+struct abt
+{};
+
+} // thallium
+
+#endif //CHRONOLOG_TESTS_THALLIUM_HPP
@@ -33,12 +33,16 @@ async def retrieve_interaction(
     chronicle_name: str = None,
     story_name: str = None,
     start_time: str = None,
-    end_time: str = None
+    end_time: str = None,
+    limit: int = None,
+    cursor: str = None
 ):
     """
-    Retrieve all records from a chronicle and story within the specified time range.
+    Retrieve records from a chronicle and story within the specified time range.
+    With a limit, only the first `limit` records are returned, followed by a next_cursor
+    line when more remain; pass it back as `cursor` to get the next page.
     """
-    return await _retrieve(chronicle_name, story_name, start_time, end_time)
+    return await _retrieve(chronicle_name, story_name, start_time, end_time, limit, cursor)
 
 def main():
     mcp.run()
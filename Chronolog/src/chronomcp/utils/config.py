@@ -26,6 +26,8 @@ CONFIG_FILE = os.getenv(
     "CHRONO_CONF",
     "/home/ssonar/chronolog/Debug/conf/grapher_conf_1.json"
 )
+# Keep one reader running in --serve mode instead of starting it per query
+READER_DAEMON = os.getenv("CHRONO_READER_DAEMON", "1") != "0"
 
 # Initialize ChronoLog client
 client_conf = py_chronolog_client.ClientPortalServiceConf(
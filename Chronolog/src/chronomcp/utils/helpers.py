@@ -1,5 +1,5 @@
 # helpers.py
-import subprocess, re
+import subprocess, re, json, threading, struct
 from datetime import datetime, date, time, timedelta
 
 def to_nanosecond(dt: datetime) -> str:
@@ -27,11 +27,130 @@ def parse_time_arg(arg: str, is_end: bool) -> str:
 
     return to_nanosecond(dt)
 
-def run_reader(cmd_args):
+def run_reader(cmd_args, text=True):
     proc = subprocess.run(
         cmd_args,
         stdout=subprocess.PIPE,
         stderr=subprocess.PIPE,
-        text=True
+        text=text
     )
     return proc.stdout, proc.stderr
+
+
+def read_columnar(data):
+    """
+    Decodes the output of hdf5_file_reader -f columnar (layout in
+    reader_script/EventWriter.h) into (batches, next_cursor). Each batch maps
+    "story_id", "time", "client_id" and "index" to memoryviews cast straight
+    over data, and "records" to the list of record byte slices, so nothing is
+    parsed per event.
+    """
+    view = memoryview(data)
+    if len(view) < 16 or view[:8] != b"CHRCOL01":
+        raise ValueError("not a columnar reader stream")
+    version, = struct.unpack_from("=I", view, 8)
+    if version != 1:
+        raise ValueError(f"unsupported columnar version {version}")
+    offset = 16
+    batches = []
+    while True:
+        n, = struct.unpack_from("=Q", view, offset)
+        offset += 8
+        if n == 0:
+            length, = struct.unpack_from("=Q", view, offset)
+            cursor = bytes(view[offset + 8:offset + 8 + length]).decode()
+            return batches, cursor or None
+
+        def column(size, fmt):
+            nonlocal offset
+            values = view[offset:offset + n * size].cast(fmt)
+            offset += n * size
+            return values
+
+        batch = {"story_id": column(8, "Q"), "time": column(8, "Q")}
+        record_ends = column(8, "Q")
+        batch["client_id"] = column(4, "I")
+        batch["index"] = column(4, "I")
+        offset += -offset % 8
+        records = view[offset:offset + (record_ends[-1] if n else 0)]
+        starts = [0] + record_ends[:-1].tolist()
+        batch["records"] = [records[start:end] for start, end in zip(starts, record_ends)]
+        offset += len(records) + (-len(records) % 8)
+        batches.append(batch)
+
+
+class ReaderDaemon:
+    """
+    hdf5_file_reader started once with --serve and queried over JSON-RPC on its
+    stdin/stdout, so a query does not pay for a process start and a fresh
+    archive index.
+    """
+
+    def __init__(self, binary, config_file):
+        self.cmd = [binary, "-c", config_file, "--serve"]
+        self.proc = None
+        self.next_id = 0
+        self.lock = threading.Lock()
+
+    def _request(self, method, params):
+        self.next_id += 1
+        message = {"jsonrpc": "2.0", "id": self.next_id, "method": method, "params": params}
+        self.proc.stdin.write(json.dumps(message) + "\n")
+        self.proc.stdin.flush()
+        line = self.proc.stdout.readline()
+        if not line:
+            raise RuntimeError("reader daemon exited")
+        response = json.loads(line)
+        if "error" in response:
+            raise RuntimeError(response["error"].get("message", "reader daemon error"))
+        return response["result"]
+
+    def _ensure_started(self):
+        if self.proc is not None and self.proc.poll() is None:
+            return
+        self.proc = subprocess.Popen(
+            self.cmd,
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            text=True,
+            bufsize=1
+        )
+        self._request("initialize", {"protocolVersion": "2024-11-05", "capabilities": {},
+                                     "clientInfo": {"name": "chronomcp", "version": "1.0"}})
+
+    def call(self, tool, arguments):
+        """Structured result of one tool call; restarts the daemon once if it died."""
+        with self.lock:
+            for attempt in range(2):
+                try:
+                    self._ensure_started()
+                    result = self._request("tools/call", {"name": tool, "arguments": arguments})
+                    break
+                except (OSError, RuntimeError, ValueError):
+                    self.close()
+                    if attempt == 1:
+                        raise
+        # the server reports a failed call as {"error": ...} in the structured result
+        structured = result.get("structuredContent", {})
+        if result.get("isError") or "error" in structured:
+            raise ValueError(structured.get("error", "reader error"))
+        return structured
+
+    def close(self):
+        if self.proc is not None:
+            try:
+                self.proc.stdin.close()
+                self.proc.wait(timeout=5)
+            except Exception:
+                self.proc.kill()
+            self.proc = None
+
+
+_daemon = None
+
+def reader_daemon(binary, config_file):
+    global _daemon
+    if _daemon is None:
+        _daemon = ReaderDaemon(binary, config_file)
+    return _daemon
@@ -0,0 +1,69 @@
+"""Tests for the reader output decoding in chronomcp.utils.helpers."""
+import os
+import struct
+import sys
+
+import pytest
+
+# Add the src directory to the path for imports
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', 'src'))
+
+from chronomcp.utils.helpers import read_columnar
+
+
+def pad(data):
+    return data + b"\0" * (-len(data) % 8)
+
+
+def columnar_stream(batches, cursor=""):
+    """Builds a stream in the layout of reader_script/EventWriter.h from lists of event tuples."""
+    data = b"CHRCOL01" + struct.pack("=II", 1, 0)
+    for events in batches:
+        records = b"".join(event[4] for event in events)
+        ends, end = [], 0
+        for event in events:
+            end += len(event[4])
+            ends.append(end)
+        n = len(events)
+        data += struct.pack("=Q", n)
+        data += struct.pack(f"={n}Q", *(event[0] for event in events))
+        data += struct.pack(f"={n}Q", *(event[1] for event in events))
+        data += struct.pack(f"={n}Q", *ends)
+        data += struct.pack(f"={n}I", *(event[2] for event in events))
+        data += struct.pack(f"={n}I", *(event[3] for event in events))
+        data = pad(data) + pad(records)
+    data += struct.pack("=QQ", 0, len(cursor)) + cursor.encode()
+    return pad(data)
+
+
+def test_read_columnar_batches_and_cursor():
+    """Test decoding two batches and the next cursor."""
+    first = [(5, 10, 1, 0, b"abc"), (5, 20, 2, 1, b"")]
+    second = [(5, 30, 1, 2, b"record\0with nul")]
+    batches, cursor = read_columnar(columnar_stream([first, second], "30:1:2"))
+
+    assert cursor == "30:1:2"
+    assert len(batches) == 2
+    assert batches[0]["story_id"].tolist() == [5, 5]
+    assert batches[0]["time"].tolist() == [10, 20]
+    assert batches[0]["client_id"].tolist() == [1, 2]
+    assert batches[0]["index"].tolist() == [0, 1]
+    assert [bytes(record) for record in batches[0]["records"]] == [b"abc", b""]
+    assert [bytes(record) for record in batches[1]["records"]] == [b"record\0with nul"]
+
+
+def test_read_columnar_empty_read():
+    """Test a read that returned nothing and has no cursor."""
+    batches, cursor = read_columnar(columnar_stream([]))
+    assert batches == []
+    assert cursor is None
+
+
+def test_read_columnar_rejects_other_streams():
+    """Test that text output and other versions are refused."""
+    with pytest.raises(ValueError):
+        read_columnar(b"0 event(s) returned.\n")
+    data = bytearray(columnar_stream([]))
+    data[8:12] = struct.pack("=I", 2)
+    with pytest.raises(ValueError):
+        read_columnar(bytes(data))
@@ -0,0 +1,80 @@
+#include "json.hpp"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+
+// Builds a calculate_statistics style tools/call request carrying `count` doubles
+static std::string make_numeric_request(size_t count) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1000.0, 1000.0);
+    
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\","
+                          "\"params\":{\"name\":\"calculate_statistics\",\"arguments\":{\"data\":[";
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) payload += ",";
+        payload += std::to_string(dist(rng));
+    }
+    payload += "]}}}";
+    return payload;
+}
+
+// Builds a multiply_matrices style payload with two n x n matrices
+static std::string make_matrix_request(size_t n) {
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int> dist(-100, 100);
+    
+    std::string payload = "{\"matrix_a\":[";
+    for (int m = 0; m < 2; m++) {
+        if (m == 1) payload += "],\"matrix_b\":[";
+        for (size_t i = 0; i < n; i++) {
+            if (i > 0) payload += ",";
+            payload += "[";
+            for (size_t j = 0; j < n; j++) {
+                if (j > 0) payload += ",";
+                payload += std::to_string(dist(rng));
+            }
+            payload += "]";
+        }
+    }
+    payload += "]}";
+    return payload;
+}
+
+static void BM_ParseNumericArray(benchmark::State& state) {
+    std::string payload = make_numeric_request(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        json::Value value = json::parse(payload);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * payload.size());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ParseNumericArray)->RangeMultiplier(10)->Range(10, 1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_ParseIntegerMatrix(benchmark::State& state) {
+    std::string payload = make_matrix_request(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        json::Value value = json::parse(payload);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * payload.size());
+}
+BENCHMARK(BM_ParseIntegerMatrix)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMillisecond);
+
+static void BM_StringifyNumericArray(benchmark::State& state) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(-1000.0, 1000.0);
+    json::NumberArray data(static_cast<size_t>(state.range(0)));
+    for (auto& v : data) v = dist(rng);
+    json::Value value(std::move(data));
+    
+    std::string buffer;
+    for (auto _ : state) {
+        buffer.clear();
+        json::stringify(value, buffer);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * buffer.size());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_StringifyNumericArray)->RangeMultiplier(10)->Range(10, 1000000)->Unit(benchmark::kMillisecond);
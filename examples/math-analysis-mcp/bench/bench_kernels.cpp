@@ -0,0 +1,204 @@
+#include "math_operations.hpp"
+#include "calculus.hpp"
+#include "small_matrix.hpp"
+#include <benchmark/benchmark.h>
+#include <random>
+
+using namespace math_ops;
+
+// calculate_statistics sizes run up to 1e7 by default; the 1e8 point needs
+// about 1.6 GB (data plus the median's working copy) and is only built with
+// -DMATH_BENCH_LARGE=ON
+#ifdef MATH_BENCH_LARGE
+static constexpr int64_t kMaxStatisticsSize = 100000000;
+#else
+static constexpr int64_t kMaxStatisticsSize = 10000000;
+#endif
+
+// The signal kernels read one or two arrays and write at most one, so their
+// bytes/second is comparable with memory bandwidth. Same size limit.
+static constexpr int64_t kMaxSignalSize = kMaxStatisticsSize;
+
+static Vector random_vector(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(-1000.0, 1000.0);
+    Vector v(n);
+    for (auto& x : v) x = dist(rng);
+    return v;
+}
+
+static Matrix random_matrix(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix m(n, n);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            m(i, j) = dist(rng);
+        }
+    }
+    return m;
+}
+
+// Every statistic, including the median/mode sort
+static void BM_CalculateStatistics(benchmark::State& state) {
+    Vector data = random_vector(static_cast<size_t>(state.range(0)), 42);
+    for (auto _ : state) {
+        Statistics stats = calculate_statistics(data);
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * sizeof(double));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_CalculateStatistics)->RangeMultiplier(10)->Range(1000, kMaxStatisticsSize)->Unit(benchmark::kMillisecond);
+
+// Only the streaming moments, which skip the sort
+static void BM_CalculateMoments(benchmark::State& state) {
+    Vector data = random_vector(static_cast<size_t>(state.range(0)), 42);
+    const unsigned fields = kStatMean | kStatStdDev | kStatMin | kStatMax | kStatCount;
+    for (auto _ : state) {
+        Statistics stats = calculate_statistics(data, fields);
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * sizeof(double));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_CalculateMoments)->RangeMultiplier(10)->Range(1000, kMaxStatisticsSize)->Unit(benchmark::kMillisecond);
+
+static void BM_MultiplyMatrices(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    Matrix a = random_matrix(n, 1);
+    Matrix b = random_matrix(n, 2);
+    for (auto _ : state) {
+        Matrix c = multiply_matrices(a, b);
+        benchmark::DoNotOptimize(c.data());
+    }
+    state.counters["FLOPS"] = benchmark::Counter(2.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_MultiplyMatrices)->RangeMultiplier(4)->Range(4, 1024)->Unit(benchmark::kMicrosecond);
+
+static void BM_Determinant(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    Matrix m = random_matrix(n, 3);
+    for (auto _ : state) {
+        double det = determinant(m);
+        benchmark::DoNotOptimize(det);
+    }
+    // LU factorization dominates: 2/3 n^3 flops
+    state.counters["FLOPS"] = benchmark::Counter(2.0 / 3.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_Determinant)->RangeMultiplier(4)->Range(4, 1024)->Unit(benchmark::kMicrosecond);
+
+// The fixed-size kernels behind runtime dispatch, as the tools call them
+static void BM_SmallMultiply(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    Matrix a = random_matrix(n, 1);
+    Matrix b = random_matrix(n, 2);
+    double out[kSmallMatrixMax * kSmallMatrixMax];
+    for (auto _ : state) {
+        small_multiply(a, b, out);
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_SmallMultiply)->DenseRange(2, 8);
+
+static void BM_SmallDeterminant(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    Matrix m = random_matrix(n, 3);
+    for (auto _ : state) {
+        double det = 0.0;
+        small_determinant(m, det);
+        benchmark::DoNotOptimize(det);
+    }
+}
+BENCHMARK(BM_SmallDeterminant)->DenseRange(2, 8);
+
+// Arguments: matrix size, batch count; data already in SoA layout
+static void BM_BatchMultiplySoa(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    const size_t count = static_cast<size_t>(state.range(1));
+    Vector a = random_vector(n * n * count, 1);
+    Vector b = random_vector(n * n * count, 2);
+    Vector out(n * n * count);
+    for (auto _ : state) {
+        batch_multiply_soa(n, count, a.data(), b.data(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * count);
+}
+BENCHMARK(BM_BatchMultiplySoa)->ArgsProduct({{3, 4, 8}, {4096}})->Unit(benchmark::kMicrosecond);
+
+static void BM_BatchDeterminantSoa(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    const size_t count = static_cast<size_t>(state.range(1));
+    Vector m = random_vector(n * n * count, 3);
+    Vector out(count);
+    for (auto _ : state) {
+        batch_determinant_soa(n, count, m.data(), out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * count);
+}
+BENCHMARK(BM_BatchDeterminantSoa)->ArgsProduct({{3, 4, 8}, {4096}})->Unit(benchmark::kMicrosecond);
+
+// Argument 1: 0 trapezoid, 1 Simpson
+static void BM_Integrate(benchmark::State& state) {
+    Vector y = random_vector(static_cast<size_t>(state.range(0)), 6);
+    const IntegrationRule rule = state.range(1) == 0 ? IntegrationRule::Trapezoid : IntegrationRule::Simpson;
+    for (auto _ : state) {
+        double integral = integrate(y, 0.01, rule);
+        benchmark::DoNotOptimize(integral);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * sizeof(double));
+}
+BENCHMARK(BM_Integrate)
+    ->ArgsProduct({benchmark::CreateRange(1000, kMaxSignalSize, 10), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_CumulativeIntegral(benchmark::State& state) {
+    Vector y = random_vector(static_cast<size_t>(state.range(0)), 6);
+    for (auto _ : state) {
+        Vector running = cumulative_integral(y, 0.01, IntegrationRule::Simpson);
+        benchmark::DoNotOptimize(running.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * 2 * sizeof(double));
+}
+BENCHMARK(BM_CumulativeIntegral)->RangeMultiplier(10)->Range(1000, kMaxSignalSize)->Unit(benchmark::kMillisecond);
+
+// Argument 1: stencil order of accuracy
+static void BM_Differentiate(benchmark::State& state) {
+    Vector y = random_vector(static_cast<size_t>(state.range(0)), 7);
+    const int accuracy = static_cast<int>(state.range(1));
+    for (auto _ : state) {
+        Vector derivative = differentiate(y, 0.01, accuracy);
+        benchmark::DoNotOptimize(derivative.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * 2 * sizeof(double));
+}
+BENCHMARK(BM_Differentiate)
+    ->ArgsProduct({benchmark::CreateRange(1000, kMaxSignalSize, 10), {2, 4, 6}})
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: points, degree, method (0 normal equations, 1 QR)
+static void BM_PolynomialFit(benchmark::State& state) {
+    const size_t n = static_cast<size_t>(state.range(0));
+    const int degree = static_cast<int>(state.range(1));
+    const FitMethod method = state.range(2) == 0 ? FitMethod::NormalEquations : FitMethod::QR;
+    
+    Vector x(n), y(n);
+    std::mt19937_64 rng(5);
+    std::normal_distribution<double> noise(0.0, 0.1);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = static_cast<double>(i) / n * 10.0;
+        y[i] = 1.0 + 2.0 * x[i] - 0.5 * x[i] * x[i] + noise(rng);
+    }
+    
+    for (auto _ : state) {
+        std::vector<double> coefficients = polynomial_fit(x, y, degree, method);
+        benchmark::DoNotOptimize(coefficients.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * n);
+}
+BENCHMARK(BM_PolynomialFit)
+    ->ArgsProduct({{1000, 100000, 1000000}, {2, 8}, {0, 1}})
+    ->ArgNames({"points", "degree", "qr"})
+    ->Unit(benchmark::kMillisecond);
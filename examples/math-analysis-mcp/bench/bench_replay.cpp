@@ -0,0 +1,302 @@
+#include "json.hpp"
+#include <benchmark/benchmark.h>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// End-to-end replay: each benchmark spawns math_analysis_server with pipes
+// on its stdin and stdout, then times pipelined JSON-lines request sets
+// through it, so parsing, dispatch, the kernels, encoding and the pipe writes
+// are all in the measurement. The server binary is taken from
+// MATH_BENCH_SERVER in the environment, falling back to the one built next
+// to this benchmark. Setting MATH_BENCH_REPLAY to a .jsonl file of requests
+// adds a replay of that file too.
+
+#ifndef MATH_BENCH_SERVER_PATH
+#define MATH_BENCH_SERVER_PATH "./math_analysis_server"
+#endif
+
+// A spawned server process talking JSON lines over pipes
+class ServerProcess {
+public:
+    explicit ServerProcess(const std::vector<std::string>& args) {
+        int to_child[2], from_child[2];
+        if (pipe(to_child) != 0 || pipe(from_child) != 0) {
+            throw std::runtime_error("pipe failed");
+        }
+        
+        pid_ = fork();
+        if (pid_ < 0) {
+            throw std::runtime_error("fork failed");
+        }
+        if (pid_ == 0) {
+            dup2(to_child[0], STDIN_FILENO);
+            dup2(from_child[1], STDOUT_FILENO);
+            close(to_child[0]);
+            close(to_child[1]);
+            close(from_child[0]);
+            close(from_child[1]);
+            
+            std::vector<char*> argv;
+            for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+        
+        close(to_child[0]);
+        close(from_child[1]);
+        in_ = to_child[1];
+        out_ = from_child[0];
+    }
+    
+    ~ServerProcess() {
+        if (in_ >= 0) close(in_);
+        if (out_ >= 0) close(out_);
+        if (pid_ > 0) waitpid(pid_, nullptr, 0);
+    }
+    
+    ServerProcess(const ServerProcess&) = delete;
+    ServerProcess& operator=(const ServerProcess&) = delete;
+    
+    bool send(const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(in_, data.data() + written, data.size() - written);
+            if (n <= 0) return false;
+            written += static_cast<size_t>(n);
+        }
+        return true;
+    }
+    
+    // Reads until `lines` response lines have arrived; false if the server exits first
+    bool read_lines(size_t lines) {
+        char buffer[1 << 16];
+        while (lines > 0) {
+            ssize_t n = read(out_, buffer, sizeof(buffer));
+            if (n <= 0) return false;
+            for (ssize_t i = 0; i < n; i++) {
+                if (buffer[i] == '\n') lines--;
+            }
+        }
+        return true;
+    }
+
+private:
+    pid_t pid_ = -1;
+    int in_ = -1;
+    int out_ = -1;
+};
+
+// Requests for one iteration and the number of responses they produce
+struct Workload {
+    std::string payload;
+    size_t responses = 0;
+};
+
+static std::string server_path() {
+    const char* path = std::getenv("MATH_BENCH_SERVER");
+    return path ? path : MATH_BENCH_SERVER_PATH;
+}
+
+static void add_call(Workload& workload, int id, const char* tool, json::Value arguments) {
+    json::Value request;
+    request["jsonrpc"] = "2.0";
+    request["id"] = id;
+    request["method"] = "tools/call";
+    request["params"]["name"] = tool;
+    request["params"]["arguments"] = std::move(arguments);
+    json::stringify(request, workload.payload);
+    workload.payload += '\n';
+    workload.responses++;
+}
+
+static json::NumberArray random_numbers(std::mt19937_64& rng, size_t n) {
+    std::uniform_real_distribution<double> dist(-100.0, 100.0);
+    json::NumberArray values(n);
+    for (auto& v : values) v = dist(rng);
+    return values;
+}
+
+static json::Value random_matrix(std::mt19937_64& rng, size_t n) {
+    json::Array rows;
+    for (size_t i = 0; i < n; i++) rows.emplace_back(random_numbers(rng, n));
+    return json::Value(std::move(rows));
+}
+
+// Many tiny requests: dominated by per-message overhead
+static Workload small_workload() {
+    std::mt19937_64 rng(1);
+    Workload workload;
+    for (int i = 0; i < 1000; i++) {
+        json::Value arguments;
+        arguments["data"] = random_numbers(rng, 8);
+        add_call(workload, i, "calculate_statistics", std::move(arguments));
+    }
+    return workload;
+}
+
+// A rotation through the tools at moderate sizes
+static Workload mixed_workload() {
+    std::mt19937_64 rng(2);
+    Workload workload;
+    for (int i = 0; i < 500; i++) {
+        json::Value arguments;
+        switch (i % 5) {
+            case 0:
+                arguments["data"] = random_numbers(rng, 1000);
+                add_call(workload, i, "calculate_statistics", std::move(arguments));
+                break;
+            case 1:
+                arguments["matrix_a"] = random_matrix(rng, 16);
+                arguments["matrix_b"] = random_matrix(rng, 16);
+                add_call(workload, i, "multiply_matrices", std::move(arguments));
+                break;
+            case 2:
+                arguments["matrix"] = random_matrix(rng, 16);
+                add_call(workload, i, "determinant", std::move(arguments));
+                break;
+            case 3: {
+                json::NumberArray x(200);
+                for (size_t j = 0; j < x.size(); j++) x[j] = static_cast<double>(j);
+                arguments["x_values"] = std::move(x);
+                arguments["y_values"] = random_numbers(rng, 200);
+                arguments["degree"] = 3;
+                add_call(workload, i, "polynomial_fit", std::move(arguments));
+                break;
+            }
+            default:
+                arguments["y_values"] = random_numbers(rng, 1000);
+                arguments["step_size"] = 0.1;
+                add_call(workload, i, "numerical_differentiate", std::move(arguments));
+                break;
+        }
+    }
+    return workload;
+}
+
+// A few large arrays: dominated by parsing and encoding numbers
+static Workload large_workload() {
+    std::mt19937_64 rng(3);
+    Workload workload;
+    for (int i = 0; i < 10; i++) {
+        json::Value arguments;
+        arguments["data"] = random_numbers(rng, 100000);
+        add_call(workload, i, "calculate_statistics", std::move(arguments));
+    }
+    return workload;
+}
+
+// Mirrors the server: notifications and all-notification batches go
+// unanswered, while anything else, including malformed input, gets a reply
+static bool expects_response(const std::string& line) {
+    json::Value request;
+    try {
+        request = json::parse(line);
+    } catch (const std::exception&) {
+        return true;
+    }
+    
+    auto is_notification = [](const json::Value& entry) {
+        return entry.is_object() && entry.as_object().count("id") == 0;
+    };
+    if (request.is_array()) {
+        const json::Array& entries = request.as_array();
+        if (entries.empty()) return true;
+        for (const auto& entry : entries) {
+            if (!is_notification(entry)) return true;
+        }
+        return false;
+    }
+    return !is_notification(request);
+}
+
+// One request per line
+static Workload file_workload(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open replay file: " + path);
+    }
+    
+    Workload workload;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        workload.payload += line;
+        workload.payload += '\n';
+        if (expects_response(line)) workload.responses++;
+    }
+    return workload;
+}
+
+static void run_replay(benchmark::State& state, const Workload& workload, int workers) {
+    std::vector<std::string> args = {server_path()};
+    if (workers > 0) {
+        args.push_back("-w");
+        args.push_back(std::to_string(workers));
+    }
+    ServerProcess server(args);
+    
+    const std::string initialize =
+        "{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"initialize\",\"params\":{}}\n";
+    if (!server.send(initialize) || !server.read_lines(1)) {
+        state.SkipWithError(("Could not start " + args[0]).c_str());
+        return;
+    }
+    
+    for (auto _ : state) {
+        // Write from a second thread so a full stdout pipe cannot stall the server
+        bool sent = true;
+        std::thread writer([&] { sent = server.send(workload.payload); });
+        bool received = server.read_lines(workload.responses);
+        writer.join();
+        if (!sent || !received) {
+            state.SkipWithError("Server exited during replay");
+            break;
+        }
+    }
+    
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * workload.payload.size());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * workload.responses);
+}
+
+// Registers the replays before BENCHMARK_MAIN runs
+static const bool replay_registered = [] {
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    static const Workload small = small_workload();
+    static const Workload mixed = mixed_workload();
+    static const Workload large = large_workload();
+    auto replay = [](const Workload* workload, int workers) {
+        return [workload, workers](benchmark::State& state) { run_replay(state, *workload, workers); };
+    };
+    const std::pair<const char*, const Workload*> workloads[] = {
+        {"small", &small}, {"mixed", &mixed}, {"large", &large}};
+    
+    for (int workers : {0, 4}) {
+        for (const auto& [name, workload] : workloads) {
+            std::string label = std::string("BM_Replay/") + name + "/workers:" + std::to_string(workers);
+            benchmark::RegisterBenchmark(label.c_str(), replay(workload, workers))
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+    
+    if (const char* path = std::getenv("MATH_BENCH_REPLAY")) {
+        static const Workload file = file_workload(path);
+        for (int workers : {0, 4}) {
+            std::string label = "BM_Replay/file/workers:" + std::to_string(workers);
+            benchmark::RegisterBenchmark(label.c_str(), replay(&file, workers))
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+    return true;
+}();
@@ -0,0 +1,153 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace json {
+    
+    // Monotonic arena backing the json containers. Memory is bumped out of
+    // fixed-size blocks and never freed piecemeal: the arena is rewound to an
+    // earlier mark instead, which releases everything allocated since in one
+    // step. Whatever lives in that memory must be destroyed before the
+    // rewind. Not thread-safe; each arena is used by one thread at a time.
+    class Arena {
+    public:
+        static constexpr size_t kBlockSize = 64 * 1024;
+        // Larger allocations go to the heap, so a growing array never leaves
+        // big dead copies behind and huge payloads are freed eagerly
+        static constexpr size_t kMaxAllocation = kBlockSize / 4;
+        // Blocks kept for reuse when the arena is rewound to the start
+        static constexpr size_t kRetainedBlocks = 4;
+        
+        struct Mark {
+            size_t block = 0;
+            size_t offset = 0;
+        };
+        
+        Arena() = default;
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        
+        // 8-byte aligned; bytes must not exceed kMaxAllocation
+        void* allocate(size_t bytes) {
+            bytes = (bytes + 7) & ~size_t(7);
+            if (block_ < blocks_.size() && offset_ + bytes <= kBlockSize) {
+                void* p = blocks_[block_].get() + offset_;
+                offset_ += bytes;
+                return p;
+            }
+            return allocate_slow(bytes);
+        }
+        
+        Mark mark() const { return {block_, offset_}; }
+        void rewind(Mark mark);
+        
+        // Bytes in use, counting the unused tails of filled blocks
+        size_t used() const { return block_ * kBlockSize + offset_; }
+    
+    private:
+        void* allocate_slow(size_t bytes);
+        
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        size_t block_ = 0;
+        size_t offset_ = 0;
+    };
+    
+    // Arena of the calling thread, for work whose values die before it
+    // returns to the thread's loop
+    Arena& thread_arena();
+    
+    namespace detail {
+        
+        // Target of json allocations on this thread; null means the heap
+        inline thread_local Arena* current_arena = nullptr;
+        
+        // Each allocation is preceded by a word recording where it came from,
+        // so a container can be freed on any thread, inside or outside a
+        // scope, and only heap memory is actually released. Heap blocks pad
+        // the header to 16 bytes to keep operator new's alignment for the
+        // large number arrays that end up there.
+        enum : uint64_t { kFromHeap = 0, kFromArena = 1 };
+        constexpr size_t kHeader = sizeof(uint64_t);
+        constexpr size_t kHeapHeader = 2 * sizeof(uint64_t);
+        
+        inline void* allocate(size_t bytes) {
+            Arena* arena = current_arena;
+            if (arena && bytes <= Arena::kMaxAllocation - kHeader) {
+                uint64_t* p = static_cast<uint64_t*>(arena->allocate(bytes + kHeader));
+                p[0] = kFromArena;
+                return p + 1;
+            }
+            uint64_t* p = static_cast<uint64_t*>(::operator new(bytes + kHeapHeader));
+            p[1] = kFromHeap;
+            return p + 2;
+        }
+        
+        inline void deallocate(void* ptr) {
+            uint64_t* p = static_cast<uint64_t*>(ptr);
+            if (p[-1] == kFromHeap) {
+                ::operator delete(p - 2);
+            }
+        }
+        
+    }
+    
+    // Stateless allocator of the json containers: allocates from the current
+    // thread's arena inside an ArenaScope and from the heap otherwise. All
+    // instances compare equal, so containers move between scopes and threads
+    // without copying.
+    template <typename T>
+    struct Allocator {
+        using value_type = T;
+        
+        Allocator() = default;
+        template <typename U>
+        Allocator(const Allocator<U>&) {}
+        
+        T* allocate(size_t n) {
+            static_assert(alignof(T) <= detail::kHeader, "json allocations are 8-byte aligned");
+            return static_cast<T*>(detail::allocate(n * sizeof(T)));
+        }
+        void deallocate(T* p, size_t) { detail::deallocate(p); }
+        
+        friend bool operator==(const Allocator&, const Allocator&) { return true; }
+        friend bool operator!=(const Allocator&, const Allocator&) { return false; }
+    };
+    
+    // Routes this thread's json allocations to `arena` while alive and
+    // restores the previous target on exit. Unless keep() is called the
+    // arena is also rewound to where it stood on entry, so values built
+    // inside must be destroyed first: declare the scope before them.
+    class ArenaScope {
+    public:
+        explicit ArenaScope(Arena& arena)
+            : arena_(arena), mark_(arena.mark()), previous_(detail::current_arena) {
+            detail::current_arena = &arena;
+        }
+        
+        ~ArenaScope() {
+            detail::current_arena = previous_;
+            if (!keep_) {
+                arena_.rewind(mark_);
+            }
+        }
+        
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+        
+        // Leave what was allocated in place for a longer-lived owner
+        void keep() { keep_ = true; }
+        
+        // Bytes allocated since the scope was entered
+        size_t used() const { return arena_.used() - (mark_.block * Arena::kBlockSize + mark_.offset); }
+    
+    private:
+        Arena& arena_;
+        Arena::Mark mark_;
+        Arena* previous_;
+        bool keep_ = false;
+    };
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "math_operations.hpp"
+
+namespace math_ops {
+    
+    // Integration and differentiation of sampled signals. The kernels are
+    // branch-free in their inner loops and split long signals across threads,
+    // so on large inputs they run at memory bandwidth.
+    
+    enum class IntegrationRule { Trapezoid, Simpson };
+    
+    // Definite integral of samples y spaced h apart. Simpson's rule takes any
+    // count of at least 3: with an odd number of intervals the last one is
+    // integrated under the parabola through its final three points. Two
+    // points fall back to the trapezoid.
+    double integrate(VectorView y, double h, IntegrationRule rule);
+    // The same over samples at strictly increasing abscissae x
+    double integrate(VectorView x, VectorView y, IntegrationRule rule);
+    
+    // Running integral from the first sample: out[0] = 0 and out[i] is the
+    // integral up to sample i, ending at the value integrate() returns. For
+    // Simpson's rule each interval is integrated under the parabola through
+    // its pair of intervals, so every even-indexed value is exactly Simpson.
+    Vector cumulative_integral(VectorView y, double h, IntegrationRule rule);
+    Vector cumulative_integral(VectorView x, VectorView y, IntegrationRule rule);
+    
+    // First derivative from central differences of the given order of
+    // accuracy (2, 4 or 6), with one-sided stencils of the same order at the
+    // ends. Needs at least accuracy + 1 samples.
+    Vector differentiate(VectorView y, double h, int accuracy);
+    // Second-order first derivative on a non-uniform grid: three-point
+    // differences inside and one-sided second-order ones at the ends
+    Vector differentiate(VectorView x, VectorView y);
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "json.hpp"
+
+namespace cbor {
+    
+    // CBOR (RFC 8949) encoding of json::Value trees for the binary transport.
+    // Number arrays are written as RFC 8746 typed arrays (tag 86, float64
+    // little-endian), so a double costs 8 bytes on the wire and is copied in
+    // and out with memcpy. Decoding turns float typed arrays, and plain
+    // arrays whose items are all numbers, into json::NumberArray like the
+    // JSON parser does.
+    void encode(const json::Value& value, std::string& out);
+    std::string encode(const json::Value& value);
+    json::Value decode(std::string_view data);
+    // Head of a definite-length array; the items are appended after it
+    void encode_array_head(size_t count, std::string& out);
+    
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "json.hpp"
+#include "math_operations.hpp"
+
+namespace math_ops {
+    
+    // A 1-D or 2-D array of doubles. The values live in `owner`: a Vector
+    // or Matrix held by the server, or a file mapping (`mapped`) the values
+    // are read from in place. Without an owner the values are borrowed from
+    // the request's parsed arguments and only valid while it is handled.
+    struct Dataset {
+        std::shared_ptr<const void> owner;
+        const double* values = nullptr;
+        size_t rows = 1;
+        size_t cols = 0;
+        bool is_matrix = false;
+        bool mapped = false;
+        
+        VectorView vector() const { return VectorView(values, rows * cols); }
+        MatrixView matrix() const { return MatrixView(values, rows, cols, cols); }
+        size_t bytes() const { return rows * cols * sizeof(double); }
+        json::Value shape() const;
+    };
+    
+    // Session-wide store of datasets referenced by string handles, so data
+    // that several tool calls share is parsed once. Total size of the buffers
+    // the server owns is capped (mapped files do not count); inserting past
+    // the cap evicts least recently used datasets. Lookups
+    // hand out shared pointers, so a dataset evicted or released while a
+    // tool is still using it stays alive until that call finishes.
+    // All methods are thread-safe.
+    class DatasetStore {
+    public:
+        explicit DatasetStore(size_t memory_limit_bytes);
+        
+        std::string put(Vector values);
+        std::string put(Matrix values);
+        std::string put(Dataset data);
+        
+        // Throws if the handle is unknown or has been evicted
+        Dataset get(const std::string& handle);
+        bool release(const std::string& handle);
+        
+        // Tool arguments: an inline JSON array, a handle string or a file
+        // spec (see file_input.hpp). A packed numeric vector is returned as
+        // a view of the argument rather than copied.
+        Dataset resolve_vector(const json::Value& arg);
+        Dataset resolve_matrix(const json::Value& arg);
+        
+        // {handle, shape, bytes} for one dataset, and a listing of all of them
+        json::Value describe(const std::string& handle);
+        json::Value list() const;
+        
+        size_t memory_limit() const { return memory_limit_; }
+        
+    private:
+        struct Entry {
+            std::string handle;
+            Dataset data;
+        };
+        
+        size_t memory_limit_;
+        size_t bytes_used_ = 0;
+        size_t next_id_ = 1;
+        std::list<Entry> lru_;  // most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+        mutable std::mutex mutex_;
+        
+        std::list<Entry>::iterator find(const std::string& handle);
+    };
+    
+}
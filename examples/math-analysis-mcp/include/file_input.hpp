@@ -0,0 +1,19 @@
+#pragma once
+#include "dataset_store.hpp"
+#include "json.hpp"
+
+namespace math_ops {
+    
+    // Tool arguments may name an array on disk instead of carrying it inline:
+    //   {"path": "...", "format": "raw" | "npy" | "hdf5",
+    //    "dtype": "float64", "offset": 0, "shape": [n] or [rows, cols],  (raw)
+    //    "dataset": "/group/name", "start": [...], "count": [...]}       (hdf5)
+    // The format defaults from the file extension. Raw and .npy files are
+    // memory-mapped; little-endian float64 at an 8-byte aligned offset is used
+    // in place without copying, anything else is converted into an owned
+    // buffer. HDF5 datasets are read through a hyperslab selection when the
+    // server is built with HDF5.
+    bool is_file_spec(const json::Value& arg);
+    Dataset read_array_file(const json::Value& spec);
+    
+}
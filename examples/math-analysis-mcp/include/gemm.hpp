@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+
+namespace math_ops {
+    
+    // General matrix multiply on row-major operands:
+    //   C = alpha * A * B + beta * C
+    // A is m x k with row stride lda, B is k x n with row stride ldb, and C is
+    // m x n with row stride ldc. Large products are packed into contiguous
+    // panels, tiled for L1/L2, run through an AVX-512, AVX2 or portable
+    // microkernel picked at runtime, and split across threads by row blocks.
+    // When beta is 0, C is overwritten without being read.
+    void gemm(size_t m, size_t n, size_t k, double alpha,
+              const double* a, size_t lda, const double* b, size_t ldb,
+              double beta, double* c, size_t ldc);
+    
+    // Name of the microkernel selected for this CPU ("avx512", "avx2" or "generic")
+    const char* gemm_kernel_name();
+    
+}
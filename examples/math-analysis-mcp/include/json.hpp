@@ -1,29 +1,50 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
 #include <variant>
 #include <memory>
+#include <utility>
+#include "arena.hpp"
 
 namespace json {
     class Value;
     
-    using Object = std::map<std::string, Value>;
-    using Array = std::vector<Value>;
+    // Containers draw from the current ArenaScope, if any (see arena.hpp)
+    using Object = std::map<std::string, Value, std::less<std::string>, Allocator<std::pair<const std::string, Value>>>;
+    using Array = std::vector<Value, Allocator<Value>>;
+    // Packed storage for arrays whose elements are all numbers; the parser
+    // produces it for homogeneous numeric arrays so they stay contiguous
+    using NumberArray = std::vector<double, Allocator<double>>;
     using Null = std::nullptr_t;
     
+    // Already serialized JSON spliced into a tree without reparsing. The text
+    // is shared, so one payload can be written both verbatim and as an
+    // escaped string literal without being copied.
+    struct RawJson {
+        std::shared_ptr<const std::string> text;
+        bool as_string = false;
+    };
+    
     class Value {
     public:
-        using ValueType = std::variant<Null, bool, int, double, std::string, Array, Object>;
+        using ValueType = std::variant<Null, bool, int, double, std::string, Array, Object, NumberArray, RawJson>;
         
         Value() : value_(nullptr) {}
         Value(bool v) : value_(v) {}
         Value(int v) : value_(v) {}
         Value(double v) : value_(v) {}
         Value(const std::string& v) : value_(v) {}
+        Value(std::string&& v) : value_(std::move(v)) {}
         Value(const char* v) : value_(std::string(v)) {}
         Value(const Array& v) : value_(v) {}
+        Value(Array&& v) : value_(std::move(v)) {}
         Value(const Object& v) : value_(v) {}
+        Value(Object&& v) : value_(std::move(v)) {}
+        Value(const NumberArray& v) : value_(v) {}
+        Value(NumberArray&& v) : value_(std::move(v)) {}
+        Value(RawJson v) : value_(std::move(v)) {}
         
         bool is_null() const { return std::holds_alternative<Null>(value_); }
         bool is_bool() const { return std::holds_alternative<bool>(value_); }
@@ -32,6 +53,8 @@ namespace json {
         bool is_string() const { return std::holds_alternative<std::string>(value_); }
         bool is_array() const { return std::holds_alternative<Array>(value_); }
         bool is_object() const { return std::holds_alternative<Object>(value_); }
+        bool is_number_array() const { return std::holds_alternative<NumberArray>(value_); }
+        bool is_raw() const { return std::holds_alternative<RawJson>(value_); }
         
         bool as_bool() const { return std::get<bool>(value_); }
         int as_int() const { return std::get<int>(value_); }
@@ -39,9 +62,12 @@ namespace json {
         const std::string& as_string() const { return std::get<std::string>(value_); }
         const Array& as_array() const { return std::get<Array>(value_); }
         const Object& as_object() const { return std::get<Object>(value_); }
+        const NumberArray& as_number_array() const { return std::get<NumberArray>(value_); }
+        const RawJson& as_raw() const { return std::get<RawJson>(value_); }
         
         Array& as_array() { return std::get<Array>(value_); }
         Object& as_object() { return std::get<Object>(value_); }
+        NumberArray& as_number_array() { return std::get<NumberArray>(value_); }
         
         Value& operator[](const std::string& key) {
             if (!is_object()) {
@@ -67,6 +93,24 @@ namespace json {
         ValueType value_;
     };
     
-    Value parse(const std::string& json_str);
+    // Appending serializer: formats into a caller-owned buffer so the same
+    // storage can be reused across messages. Doubles use the shortest
+    // representation that round-trips exactly.
+    class Writer {
+    public:
+        explicit Writer(std::string& out) : out_(out) {}
+        
+        void write(const Value& value);
+        
+    private:
+        void write_int(int value);
+        void write_double(double value);
+        void write_string(std::string_view str);
+        
+        std::string& out_;
+    };
+    
+    Value parse(std::string_view json_str);
+    void stringify(const Value& value, std::string& out);
     std::string stringify(const Value& value);
 }
\ No newline at end of file
@@ -1,44 +1,89 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 #include "json.hpp"
+#include "matrix.hpp"
 
 namespace math_ops {
     
     // Statistical operations
+    
+    // Bit flags selecting which statistics to compute; work needed only by
+    // unrequested fields (the variance pass, the median/mode sort) is skipped
+    enum StatisticsField : unsigned {
+        kStatMean     = 1u << 0,
+        kStatMedian   = 1u << 1,
+        kStatMode     = 1u << 2,
+        kStatStdDev   = 1u << 3,
+        kStatVariance = 1u << 4,
+        kStatMin      = 1u << 5,
+        kStatMax      = 1u << 6,
+        kStatRange    = 1u << 7,
+        kStatCount    = 1u << 8,
+        kStatAll      = (1u << 9) - 1
+    };
+    
     struct Statistics {
-        double mean;
-        double median;
-        double mode;
-        double std_dev;
-        double variance;
-        double min;
-        double max;
-        double range;
-        size_t count;
+        double mean = 0.0;
+        double median = 0.0;
+        double mode = 0.0;
+        double std_dev = 0.0;
+        double variance = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        double range = 0.0;
+        size_t count = 0;
+        unsigned fields = kStatAll;
     };
     
-    Statistics calculate_statistics(const std::vector<double>& data);
+    Statistics calculate_statistics(VectorView data, unsigned fields = kStatAll);
+    // Maps an array of statistic names ("mean", "median", ...) to StatisticsField flags
+    unsigned statistics_fields_from_json(const json::Value& names);
     
     // Linear algebra operations
-    using Matrix = std::vector<std::vector<double>>;
+    // Matrices are the contiguous math_ops::Matrix from matrix.hpp; routines
+    // take MatrixView so blocks of a larger matrix can be passed without copying
     using Vector = std::vector<double>;
     
-    Matrix multiply_matrices(const Matrix& a, const Matrix& b);
-    Vector multiply_matrix_vector(const Matrix& m, const Vector& v);
-    double dot_product(const Vector& a, const Vector& b);
-    Matrix transpose(const Matrix& m);
-    double determinant(const Matrix& m);
+    Matrix multiply_matrices(MatrixView a, MatrixView b);
+    Vector multiply_matrix_vector(MatrixView m, VectorView v);
+    double dot_product(VectorView a, VectorView b);
+    Matrix transpose(MatrixView m);
+    double determinant(MatrixView m);
+    
+    // In-place LU factorization with partial pivoting, PA = LU. The unit lower
+    // L is left below the diagonal and U on and above it; row i was swapped
+    // with pivots[i]. Returns the sign of the permutation. A zero pivot marks
+    // a singular matrix and is left in place. Large matrices are factored in
+    // panels with the trailing update done by gemm.
+    int lu_factor(MutableMatrixView a, std::vector<size_t>& pivots);
+    // Solves A x = b in place using the output of lu_factor
+    void lu_solve(MatrixView lu, const std::vector<size_t>& pivots, Vector& b);
     
     // Numerical analysis
-    double integrate_simpson(const std::vector<double>& y_values, double h);
-    Vector differentiate_numerical(const std::vector<double>& y_values, double h);
-    std::vector<double> polynomial_fit(const std::vector<double>& x, const std::vector<double>& y, int degree);
+    double integrate_simpson(VectorView y_values, double h);
+    Vector differentiate_numerical(VectorView y_values, double h);
+    
+    // Least-squares polynomial fitting. x is mapped onto [-1, 1] before fitting
+    // and the coefficients are converted back, so high degrees stay well scaled.
+    // NormalEquations accumulates the power sums in one O(n*d) pass without a
+    // Vandermonde matrix; QR runs Householder reflections on the Vandermonde
+    // matrix for ill-conditioned data.
+    enum class FitMethod { NormalEquations, QR };
+    
+    std::vector<double> polynomial_fit(VectorView x, VectorView y, int degree,
+                                       FitMethod method = FitMethod::NormalEquations);
+    // Fits every requested degree from a single pass over the data
+    std::vector<Vector> polynomial_fit_batch(VectorView x, VectorView y,
+                                             const std::vector<int>& degrees);
     
     // Utility functions
     json::Value statistics_to_json(const Statistics& stats);
-    json::Value matrix_to_json(const Matrix& m);
-    json::Value vector_to_json(const Vector& v);
+    // An integer while it fits in the JSON int, a double beyond that
+    json::Value count_to_json(uint64_t count);
+    json::Value matrix_to_json(MatrixView m);
+    json::Value vector_to_json(VectorView v);
     
     Matrix json_to_matrix(const json::Value& json_val);
     Vector json_to_vector(const json::Value& json_val);
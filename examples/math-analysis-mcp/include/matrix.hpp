@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace math_ops {
+    
+    // Allocator handing out cache-line aligned storage for dense buffers
+    template <typename T, size_t Alignment = 64>
+    struct AlignedAllocator {
+        using value_type = T;
+        
+        template <typename U>
+        struct rebind { using other = AlignedAllocator<U, Alignment>; };
+        
+        AlignedAllocator() noexcept = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+        
+        T* allocate(size_t n) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+        
+        void deallocate(T* p, size_t) noexcept {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+        
+        template <typename U>
+        bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+    };
+    
+    // Non-owning row-major window onto doubles: rows x cols elements with row
+    // starts `stride` elements apart. Blocks of a view are views themselves,
+    // so slicing never copies.
+    template <typename T>
+    class BasicMatrixView {
+    public:
+        BasicMatrixView() = default;
+        BasicMatrixView(T* data, size_t rows, size_t cols, size_t stride)
+            : data_(data), rows_(rows), cols_(cols), stride_(stride) {}
+        
+        // A mutable view converts to a read-only one
+        template <typename U, typename = std::enable_if_t<std::is_same_v<T, const U>>>
+        BasicMatrixView(const BasicMatrixView<U>& other)
+            : data_(other.data()), rows_(other.rows()), cols_(other.cols()), stride_(other.stride()) {}
+        
+        size_t rows() const { return rows_; }
+        size_t cols() const { return cols_; }
+        size_t stride() const { return stride_; }
+        bool empty() const { return rows_ == 0 || cols_ == 0; }
+        bool is_square() const { return rows_ == cols_; }
+        
+        T* data() const { return data_; }
+        T* row(size_t i) const { return data_ + i * stride_; }
+        T& operator()(size_t i, size_t j) const { return data_[i * stride_ + j]; }
+        
+        BasicMatrixView block(size_t row0, size_t col0, size_t rows, size_t cols) const {
+            if (row0 + rows > rows_ || col0 + cols > cols_) {
+                throw std::out_of_range("Matrix block out of range");
+            }
+            return BasicMatrixView(data_ + row0 * stride_ + col0, rows, cols, stride_);
+        }
+        
+    private:
+        T* data_ = nullptr;
+        size_t rows_ = 0;
+        size_t cols_ = 0;
+        size_t stride_ = 0;
+    };
+    
+    using MatrixView = BasicMatrixView<const double>;
+    using MutableMatrixView = BasicMatrixView<double>;
+    
+    // Non-owning read-only run of doubles. Converts implicitly from a vector,
+    // so kernels accept owned buffers and file mappings alike.
+    class VectorView {
+    public:
+        VectorView() = default;
+        VectorView(const double* data, size_t size) : data_(data), size_(size) {}
+        template <typename Alloc>
+        VectorView(const std::vector<double, Alloc>& v) : data_(v.data()), size_(v.size()) {}
+        
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        const double* data() const { return data_; }
+        const double* begin() const { return data_; }
+        const double* end() const { return data_ + size_; }
+        double operator[](size_t i) const { return data_[i]; }
+        
+    private:
+        const double* data_ = nullptr;
+        size_t size_ = 0;
+    };
+    
+    // Dense row-major matrix in one aligned allocation. Rows are stored back
+    // to back (stride == cols), so the whole matrix is a single contiguous
+    // buffer that kernels and views can address directly.
+    class Matrix {
+    public:
+        Matrix() = default;
+        Matrix(size_t rows, size_t cols, double value = 0.0)
+            : rows_(rows), cols_(cols), data_(rows * cols, value) {}
+        Matrix(std::initializer_list<std::initializer_list<double>> rows);
+        
+        static Matrix from_view(MatrixView view);
+        
+        size_t rows() const { return rows_; }
+        size_t cols() const { return cols_; }
+        size_t stride() const { return cols_; }
+        size_t size() const { return data_.size(); }
+        bool empty() const { return rows_ == 0 || cols_ == 0; }
+        bool is_square() const { return rows_ == cols_; }
+        
+        double* data() { return data_.data(); }
+        const double* data() const { return data_.data(); }
+        double* row(size_t i) { return data_.data() + i * cols_; }
+        const double* row(size_t i) const { return data_.data() + i * cols_; }
+        double& operator()(size_t i, size_t j) { return data_[i * cols_ + j]; }
+        double operator()(size_t i, size_t j) const { return data_[i * cols_ + j]; }
+        
+        MatrixView view() const { return MatrixView(data(), rows_, cols_, cols_); }
+        MutableMatrixView view() { return MutableMatrixView(data(), rows_, cols_, cols_); }
+        operator MatrixView() const { return view(); }
+        
+        MatrixView block(size_t row0, size_t col0, size_t rows, size_t cols) const {
+            return view().block(row0, col0, rows, cols);
+        }
+        MutableMatrixView block(size_t row0, size_t col0, size_t rows, size_t cols) {
+            return view().block(row0, col0, rows, cols);
+        }
+        
+    private:
+        size_t rows_ = 0;
+        size_t cols_ = 0;
+        std::vector<double, AlignedAllocator<double>> data_;
+    };
+    
+}
@@ -1,40 +1,184 @@
 #pragma once
 #include <string>
 #include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <vector>
 #include "json.hpp"
+#include "metrics.hpp"
+#include "work_queue.hpp"
 
 namespace mcp {
     
+    // How a tool result is carried in a tools/call response
+    enum class OutputMode {
+        Both,            // text content and structuredContent
+        StructuredOnly,  // structuredContent only, content is left empty
+        TextOnly         // text content only, no outputSchema is advertised
+    };
+    
+    // Wire format of messages, negotiated per session during initialize
+    enum class Transport {
+        JsonLines,   // newline-delimited JSON text (the default)
+        CborFrames   // 4-byte big-endian length, then one CBOR-encoded message
+    };
+    
+    struct ToolOptions {
+        OutputMode output_mode = OutputMode::Both;
+        // Maximum calls of this tool running at once in concurrent mode (0 = unlimited)
+        size_t max_concurrency = 0;
+    };
+    
+    struct ServerOptions {
+        // Worker threads executing requests; 0 keeps the serial read-handle-write loop
+        size_t worker_threads = 0;
+        // Requests buffered between the reader and the workers before reading blocks
+        size_t queue_capacity = 64;
+        // Print the server/metrics report to stderr when run() returns
+        bool dump_metrics = false;
+        // Largest CBOR frame accepted; a longer length prefix ends the session
+        size_t max_frame_bytes = size_t(64) << 20;
+    };
+    
     class Server {
     public:
         using ToolHandler = std::function<json::Value(const json::Value& params)>;
         
-        Server(const std::string& name, const std::string& version);
+        Server(const std::string& name, const std::string& version,
+               const ServerOptions& options = ServerOptions());
         
         void register_tool(const std::string& name, const std::string& description, 
-                          const json::Value& input_schema, ToolHandler handler);
+                          const json::Value& input_schema, ToolHandler handler,
+                          const ToolOptions& options = ToolOptions());
         
+        // Tool handlers must be thread-safe when worker_threads > 0
         void run();
         
     private:
+        // Encoded responses of one batch request, one slot per entry (left
+        // empty for notifications). The entry finishing last writes the reply.
+        struct Batch {
+            std::vector<std::string> responses;
+            std::atomic<size_t> remaining{0};
+        };
+        
+        // Where one request spent its time, recorded once its response is encoded
+        struct RequestTrace {
+            EndpointMetrics* endpoint = nullptr;  // the tool called, if any
+            size_t bytes_in = 0;                  // 0 for batch entries; the batch is counted whole
+            uint64_t parse_ns = 0;
+            uint64_t queue_ns = 0;
+            uint64_t handler_ns = 0;
+            uint64_t stringify_ns = 0;
+            size_t arena_bytes = 0;               // json arena memory held by the request and its response
+            bool queued = false;
+            bool error = false;
+        };
+        
+        struct Job {
+            // Holds the memory `request` was parsed into, shared by the
+            // entries of a batch. Declared first so it is destroyed last.
+            std::shared_ptr<json::Arena> arena;
+            std::string message;
+            json::Value request;
+            bool parsed = false;
+            std::shared_ptr<Batch> batch;
+            size_t batch_index = 0;
+            std::chrono::steady_clock::time_point received;
+            RequestTrace trace;
+            
+            Job() = default;
+            Job(Job&&) = default;
+            // Member-wise, except that the old request goes before the
+            // arena it lives in is let go
+            Job& operator=(Job&& other) {
+                request = std::move(other.request);
+                arena = std::move(other.arena);
+                message = std::move(other.message);
+                parsed = other.parsed;
+                batch = std::move(other.batch);
+                batch_index = other.batch_index;
+                received = other.received;
+                trace = other.trace;
+                return *this;
+            }
+        };
+        
+        // Calls of a concurrency-limited tool; jobs over the limit wait here
+        // and are picked up by the worker that frees a slot
+        struct ToolSlots {
+            size_t limit = 0;
+            size_t active = 0;
+            std::deque<Job> waiting;
+        };
+        
         std::string server_name_;
         std::string server_version_;
         std::map<std::string, ToolHandler> tool_handlers_;
         std::map<std::string, std::string> tool_descriptions_;
         std::map<std::string, json::Value> tool_schemas_;
-        bool initialized_;
+        std::map<std::string, ToolOptions> tool_options_;
+        ServerOptions options_;
+        std::atomic<bool> initialized_;
+        std::atomic<Transport> transport_;
+        // Set by handle_initialize and applied once its response is serialized
+        Transport requested_transport_;
+        std::string output_buffer_;
+        std::map<std::string, ToolSlots> tool_slots_;
+        std::mutex tool_slots_mutex_;
+        
+        // Filled in by register_tool and read-only once run() starts
+        std::map<std::string, std::unique_ptr<EndpointMetrics>> tool_metrics_;
+        EndpointMetrics method_metrics_;  // requests that are not calls of a registered tool
+        EndpointMetrics batch_metrics_;   // batch arrays as a whole
+        Histogram write_latency_;
+        std::atomic<uint64_t> bytes_written_{0};
+        std::atomic<uint64_t> peak_request_bytes_{0};
+        std::atomic<uint64_t> peak_response_bytes_{0};
+        std::atomic<uint64_t> peak_arena_bytes_{0};
+        
+        // Reset arenas for parsed requests in concurrent mode, reused so a
+        // request costs no block allocations once the server is warm
+        std::vector<std::unique_ptr<json::Arena>> arena_pool_;
+        std::mutex arena_pool_mutex_;
+        std::chrono::steady_clock::time_point started_;
+        
+        void run_serial();
+        void run_concurrent();
+        void execute_job(Job job, WorkQueue<Job>& jobs, WorkQueue<std::string>& responses);
+        void dispatch_batch(json::Array entries, const std::shared_ptr<json::Arena>& arena,
+                            WorkQueue<Job>& jobs, WorkQueue<std::string>& responses);
+        std::shared_ptr<json::Arena> acquire_arena();
+        void finish_batch_entry(Job& job, const json::Value& response, WorkQueue<std::string>& responses);
+        ToolSlots* find_tool_slots(const json::Value& request);
+        bool process_message(const std::string& message, std::string& out);
+        bool finish_response(RequestTrace& trace, const json::Value& response, std::string& out);
+        void record_request(const RequestTrace& trace, const json::Value& response, size_t bytes_out);
+        void record_batch(const RequestTrace& trace);
+        json::Value decode_message(const std::string& message);
+        bool serialize_response(const json::Value& response, std::string& out);
+        void encode_message(const json::Value& message, std::string& out);
+        void frame_message(std::string& out, size_t start);
+        bool serialize_batch(const std::vector<std::string>& responses, std::string& out);
+        void apply_requested_transport();
         
-        json::Value handle_request(const json::Value& request);
+        json::Value handle_request(const json::Value& request, RequestTrace& trace);
+        json::Value route_request(const json::Value& request, RequestTrace& trace);
         json::Value handle_initialize(const json::Value& params);
         json::Value handle_tools_list();
-        json::Value handle_tools_call(const json::Value& params);
+        json::Value handle_tools_call(const json::Value& params, RequestTrace& trace);
+        json::Value handle_metrics();
+        json::Value create_tool_result(json::Value payload, OutputMode mode);
         
         json::Value create_error_response(int code, const std::string& message, const json::Value& id = json::Value());
-        json::Value create_success_response(const json::Value& result, const json::Value& id);
+        json::Value create_success_response(json::Value result, const json::Value& id);
         
-        std::string read_line();
-        void write_line(const std::string& line);
+        bool read_message(std::string& message);
+        void write_output(const std::string& data, bool flush);
     };
     
 }
\ No newline at end of file
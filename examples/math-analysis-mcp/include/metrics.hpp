@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "json.hpp"
+
+namespace mcp {
+    
+    // Log-linear (HDR-style) histogram of nanosecond durations. Values are
+    // grouped by power of two with 16 linear sub-buckets each, so every
+    // reported value is within 1/16 of a recorded one. Recording is a few
+    // relaxed atomic operations and safe from any thread.
+    class Histogram {
+    public:
+        void record(uint64_t value);
+        
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+        // Value at quantile q in [0, 1], reported as the top of its bucket
+        uint64_t quantile(double q) const;
+        // {count, mean_us, p50_us, p90_us, p99_us, p999_us, max_us}
+        json::Value to_json() const;
+        
+    private:
+        static constexpr int kSubBits = 4;
+        static constexpr int kSubBuckets = 1 << kSubBits;
+        static constexpr int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+        
+        static size_t bucket_of(uint64_t value);
+        static uint64_t bucket_top(size_t bucket);
+        
+        std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+    };
+    
+    // Counters and phase latencies for one tool, or for the non-tool methods
+    struct EndpointMetrics {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> bytes_in{0};
+        std::atomic<uint64_t> bytes_out{0};
+        Histogram parse;      // decoding the request message
+        Histogram queue;      // waiting for a worker (concurrent mode)
+        Histogram handler;    // running the request
+        Histogram stringify;  // encoding the result and the response
+        
+        json::Value to_json() const;
+    };
+    
+    // Raises `target` to at least `value`
+    inline void update_max(std::atomic<uint64_t>& target, uint64_t value) {
+        uint64_t current = target.load(std::memory_order_relaxed);
+        while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+    
+    inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - since).count();
+    }
+    
+}
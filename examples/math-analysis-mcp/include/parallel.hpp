@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace math_ops {
+    
+    // Threads the kernels may use: MATH_MCP_THREADS if set, otherwise the
+    // hardware concurrency, and never less than one
+    inline size_t max_threads() {
+        static const size_t threads = [] {
+            if (const char* env = std::getenv("MATH_MCP_THREADS")) {
+                long value = std::strtol(env, nullptr, 10);
+                if (value > 0) return static_cast<size_t>(value);
+            }
+            return std::max<size_t>(1, std::thread::hardware_concurrency());
+        }();
+        return threads;
+    }
+    
+    // Splits [0, n) into contiguous chunks of at least `grain` items, each a
+    // multiple of `align`, and runs body(begin, end) on each chunk. The
+    // calling thread takes the first chunk; small ranges run inline.
+    template <typename Body>
+    void parallel_for(size_t n, size_t grain, size_t align, Body body) {
+        size_t chunks = std::min(max_threads(), std::max<size_t>(1, n / std::max<size_t>(1, grain)));
+        if (chunks <= 1) {
+            body(size_t(0), n);
+            return;
+        }
+        
+        size_t chunk = (n + chunks - 1) / chunks;
+        chunk = (chunk + align - 1) / align * align;
+        
+        std::vector<std::thread> threads;
+        threads.reserve(chunks - 1);
+        for (size_t begin = chunk; begin < n; begin += chunk) {
+            size_t end = std::min(n, begin + chunk);
+            threads.emplace_back([&body, begin, end] { body(begin, end); });
+        }
+        body(size_t(0), std::min(n, chunk));
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include "matrix.hpp"
+
+namespace math_ops {
+    
+    // Square matrices from 2x2 up to this size get fixed-size kernels
+    constexpr size_t kSmallMatrixMin = 2;
+    constexpr size_t kSmallMatrixMax = 8;
+    
+    // Fixed-size row-major matrix held by value, so kernels on it need no
+    // allocation and every loop has a compile-time trip count the compiler
+    // can unroll completely
+    template <size_t R, size_t C>
+    struct SmallMatrix {
+        std::array<double, R * C> data{};
+        
+        static constexpr size_t rows() { return R; }
+        static constexpr size_t cols() { return C; }
+        
+        double& operator()(size_t i, size_t j) { return data[i * C + j]; }
+        double operator()(size_t i, size_t j) const { return data[i * C + j]; }
+        
+        static SmallMatrix from_view(MatrixView m) {
+            SmallMatrix result;
+            for (size_t i = 0; i < R; i++) {
+                for (size_t j = 0; j < C; j++) {
+                    result(i, j) = m(i, j);
+                }
+            }
+            return result;
+        }
+        
+        MatrixView view() const { return MatrixView(data.data(), R, C, C); }
+    };
+    
+    template <size_t N, size_t K, size_t M>
+    SmallMatrix<N, M> multiply(const SmallMatrix<N, K>& a, const SmallMatrix<K, M>& b) {
+        SmallMatrix<N, M> c;
+        for (size_t i = 0; i < N; i++) {
+            for (size_t k = 0; k < K; k++) {
+                const double aik = a(i, k);
+                for (size_t j = 0; j < M; j++) {
+                    c(i, j) += aik * b(k, j);
+                }
+            }
+        }
+        return c;
+    }
+    
+    template <size_t R, size_t C>
+    SmallMatrix<C, R> transpose(const SmallMatrix<R, C>& m) {
+        SmallMatrix<C, R> t;
+        for (size_t i = 0; i < R; i++) {
+            for (size_t j = 0; j < C; j++) {
+                t(j, i) = m(i, j);
+            }
+        }
+        return t;
+    }
+    
+    // Closed forms up to 3x3; larger sizes eliminate with partial pivoting
+    // like lu_factor, on a copy that stays in registers or on the stack
+    template <size_t N>
+    double determinant(SmallMatrix<N, N> m) {
+        if constexpr (N == 1) {
+            return m(0, 0);
+        } else if constexpr (N == 2) {
+            return m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+        } else if constexpr (N == 3) {
+            return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1))
+                 - m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0))
+                 + m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+        } else {
+            double det = 1.0;
+            for (size_t k = 0; k < N; k++) {
+                size_t pivot = k;
+                for (size_t r = k + 1; r < N; r++) {
+                    if (std::abs(m(r, k)) > std::abs(m(pivot, k))) {
+                        pivot = r;
+                    }
+                }
+                if (m(pivot, k) == 0.0) {
+                    return 0.0;
+                }
+                if (pivot != k) {
+                    for (size_t c = k; c < N; c++) {
+                        std::swap(m(k, c), m(pivot, c));
+                    }
+                    det = -det;
+                }
+                
+                const double p = m(k, k);
+                det *= p;
+                for (size_t r = k + 1; r < N; r++) {
+                    const double f = m(r, k) / p;
+                    for (size_t c = k + 1; c < N; c++) {
+                        m(r, c) -= f * m(k, c);
+                    }
+                }
+            }
+            return det;
+        }
+    }
+    
+    // Calls f(std::integral_constant<size_t, N>{}) for a runtime n in
+    // [kSmallMatrixMin, kSmallMatrixMax]; returns false for other sizes
+    template <typename F>
+    bool dispatch_small_size(size_t n, F&& f) {
+        switch (n) {
+            case 2: f(std::integral_constant<size_t, 2>{}); return true;
+            case 3: f(std::integral_constant<size_t, 3>{}); return true;
+            case 4: f(std::integral_constant<size_t, 4>{}); return true;
+            case 5: f(std::integral_constant<size_t, 5>{}); return true;
+            case 6: f(std::integral_constant<size_t, 6>{}); return true;
+            case 7: f(std::integral_constant<size_t, 7>{}); return true;
+            case 8: f(std::integral_constant<size_t, 8>{}); return true;
+            default: return false;
+        }
+    }
+    
+    // Runtime-sized entry points for the tools. Each handles square operands
+    // of a small size and returns false, leaving the output untouched, for
+    // anything else so the caller can fall back to the general routine.
+    // `out` must hold n*n doubles.
+    bool small_multiply(MatrixView a, MatrixView b, double* out);
+    bool small_determinant(MatrixView m, double& det);
+    
+    // Batched kernels over `count` n x n matrices in structure-of-arrays
+    // layout: element (i, j) of matrix b is at [(i * n + j) * count + b], so
+    // each step of a kernel runs across the whole batch with unit stride.
+    // n must be in [kSmallMatrixMin, kSmallMatrixMax].
+    void batch_multiply_soa(size_t n, size_t count, const double* a, const double* b, double* out);
+    void batch_transpose_soa(size_t n, size_t count, const double* m, double* out);
+    void batch_determinant_soa(size_t n, size_t count, const double* m, double* out);
+    
+    // Converts between matrix-after-matrix (AoS) and SoA layouts for `count`
+    // matrices of `elements` values each
+    void aos_to_soa(size_t elements, size_t count, const double* in, double* out);
+    void soa_to_aos(size_t elements, size_t count, const double* in, double* out);
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "json.hpp"
+#include "matrix.hpp"
+
+namespace math_ops {
+    
+    // Count, mean, centred sum of squares and extremes of a sample. Two
+    // summaries merge exactly (Chan et al.), so moments of a dataset split
+    // across calls or ranks can be combined without revisiting the data.
+    struct MomentSummary {
+        size_t count = 0;
+        double mean = 0.0;
+        double m2 = 0.0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        
+        void merge(const MomentSummary& other);
+        double variance() const { return count ? m2 / count : 0.0; }
+    };
+    
+    // Moments of a contiguous range: one fused sum/min/max sweep per
+    // cache-resident block, plus a centred sweep over the same block when
+    // with_m2 is set (m2 is left at 0 otherwise)
+    MomentSummary summarize_moments(const double* data, size_t n, bool with_m2 = true);
+    
+    // Merging t-digest (Dunning & Ertl) with the arcsine scale function.
+    // Holds O(compression) centroids regardless of how many values were added;
+    // quantile estimates are most accurate near the tails and merging two
+    // digests gives the digest of the combined data.
+    class TDigest {
+    public:
+        struct Centroid {
+            double mean;
+            double weight;
+        };
+        
+        explicit TDigest(double compression = 100.0);
+        
+        void add(const double* data, size_t n);
+        void merge(const TDigest& other);
+        
+        // Estimated value at quantile q in [0, 1]
+        double quantile(double q) const;
+        // Upper estimate of the rank error (as a fraction of the count) of quantile(q)
+        double rank_error(double q) const;
+        
+        double compression() const { return compression_; }
+        double total_weight() const { return total_weight_; }
+        const std::vector<Centroid>& centroids() const;
+        
+        static TDigest from_centroids(double compression, std::vector<Centroid> centroids, double min, double max);
+        
+    private:
+        double compression_;
+        double total_weight_ = 0.0;
+        double min_ = std::numeric_limits<double>::infinity();
+        double max_ = -std::numeric_limits<double>::infinity();
+        mutable std::vector<Centroid> centroids_;
+        mutable std::vector<Centroid> buffer_;
+        
+        void flush() const;
+        double scale_k(double q) const;
+        double scale_q(double k) const;
+    };
+    
+    // Moments plus quantile sketch for one chunk of data
+    struct StatisticsSummary {
+        MomentSummary moments;
+        TDigest digest;
+        
+        void merge(const StatisticsSummary& other);
+    };
+    
+    StatisticsSummary summarize(VectorView data, double compression = 100.0);
+    
+    json::Value summary_to_json(const StatisticsSummary& summary);
+    StatisticsSummary json_to_summary(const json::Value& json_val);
+    
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace mcp {
+    
+    // Multi-producer/multi-consumer FIFO shared by the reader, worker and
+    // writer threads. A capacity of 0 means unbounded; otherwise push blocks
+    // (and try_push fails) while the queue is full. pop blocks while the queue is empty and
+    // returns false once the queue has been closed and drained.
+    template <typename T>
+    class WorkQueue {
+    public:
+        explicit WorkQueue(size_t capacity = 0) : capacity_(capacity) {}
+        
+        bool push(T item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [&] { return closed_ || capacity_ == 0 || items_.size() < capacity_; });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(std::move(item));
+            lock.unlock();
+            not_empty_.notify_one();
+            return true;
+        }
+        
+        // Non-blocking push; item is only moved from when it was queued
+        bool try_push(T& item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (closed_ || (capacity_ != 0 && items_.size() >= capacity_)) {
+                return false;
+            }
+            items_.push_back(std::move(item));
+            lock.unlock();
+            not_empty_.notify_one();
+            return true;
+        }
+        
+        bool pop(T& item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+            if (items_.empty()) {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            lock.unlock();
+            not_full_.notify_one();
+            return true;
+        }
+        
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+            }
+            not_empty_.notify_all();
+            not_full_.notify_all();
+        }
+        
+        bool empty() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return items_.empty();
+        }
+        
+    private:
+        size_t capacity_;
+        std::deque<T> items_;
+        bool closed_ = false;
+        mutable std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+    };
+    
+}
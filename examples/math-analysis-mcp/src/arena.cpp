@@ -0,0 +1,34 @@
+#include "arena.hpp"
+#include <algorithm>
+
+namespace json {
+    
+    void* Arena::allocate_slow(size_t bytes) {
+        // Move on to the next block, reusing one kept from an earlier rewind
+        if (block_ < blocks_.size()) {
+            block_++;
+        }
+        if (block_ == blocks_.size()) {
+            blocks_.emplace_back(new char[kBlockSize]);
+        }
+        offset_ = bytes;
+        return blocks_[block_].get();
+    }
+    
+    void Arena::rewind(Mark mark) {
+        block_ = mark.block;
+        offset_ = mark.offset;
+        // Trim what a large request grew the arena to, keeping enough blocks
+        // for typical requests to run without allocating
+        const size_t keep = std::max(block_ + 1, kRetainedBlocks);
+        if (blocks_.size() > keep) {
+            blocks_.resize(keep);
+        }
+    }
+    
+    Arena& thread_arena() {
+        thread_local Arena arena;
+        return arena;
+    }
+
+}
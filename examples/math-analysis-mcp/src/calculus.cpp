@@ -0,0 +1,473 @@
+#include "calculus.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace math_ops {
+    
+    namespace {
+        
+        // Signals shorter than this stay on the calling thread
+        constexpr size_t kParallelGrain = 1 << 18;
+        // Independent accumulators per reduction. The inner loops over them
+        // have a constant trip count and no cross-lane dependency, so the
+        // compiler keeps them in vector registers without reassociating.
+        constexpr size_t kLanes = 8;
+        
+        // Splits [0, n) into one chunk per thread, each a multiple of `align`
+        // long, and returns body(begin, end) for every chunk in order
+        template <typename T, typename Body>
+        std::vector<T> map_chunks(size_t n, size_t align, Body body) {
+            const size_t chunks = std::min(max_threads(), std::max<size_t>(1, n / kParallelGrain));
+            size_t chunk = (n + chunks - 1) / chunks;
+            chunk = (chunk + align - 1) / align * align;
+            
+            std::vector<T> partials(chunks);
+            parallel_for(chunks, 1, 1, [&](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; c++) {
+                    const size_t lo = std::min(n, c * chunk);
+                    partials[c] = body(lo, std::min(n, lo + chunk));
+                }
+            });
+            return partials;
+        }
+        
+        double lane_sum(const double* y, size_t begin, size_t end) {
+            double acc[kLanes] = {};
+            size_t i = begin;
+            for (; i + kLanes <= end; i += kLanes) {
+                for (size_t l = 0; l < kLanes; l++) {
+                    acc[l] += y[i + l];
+                }
+            }
+            double total = 0.0;
+            for (; i < end; i++) {
+                total += y[i];
+            }
+            for (size_t l = 0; l < kLanes; l++) {
+                total += acc[l];
+            }
+            return total;
+        }
+        
+        // Sums of the even- and odd-indexed samples in [begin, end); begin
+        // must be even so that lane l always sees indices of parity l % 2
+        struct ParitySums {
+            double even = 0.0;
+            double odd = 0.0;
+        };
+        
+        ParitySums parity_sums(const double* y, size_t begin, size_t end) {
+            double acc[kLanes] = {};
+            size_t i = begin;
+            for (; i + kLanes <= end; i += kLanes) {
+                for (size_t l = 0; l < kLanes; l++) {
+                    acc[l] += y[i + l];
+                }
+            }
+            ParitySums sums;
+            for (; i < end; i++) {
+                (i % 2 == 0 ? sums.even : sums.odd) += y[i];
+            }
+            for (size_t l = 0; l < kLanes; l += 2) {
+                sums.even += acc[l];
+                sums.odd += acc[l + 1];
+            }
+            return sums;
+        }
+        
+        // A partial integral over a non-uniform grid, with the smallest step
+        // seen so the grid can be validated in the same pass
+        struct GridSum {
+            double sum = 0.0;
+            double min_step = std::numeric_limits<double>::infinity();
+        };
+        
+        GridSum merge_partials(const std::vector<GridSum>& partials) {
+            GridSum total;
+            for (const auto& p : partials) {
+                total.sum += p.sum;
+                total.min_step = std::min(total.min_step, p.min_step);
+            }
+            return total;
+        }
+        
+        void check_grid(VectorView x, VectorView y, size_t min_points) {
+            if (x.size() != y.size()) {
+                throw std::runtime_error("x and y values must have the same length");
+            }
+            if (y.size() < min_points) {
+                throw std::runtime_error("Need at least " + std::to_string(min_points) + " points");
+            }
+        }
+        
+        void check_steps(double min_step) {
+            if (!(min_step > 0.0)) {
+                throw std::runtime_error("x values must be strictly increasing");
+            }
+        }
+        
+        // Trapezoids over intervals [begin, end) of a non-uniform grid
+        GridSum trapezoid_sum(const double* x, const double* y, size_t begin, size_t end) {
+            double acc[kLanes] = {};
+            double step[kLanes];
+            std::fill(step, step + kLanes, std::numeric_limits<double>::infinity());
+            size_t k = begin;
+            for (; k + kLanes <= end; k += kLanes) {
+                for (size_t l = 0; l < kLanes; l++) {
+                    const double dx = x[k + l + 1] - x[k + l];
+                    acc[l] += dx * (y[k + l] + y[k + l + 1]);
+                    step[l] = dx < step[l] ? dx : step[l];
+                }
+            }
+            GridSum result;
+            for (; k < end; k++) {
+                const double dx = x[k + 1] - x[k];
+                result.sum += dx * (y[k] + y[k + 1]);
+                result.min_step = std::min(result.min_step, dx);
+            }
+            for (size_t l = 0; l < kLanes; l++) {
+                result.sum += acc[l];
+                result.min_step = std::min(result.min_step, step[l]);
+            }
+            result.sum *= 0.5;
+            return result;
+        }
+        
+        // Integrals over [x0, x1] and [x1, x2] of the parabola through three
+        // samples with spacings h0 = x1 - x0 and h1 = x2 - x1
+        inline void parabola_parts(double h0, double h1, double y0, double y1, double y2,
+                                   double& first, double& second) {
+            const double span = h0 + h1;
+            first = (2.0 * h0 * h0 + 3.0 * h0 * h1) / (6.0 * span) * y0
+                  + (h0 * h0 + 3.0 * h0 * h1) / (6.0 * h1) * y1
+                  - h0 * h0 * h0 / (6.0 * h1 * span) * y2;
+            second = -h1 * h1 * h1 / (6.0 * h0 * span) * y0
+                   + (h1 * h1 + 3.0 * h0 * h1) / (6.0 * h0) * y1
+                   + (2.0 * h1 * h1 + 3.0 * h0 * h1) / (6.0 * span) * y2;
+        }
+        
+        // Cumulative integral built from pairs of intervals: parts(j, first,
+        // second) gives the integrals over intervals 2j and 2j + 1, and
+        // last() the final interval when their count is odd. Each chunk of
+        // pairs is summed once to find its starting offset, then scanned.
+        template <typename Parts, typename Last>
+        Vector cumulative_pairs(size_t n, bool nonuniform, Parts parts, Last last) {
+            const size_t pairs = (n - 1) / 2;
+            auto totals = map_chunks<GridSum>(pairs, 1, [&](size_t begin, size_t end) {
+                GridSum chunk;
+                for (size_t j = begin; j < end; j++) {
+                    double first, second;
+                    chunk.min_step = std::min(chunk.min_step, parts(j, first, second));
+                    chunk.sum += first + second;
+                }
+                return chunk;
+            });
+            if (nonuniform) {
+                check_steps(merge_partials(totals).min_step);
+            }
+            
+            std::vector<double> offsets(totals.size(), 0.0);
+            for (size_t c = 1; c < totals.size(); c++) {
+                offsets[c] = offsets[c - 1] + totals[c - 1].sum;
+            }
+            
+            Vector out(n);
+            out[0] = 0.0;
+            const size_t chunk = totals.empty() ? 0 : (pairs + totals.size() - 1) / totals.size();
+            parallel_for(totals.size(), 1, 1, [&](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; c++) {
+                    double running = offsets[c];
+                    const size_t lo = std::min(pairs, c * chunk);
+                    const size_t hi = std::min(pairs, lo + chunk);
+                    for (size_t j = lo; j < hi; j++) {
+                        double first, second;
+                        parts(j, first, second);
+                        out[2 * j + 1] = running + first;
+                        running += first + second;
+                        out[2 * j + 2] = running;
+                    }
+                }
+            });
+            if ((n - 1) % 2 == 1) {
+                double final_part;
+                const double step = last(final_part);
+                if (nonuniform) {
+                    check_steps(step);
+                }
+                out[n - 1] = out[n - 2] + final_part;
+            }
+            return out;
+        }
+        
+        // Antisymmetric weights of the central first-derivative stencils for
+        // offsets 1..r, and the one-sided stencils of the same order over
+        // offsets 0..2r, indexed by r - 1
+        constexpr double kCentral[3][3] = {
+            {1.0 / 2.0, 0.0, 0.0},
+            {2.0 / 3.0, -1.0 / 12.0, 0.0},
+            {3.0 / 4.0, -3.0 / 20.0, 1.0 / 60.0},
+        };
+        constexpr double kForward[3][7] = {
+            {-3.0 / 2.0, 2.0, -1.0 / 2.0},
+            {-25.0 / 12.0, 4.0, -3.0, 4.0 / 3.0, -1.0 / 4.0},
+            {-49.0 / 20.0, 6.0, -15.0 / 2.0, 20.0 / 3.0, -15.0 / 4.0, 6.0 / 5.0, -1.0 / 6.0},
+        };
+        
+        // The taps are written out so the loop over i is the only loop and
+        // vectorizes; __restrict rules out the output overlapping the input
+        template <size_t R>
+        void central_rows(const double* __restrict y, double* __restrict out, size_t begin, size_t end, double inv_h) {
+            const double c1 = kCentral[R - 1][0] * inv_h;
+            const double c2 = kCentral[R - 1][1] * inv_h;
+            const double c3 = kCentral[R - 1][2] * inv_h;
+            for (size_t i = begin; i < end; i++) {
+                double d = c1 * (y[i + 1] - y[i - 1]);
+                if constexpr (R >= 2) {
+                    d += c2 * (y[i + 2] - y[i - 2]);
+                }
+                if constexpr (R >= 3) {
+                    d += c3 * (y[i + 3] - y[i - 3]);
+                }
+                out[i] = d;
+            }
+        }
+        
+    }
+    
+    double integrate(VectorView y, double h, IntegrationRule rule) {
+        const size_t n = y.size();
+        if (n < 2) {
+            throw std::runtime_error("Need at least 2 points for integration");
+        }
+        
+        if (rule == IntegrationRule::Trapezoid || n == 2) {
+            double total = 0.0;
+            for (double part : map_chunks<double>(n, 1, [&](size_t begin, size_t end) {
+                     return lane_sum(y.data(), begin, end);
+                 })) {
+                total += part;
+            }
+            return h * (total - 0.5 * (y[0] + y[n - 1]));
+        }
+        
+        // Composite Simpson over the longest odd-length prefix: weights 1, 4,
+        // 2, ..., 4, 1 are 2 on even and 4 on odd indices less the two ends
+        const size_t m = n % 2 == 1 ? n : n - 1;
+        ParitySums sums;
+        for (const auto& part : map_chunks<ParitySums>(m, 2, [&](size_t begin, size_t end) {
+                 return parity_sums(y.data(), begin, end);
+             })) {
+            sums.even += part.even;
+            sums.odd += part.odd;
+        }
+        double result = h / 3.0 * (2.0 * sums.even + 4.0 * sums.odd - y[0] - y[m - 1]);
+        if (m < n) {
+            result += h / 12.0 * (-y[n - 3] + 8.0 * y[n - 2] + 5.0 * y[n - 1]);
+        }
+        return result;
+    }
+    
+    double integrate(VectorView x, VectorView y, IntegrationRule rule) {
+        check_grid(x, y, 2);
+        const size_t n = y.size();
+        
+        if (rule == IntegrationRule::Trapezoid || n == 2) {
+            GridSum total = merge_partials(map_chunks<GridSum>(n - 1, 1, [&](size_t begin, size_t end) {
+                return trapezoid_sum(x.data(), y.data(), begin, end);
+            }));
+            check_steps(total.min_step);
+            return total.sum;
+        }
+        
+        GridSum total = merge_partials(map_chunks<GridSum>((n - 1) / 2, 1, [&](size_t begin, size_t end) {
+            GridSum chunk;
+            for (size_t j = begin; j < end; j++) {
+                const size_t k = 2 * j;
+                const double h0 = x[k + 1] - x[k];
+                const double h1 = x[k + 2] - x[k + 1];
+                double first, second;
+                parabola_parts(h0, h1, y[k], y[k + 1], y[k + 2], first, second);
+                chunk.sum += first + second;
+                chunk.min_step = std::min(chunk.min_step, std::min(h0, h1));
+            }
+            return chunk;
+        }));
+        if ((n - 1) % 2 == 1) {
+            const double h0 = x[n - 2] - x[n - 3];
+            const double h1 = x[n - 1] - x[n - 2];
+            double first, second;
+            parabola_parts(h0, h1, y[n - 3], y[n - 2], y[n - 1], first, second);
+            total.sum += second;
+            total.min_step = std::min(total.min_step, h1);
+        }
+        check_steps(total.min_step);
+        return total.sum;
+    }
+    
+    Vector cumulative_integral(VectorView y, double h, IntegrationRule rule) {
+        const size_t n = y.size();
+        if (n < 2) {
+            throw std::runtime_error("Need at least 2 points for integration");
+        }
+        const double* v = y.data();
+        
+        if (rule == IntegrationRule::Trapezoid || n == 2) {
+            const double half = 0.5 * h;
+            return cumulative_pairs(n, false,
+                [=](size_t j, double& first, double& second) {
+                    first = half * (v[2 * j] + v[2 * j + 1]);
+                    second = half * (v[2 * j + 1] + v[2 * j + 2]);
+                    return h;
+                },
+                [=](double& part) {
+                    part = half * (v[n - 2] + v[n - 1]);
+                    return h;
+                });
+        }
+        
+        // The uniform-grid parabola_parts: h/12 (5, 8, -1) and its mirror
+        const double w = h / 12.0;
+        return cumulative_pairs(n, false,
+            [=](size_t j, double& first, double& second) {
+                const double y0 = v[2 * j], y1 = v[2 * j + 1], y2 = v[2 * j + 2];
+                first = w * (5.0 * y0 + 8.0 * y1 - y2);
+                second = w * (-y0 + 8.0 * y1 + 5.0 * y2);
+                return h;
+            },
+            [=](double& part) {
+                part = w * (-v[n - 3] + 8.0 * v[n - 2] + 5.0 * v[n - 1]);
+                return h;
+            });
+    }
+    
+    Vector cumulative_integral(VectorView x, VectorView y, IntegrationRule rule) {
+        check_grid(x, y, 2);
+        const size_t n = y.size();
+        const double* xs = x.data();
+        const double* v = y.data();
+        
+        if (rule == IntegrationRule::Trapezoid || n == 2) {
+            return cumulative_pairs(n, true,
+                [=](size_t j, double& first, double& second) {
+                    const size_t k = 2 * j;
+                    const double h0 = xs[k + 1] - xs[k];
+                    const double h1 = xs[k + 2] - xs[k + 1];
+                    first = 0.5 * h0 * (v[k] + v[k + 1]);
+                    second = 0.5 * h1 * (v[k + 1] + v[k + 2]);
+                    return std::min(h0, h1);
+                },
+                [=](double& part) {
+                    const double h1 = xs[n - 1] - xs[n - 2];
+                    part = 0.5 * h1 * (v[n - 2] + v[n - 1]);
+                    return h1;
+                });
+        }
+        
+        return cumulative_pairs(n, true,
+            [=](size_t j, double& first, double& second) {
+                const size_t k = 2 * j;
+                const double h0 = xs[k + 1] - xs[k];
+                const double h1 = xs[k + 2] - xs[k + 1];
+                parabola_parts(h0, h1, v[k], v[k + 1], v[k + 2], first, second);
+                return std::min(h0, h1);
+            },
+            [=](double& part) {
+                const double h0 = xs[n - 2] - xs[n - 3];
+                const double h1 = xs[n - 1] - xs[n - 2];
+                double first;
+                parabola_parts(h0, h1, v[n - 3], v[n - 2], v[n - 1], first, part);
+                return h1;
+            });
+    }
+    
+    Vector differentiate(VectorView y, double h, int accuracy) {
+        if (accuracy != 2 && accuracy != 4 && accuracy != 6) {
+            throw std::runtime_error("Differentiation accuracy must be 2, 4 or 6");
+        }
+        const size_t n = y.size();
+        const size_t r = static_cast<size_t>(accuracy / 2);
+        if (n < static_cast<size_t>(accuracy) + 1) {
+            throw std::runtime_error("Need at least " + std::to_string(accuracy + 1) +
+                                     " points for differentiation of accuracy " + std::to_string(accuracy));
+        }
+        
+        Vector out(n);
+        const double inv_h = 1.0 / h;
+        const double* v = y.data();
+        parallel_for(n - 2 * r, kParallelGrain, 1, [&](size_t begin, size_t end) {
+            switch (r) {
+                case 1: central_rows<1>(v, out.data(), begin + r, end + r, inv_h); break;
+                case 2: central_rows<2>(v, out.data(), begin + r, end + r, inv_h); break;
+                default: central_rows<3>(v, out.data(), begin + r, end + r, inv_h); break;
+            }
+        });
+        
+        // The first and last r points use the one-sided stencil starting at
+        // them, mirrored with the sign flipped at the far end
+        const double* f = kForward[r - 1];
+        for (size_t i = 0; i < r; i++) {
+            double front = 0.0, back = 0.0;
+            for (size_t k = 0; k <= 2 * r; k++) {
+                front += f[k] * v[i + k];
+                back -= f[k] * v[n - 1 - i - k];
+            }
+            out[i] = front * inv_h;
+            out[n - 1 - i] = back * inv_h;
+        }
+        return out;
+    }
+    
+    Vector differentiate(VectorView x, VectorView y) {
+        check_grid(x, y, 2);
+        const size_t n = y.size();
+        Vector out(n);
+        if (n == 2) {
+            const double dx = x[1] - x[0];
+            check_steps(dx);
+            out[0] = out[1] = (y[1] - y[0]) / dx;
+            return out;
+        }
+        
+        // Three-point differences through x[i-1], x[i], x[i+1], as in
+        // numpy.gradient: one division per point
+        const double* xs = x.data();
+        const double* v = y.data();
+        auto steps = map_chunks<double>(n - 2, 1, [&](size_t begin, size_t end) {
+            double min_step = std::numeric_limits<double>::infinity();
+            for (size_t i = begin + 1; i < end + 1; i++) {
+                const double h0 = xs[i] - xs[i - 1];
+                const double h1 = xs[i + 1] - xs[i];
+                out[i] = (h0 * h0 * v[i + 1] + (h1 * h1 - h0 * h0) * v[i] - h1 * h1 * v[i - 1]) /
+                         (h0 * h1 * (h0 + h1));
+                min_step = h0 < min_step ? h0 : min_step;
+            }
+            return min_step;
+        });
+        double min_step = xs[n - 1] - xs[n - 2];
+        for (double step : steps) {
+            min_step = std::min(min_step, step);
+        }
+        check_steps(min_step);
+        
+        // One-sided second-order differences at the ends
+        {
+            const double h0 = xs[1] - xs[0];
+            const double h1 = xs[2] - xs[1];
+            out[0] = -(2.0 * h0 + h1) / (h0 * (h0 + h1)) * v[0]
+                   + (h0 + h1) / (h0 * h1) * v[1]
+                   - h0 / (h1 * (h0 + h1)) * v[2];
+        }
+        {
+            const double h0 = xs[n - 2] - xs[n - 3];
+            const double h1 = xs[n - 1] - xs[n - 2];
+            out[n - 1] = h1 / (h0 * (h0 + h1)) * v[n - 3]
+                       - (h0 + h1) / (h0 * h1) * v[n - 2]
+                       + (2.0 * h1 + h0) / (h1 * (h0 + h1)) * v[n - 1];
+        }
+        return out;
+    }
+
+}
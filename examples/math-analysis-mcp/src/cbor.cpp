@@ -0,0 +1,402 @@
+#include "cbor.hpp"
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace cbor {
+    
+    namespace {
+        
+        constexpr bool kHostLittleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+        constexpr int kMaxDepth = 512;
+        
+        enum Major : unsigned char {
+            kUnsigned = 0, kNegative = 1, kBytes = 2, kText = 3,
+            kArray = 4, kMap = 5, kTag = 6, kSimple = 7
+        };
+        
+        // RFC 8746 typed array tags for IEEE floats
+        constexpr uint64_t kTagFloat32BE = 81;
+        constexpr uint64_t kTagFloat64BE = 82;
+        constexpr uint64_t kTagFloat32LE = 85;
+        constexpr uint64_t kTagFloat64LE = 86;
+        
+        void write_head(std::string& out, unsigned char major, uint64_t arg) {
+            const unsigned char m = major << 5;
+            if (arg < 24) {
+                out += static_cast<char>(m | arg);
+                return;
+            }
+            
+            int bytes;
+            if (arg <= 0xff) {
+                out += static_cast<char>(m | 24);
+                bytes = 1;
+            } else if (arg <= 0xffff) {
+                out += static_cast<char>(m | 25);
+                bytes = 2;
+            } else if (arg <= 0xffffffffULL) {
+                out += static_cast<char>(m | 26);
+                bytes = 4;
+            } else {
+                out += static_cast<char>(m | 27);
+                bytes = 8;
+            }
+            for (int i = bytes - 1; i >= 0; i--) {
+                out += static_cast<char>((arg >> (8 * i)) & 0xff);
+            }
+        }
+        
+        void write_double(std::string& out, double v) {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            out += static_cast<char>(0xfb);
+            for (int i = 7; i >= 0; i--) {
+                out += static_cast<char>((bits >> (8 * i)) & 0xff);
+            }
+        }
+        
+        void write_value(const json::Value& value, std::string& out) {
+            if (value.is_null()) {
+                out += static_cast<char>(0xf6);
+            } else if (value.is_bool()) {
+                out += static_cast<char>(value.as_bool() ? 0xf5 : 0xf4);
+            } else if (value.is_int()) {
+                int v = value.as_int();
+                if (v >= 0) {
+                    write_head(out, kUnsigned, static_cast<uint64_t>(v));
+                } else {
+                    write_head(out, kNegative, static_cast<uint64_t>(-(static_cast<int64_t>(v) + 1)));
+                }
+            } else if (value.is_double()) {
+                write_double(out, value.as_double());
+            } else if (value.is_string()) {
+                const auto& s = value.as_string();
+                write_head(out, kText, s.size());
+                out.append(s);
+            } else if (value.is_number_array()) {
+                const auto& values = value.as_number_array();
+                write_head(out, kTag, kTagFloat64LE);
+                write_head(out, kBytes, values.size() * sizeof(double));
+                const size_t start = out.size();
+                out.resize(start + values.size() * sizeof(double));
+                char* dst = &out[start];
+                if (kHostLittleEndian) {
+                    std::memcpy(dst, values.data(), values.size() * sizeof(double));
+                } else {
+                    for (double v : values) {
+                        uint64_t bits;
+                        std::memcpy(&bits, &v, sizeof(bits));
+                        for (int i = 0; i < 8; i++) *dst++ = static_cast<char>((bits >> (8 * i)) & 0xff);
+                    }
+                }
+            } else if (value.is_array()) {
+                const auto& items = value.as_array();
+                write_head(out, kArray, items.size());
+                for (const auto& item : items) {
+                    write_value(item, out);
+                }
+            } else if (value.is_object()) {
+                const auto& obj = value.as_object();
+                write_head(out, kMap, obj.size());
+                for (const auto& [key, item] : obj) {
+                    write_head(out, kText, key.size());
+                    out.append(key);
+                    write_value(item, out);
+                }
+            } else {
+                // Pre-serialized JSON has no CBOR form: send it as text when
+                // it was meant as a string, otherwise re-encode its contents
+                const auto& raw = value.as_raw();
+                if (raw.as_string) {
+                    write_head(out, kText, raw.text->size());
+                    out.append(*raw.text);
+                } else {
+                    write_value(json::parse(*raw.text), out);
+                }
+            }
+        }
+        
+        double half_to_double(uint16_t h) {
+            int exponent = (h >> 10) & 0x1f;
+            int mantissa = h & 0x3ff;
+            double v;
+            if (exponent == 0) {
+                v = std::ldexp(mantissa, -24);
+            } else if (exponent == 31) {
+                v = mantissa == 0 ? INFINITY : NAN;
+            } else {
+                v = std::ldexp(mantissa + 1024, exponent - 25);
+            }
+            return (h & 0x8000) ? -v : v;
+        }
+        
+        class Decoder {
+        public:
+            explicit Decoder(std::string_view data)
+                : cur_(reinterpret_cast<const unsigned char*>(data.data())), end_(cur_ + data.size()) {}
+            
+            json::Value parse() {
+                json::Value value = parse_value(0);
+                if (cur_ != end_) {
+                    throw std::runtime_error("Unexpected data after CBOR value");
+                }
+                return value;
+            }
+            
+        private:
+            const unsigned char* cur_;
+            const unsigned char* end_;
+            
+            void need(uint64_t n) {
+                if (static_cast<uint64_t>(end_ - cur_) < n) {
+                    throw std::runtime_error("Truncated CBOR data");
+                }
+            }
+            
+            uint64_t read_uint(int bytes) {
+                need(bytes);
+                uint64_t v = 0;
+                for (int i = 0; i < bytes; i++) {
+                    v = (v << 8) | *cur_++;
+                }
+                return v;
+            }
+            
+            // Argument of a data item head; `indefinite` is set for additional info 31
+            uint64_t read_argument(unsigned char info, bool* indefinite = nullptr) {
+                if (info < 24) return info;
+                if (info == 24) return read_uint(1);
+                if (info == 25) return read_uint(2);
+                if (info == 26) return read_uint(4);
+                if (info == 27) return read_uint(8);
+                if (info == 31 && indefinite) {
+                    *indefinite = true;
+                    return 0;
+                }
+                throw std::runtime_error("Invalid CBOR additional information");
+            }
+            
+            bool at_break() {
+                need(1);
+                if (*cur_ == 0xff) {
+                    cur_++;
+                    return true;
+                }
+                return false;
+            }
+            
+            // Byte or text string, joining the chunks of an indefinite-length one
+            std::string read_string(unsigned char major, unsigned char info) {
+                bool indefinite = false;
+                uint64_t len = read_argument(info, &indefinite);
+                if (!indefinite) {
+                    need(len);
+                    std::string s(reinterpret_cast<const char*>(cur_), len);
+                    cur_ += len;
+                    return s;
+                }
+                
+                std::string s;
+                while (!at_break()) {
+                    unsigned char head = *cur_++;
+                    if ((head >> 5) != major || (head & 0x1f) == 31) {
+                        throw std::runtime_error("Invalid chunk in indefinite-length CBOR string");
+                    }
+                    s += read_string(major, head & 0x1f);
+                }
+                return s;
+            }
+            
+            json::Value integer(uint64_t magnitude, bool negative) {
+                if (!negative) {
+                    if (magnitude <= INT_MAX) return json::Value(static_cast<int>(magnitude));
+                    return json::Value(static_cast<double>(magnitude));
+                }
+                if (magnitude <= static_cast<uint64_t>(INT_MAX)) {
+                    return json::Value(static_cast<int>(-1 - static_cast<int64_t>(magnitude)));
+                }
+                return json::Value(-1.0 - static_cast<double>(magnitude));
+            }
+            
+            json::Value typed_float_array(uint64_t tag, const unsigned char* data, size_t size) {
+                const size_t width = (tag == kTagFloat64LE || tag == kTagFloat64BE) ? 8 : 4;
+                const bool little = tag == kTagFloat64LE || tag == kTagFloat32LE;
+                if (size % width != 0) {
+                    throw std::runtime_error("CBOR typed array length is not a multiple of its element size");
+                }
+                
+                json::NumberArray values(size / width);
+                if (width == 8 && little == kHostLittleEndian) {
+                    std::memcpy(values.data(), data, size);
+                    return json::Value(std::move(values));
+                }
+                
+                const unsigned char* p = data;
+                for (size_t i = 0; i < values.size(); i++, p += width) {
+                    uint64_t bits = 0;
+                    for (size_t b = 0; b < width; b++) {
+                        size_t shift = little ? b : width - 1 - b;
+                        bits |= static_cast<uint64_t>(p[b]) << (8 * shift);
+                    }
+                    if (width == 8) {
+                        std::memcpy(&values[i], &bits, 8);
+                    } else {
+                        uint32_t bits32 = static_cast<uint32_t>(bits);
+                        float f;
+                        std::memcpy(&f, &bits32, 4);
+                        values[i] = f;
+                    }
+                }
+                return json::Value(std::move(values));
+            }
+            
+            json::Value parse_array(unsigned char info, int depth) {
+                bool indefinite = false;
+                uint64_t len = read_argument(info, &indefinite);
+                
+                json::Array items;
+                if (!indefinite) {
+                    // Every item takes at least one byte, which bounds the reservation
+                    need(len);
+                    items.reserve(len);
+                    for (uint64_t i = 0; i < len; i++) {
+                        items.push_back(parse_value(depth + 1));
+                    }
+                } else {
+                    while (!at_break()) {
+                        items.push_back(parse_value(depth + 1));
+                    }
+                }
+                
+                bool numeric = !items.empty();
+                for (const auto& item : items) {
+                    if (!item.is_int() && !item.is_double()) {
+                        numeric = false;
+                        break;
+                    }
+                }
+                if (!numeric) {
+                    return json::Value(std::move(items));
+                }
+                
+                json::NumberArray values;
+                values.reserve(items.size());
+                for (const auto& item : items) {
+                    values.push_back(item.is_int() ? item.as_int() : item.as_double());
+                }
+                return json::Value(std::move(values));
+            }
+            
+            json::Value parse_map(unsigned char info, int depth) {
+                bool indefinite = false;
+                uint64_t len = read_argument(info, &indefinite);
+                
+                json::Object obj;
+                for (uint64_t i = 0; indefinite ? !at_break() : i < len; i++) {
+                    need(1);
+                    unsigned char head = *cur_++;
+                    if ((head >> 5) != kText) {
+                        throw std::runtime_error("CBOR map keys must be text strings");
+                    }
+                    std::string key = read_string(kText, head & 0x1f);
+                    obj[std::move(key)] = parse_value(depth + 1);
+                }
+                return json::Value(std::move(obj));
+            }
+            
+            json::Value parse_value(int depth) {
+                if (depth > kMaxDepth) {
+                    throw std::runtime_error("CBOR nesting too deep");
+                }
+                need(1);
+                const unsigned char head = *cur_++;
+                const unsigned char major = head >> 5;
+                const unsigned char info = head & 0x1f;
+                
+                switch (major) {
+                    case kUnsigned:
+                        return integer(read_argument(info), false);
+                    case kNegative:
+                        return integer(read_argument(info), true);
+                    case kBytes:
+                    case kText:
+                        return json::Value(read_string(major, info));
+                    case kArray:
+                        return parse_array(info, depth);
+                    case kMap:
+                        return parse_map(info, depth);
+                    case kTag: {
+                        uint64_t tag = read_argument(info);
+                        if (tag == kTagFloat64LE || tag == kTagFloat64BE ||
+                            tag == kTagFloat32LE || tag == kTagFloat32BE) {
+                            need(1);
+                            unsigned char inner = *cur_++;
+                            if ((inner >> 5) != kBytes) {
+                                throw std::runtime_error("CBOR typed array must wrap a byte string");
+                            }
+                            if ((inner & 0x1f) == 31) {
+                                std::string bytes = read_string(kBytes, 31);
+                                return typed_float_array(tag, reinterpret_cast<const unsigned char*>(bytes.data()),
+                                                         bytes.size());
+                            }
+                            // Definite length: convert straight out of the input buffer
+                            uint64_t len = read_argument(inner & 0x1f);
+                            need(len);
+                            const unsigned char* data = cur_;
+                            cur_ += len;
+                            return typed_float_array(tag, data, len);
+                        }
+                        // Other tags carry no meaning for JSON; keep the content
+                        return parse_value(depth + 1);
+                    }
+                    default:
+                        break;
+                }
+                
+                switch (info) {
+                    case 20: return json::Value(false);
+                    case 21: return json::Value(true);
+                    case 22:
+                    case 23: return json::Value();
+                    case 25: return json::Value(half_to_double(static_cast<uint16_t>(read_uint(2))));
+                    case 26: {
+                        uint32_t bits = static_cast<uint32_t>(read_uint(4));
+                        float f;
+                        std::memcpy(&f, &bits, 4);
+                        return json::Value(static_cast<double>(f));
+                    }
+                    case 27: {
+                        uint64_t bits = read_uint(8);
+                        double d;
+                        std::memcpy(&d, &bits, 8);
+                        return json::Value(d);
+                    }
+                    default:
+                        throw std::runtime_error("Unsupported CBOR simple value");
+                }
+            }
+        };
+    }
+    
+    void encode(const json::Value& value, std::string& out) {
+        write_value(value, out);
+    }
+    
+    std::string encode(const json::Value& value) {
+        std::string out;
+        write_value(value, out);
+        return out;
+    }
+    
+    json::Value decode(std::string_view data) {
+        return Decoder(data).parse();
+    }
+    
+    void encode_array_head(size_t count, std::string& out) {
+        write_head(out, kArray, count);
+    }
+    
+}
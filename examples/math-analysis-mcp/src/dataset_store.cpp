@@ -0,0 +1,175 @@
+#include "dataset_store.hpp"
+#include "file_input.hpp"
+#include <stdexcept>
+
+namespace math_ops {
+    
+    json::Value Dataset::shape() const {
+        if (is_matrix) {
+            return json::Value(json::Array{(int)rows, (int)cols});
+        }
+        return json::Value(json::Array{(int)cols});
+    }
+    
+    namespace {
+        
+        Dataset owned_dataset(Vector values) {
+            auto owner = std::make_shared<const Vector>(std::move(values));
+            Dataset data;
+            data.values = owner->data();
+            data.cols = owner->size();
+            data.owner = std::move(owner);
+            return data;
+        }
+        
+        // Values of a parsed number array, used in place for the current call
+        Dataset borrowed_dataset(const json::NumberArray& values) {
+            Dataset data;
+            data.values = values.data();
+            data.cols = values.size();
+            return data;
+        }
+        
+        Dataset owned_dataset(Matrix values) {
+            auto owner = std::make_shared<const Matrix>(std::move(values));
+            Dataset data;
+            data.values = owner->data();
+            data.rows = owner->rows();
+            data.cols = owner->cols();
+            data.is_matrix = true;
+            data.owner = std::move(owner);
+            return data;
+        }
+        
+        size_t resident_bytes(const Dataset& data) {
+            return data.mapped ? 0 : data.bytes();
+        }
+        
+        json::Value describe_dataset(const std::string& handle, const Dataset& data) {
+            json::Value result;
+            result["handle"] = handle;
+            result["shape"] = data.shape();
+            result["bytes"] = static_cast<double>(data.bytes());
+            if (data.mapped) {
+                result["mapped"] = true;
+            }
+            return result;
+        }
+    }
+    
+    DatasetStore::DatasetStore(size_t memory_limit_bytes) : memory_limit_(memory_limit_bytes) {}
+    
+    std::string DatasetStore::put(Vector values) {
+        return put(owned_dataset(std::move(values)));
+    }
+    
+    std::string DatasetStore::put(Matrix values) {
+        return put(owned_dataset(std::move(values)));
+    }
+    
+    std::string DatasetStore::put(Dataset data) {
+        if (!data.owner) {
+            // a borrowed view dies with its request, so the store keeps a copy
+            data = data.is_matrix ? owned_dataset(Matrix::from_view(data.matrix()))
+                                  : owned_dataset(Vector(data.values, data.values + data.cols));
+        }
+        const size_t bytes = resident_bytes(data);
+        if (bytes > memory_limit_) {
+            throw std::runtime_error("Dataset of " + std::to_string(bytes) +
+                                     " bytes exceeds the dataset memory limit of " +
+                                     std::to_string(memory_limit_) + " bytes");
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (bytes_used_ + bytes > memory_limit_ && !lru_.empty()) {
+            bytes_used_ -= resident_bytes(lru_.back().data);
+            index_.erase(lru_.back().handle);
+            lru_.pop_back();
+        }
+        
+        std::string handle = "ds-" + std::to_string(next_id_++);
+        lru_.push_front(Entry{handle, std::move(data)});
+        index_[handle] = lru_.begin();
+        bytes_used_ += bytes;
+        return handle;
+    }
+    
+    // Caller holds mutex_; moves the entry to the front of the LRU list
+    std::list<DatasetStore::Entry>::iterator DatasetStore::find(const std::string& handle) {
+        auto it = index_.find(handle);
+        if (it == index_.end()) {
+            throw std::runtime_error("Unknown or evicted dataset handle '" + handle + "'");
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second;
+    }
+    
+    Dataset DatasetStore::get(const std::string& handle) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return find(handle)->data;
+    }
+    
+    bool DatasetStore::release(const std::string& handle) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(handle);
+        if (it == index_.end()) {
+            return false;
+        }
+        bytes_used_ -= resident_bytes(it->second->data);
+        lru_.erase(it->second);
+        index_.erase(it);
+        return true;
+    }
+    
+    Dataset DatasetStore::resolve_vector(const json::Value& arg) {
+        Dataset data;
+        if (arg.is_string()) {
+            data = get(arg.as_string());
+        } else if (is_file_spec(arg)) {
+            data = read_array_file(arg);
+        } else if (arg.is_number_array()) {
+            return borrowed_dataset(arg.as_number_array());
+        } else {
+            return owned_dataset(json_to_vector(arg));
+        }
+        if (data.is_matrix) {
+            throw std::runtime_error("Expected a vector but got a " + std::to_string(data.rows) + "x" +
+                                     std::to_string(data.cols) + " matrix");
+        }
+        return data;
+    }
+    
+    Dataset DatasetStore::resolve_matrix(const json::Value& arg) {
+        Dataset data;
+        if (arg.is_string()) {
+            data = get(arg.as_string());
+        } else if (is_file_spec(arg)) {
+            data = read_array_file(arg);
+        } else {
+            return owned_dataset(json_to_matrix(arg));
+        }
+        if (!data.is_matrix) {
+            throw std::runtime_error("Expected a matrix but got a vector of length " + std::to_string(data.cols));
+        }
+        return data;
+    }
+    
+    json::Value DatasetStore::describe(const std::string& handle) {
+        return describe_dataset(handle, get(handle));
+    }
+    
+    json::Value DatasetStore::list() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        json::Array datasets;
+        for (const auto& entry : lru_) {
+            datasets.push_back(describe_dataset(entry.handle, entry.data));
+        }
+        
+        json::Value result;
+        result["datasets"] = json::Value(std::move(datasets));
+        result["bytes_used"] = static_cast<double>(bytes_used_);
+        result["memory_limit"] = static_cast<double>(memory_limit_);
+        return result;
+    }
+    
+}
@@ -0,0 +1,385 @@
+#include "file_input.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef MATH_MCP_HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+namespace math_ops {
+    
+    namespace {
+        
+        // Element type of an on-disk array: kind 'f', 'i' or 'u', width in bytes
+        struct DType {
+            char kind;
+            size_t size;
+            bool big_endian;
+        };
+        
+        constexpr bool kHostBigEndian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+        
+        // Accepts names ("float64", "int32") and NumPy descriptors ("<f8", ">i4", "|u1")
+        DType parse_dtype(const std::string& name) {
+            static const std::pair<const char*, DType> named[] = {
+                {"float64", {'f', 8, kHostBigEndian}}, {"float32", {'f', 4, kHostBigEndian}},
+                {"int64", {'i', 8, kHostBigEndian}},   {"int32", {'i', 4, kHostBigEndian}},
+                {"int16", {'i', 2, kHostBigEndian}},   {"int8", {'i', 1, kHostBigEndian}},
+                {"uint64", {'u', 8, kHostBigEndian}},  {"uint32", {'u', 4, kHostBigEndian}},
+                {"uint16", {'u', 2, kHostBigEndian}},  {"uint8", {'u', 1, kHostBigEndian}},
+            };
+            for (const auto& [key, type] : named) {
+                if (name == key) return type;
+            }
+            
+            std::string code = name;
+            bool big_endian = kHostBigEndian;
+            if (!code.empty() && (code[0] == '<' || code[0] == '>' || code[0] == '=' || code[0] == '|')) {
+                if (code[0] == '<') big_endian = false;
+                if (code[0] == '>') big_endian = true;
+                code = code.substr(1);
+            }
+            if (code.size() == 2 && std::strchr("fiu", code[0]) && std::strchr("1248", code[1])) {
+                DType type{code[0], static_cast<size_t>(code[1] - '0'), big_endian};
+                if (type.kind != 'f' || type.size >= 4) return type;
+            }
+            throw std::runtime_error("Unsupported dtype '" + name + "'");
+        }
+        
+        double load_element(const unsigned char* p, const DType& type) {
+            unsigned char bytes[8];
+            std::memcpy(bytes, p, type.size);
+            if (type.big_endian != kHostBigEndian) {
+                for (size_t i = 0; i < type.size / 2; i++) {
+                    std::swap(bytes[i], bytes[type.size - 1 - i]);
+                }
+            }
+            
+            switch (type.kind) {
+                case 'f':
+                    if (type.size == 8) { double v; std::memcpy(&v, bytes, 8); return v; }
+                    { float v; std::memcpy(&v, bytes, 4); return v; }
+                case 'i':
+                    if (type.size == 8) { int64_t v; std::memcpy(&v, bytes, 8); return static_cast<double>(v); }
+                    if (type.size == 4) { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+                    if (type.size == 2) { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+                    { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+                default:
+                    if (type.size == 8) { uint64_t v; std::memcpy(&v, bytes, 8); return static_cast<double>(v); }
+                    if (type.size == 4) { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+                    if (type.size == 2) { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+                    return bytes[0];
+            }
+        }
+        
+        // Read-only private mapping of a whole file, unmapped with its last owner
+        struct Mapping {
+            const unsigned char* data = nullptr;
+            size_t size = 0;
+            
+            ~Mapping() {
+                if (data) munmap(const_cast<unsigned char*>(data), size);
+            }
+        };
+        
+        std::shared_ptr<const Mapping> map_file(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Cannot open '" + path + "': " + std::strerror(errno));
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                close(fd);
+                throw std::runtime_error("Cannot map '" + path + "': empty or unreadable file");
+            }
+            
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            int saved_errno = errno;
+            close(fd);
+            if (addr == MAP_FAILED) {
+                throw std::runtime_error("Cannot map '" + path + "': " + std::strerror(saved_errno));
+            }
+            madvise(addr, st.st_size, MADV_SEQUENTIAL);
+            
+            auto mapping = std::make_shared<Mapping>();
+            mapping->data = static_cast<const unsigned char*>(addr);
+            mapping->size = st.st_size;
+            return mapping;
+        }
+        
+        size_t size_argument(const json::Object& obj, const char* key, size_t fallback) {
+            auto it = obj.find(key);
+            if (it == obj.end()) return fallback;
+            double v = it->second.is_int() ? it->second.as_int() : it->second.is_double() ? it->second.as_double() : -1.0;
+            if (v < 0 || v != std::floor(v)) {
+                throw std::runtime_error(std::string("'") + key + "' must be a non-negative integer");
+            }
+            return static_cast<size_t>(v);
+        }
+        
+        std::vector<size_t> shape_argument(const json::Value& value, const char* key) {
+            std::vector<size_t> shape;
+            for (double d : json_to_vector(value)) {
+                if (d < 0 || d != std::floor(d)) {
+                    throw std::runtime_error(std::string("'") + key + "' entries must be non-negative integers");
+                }
+                shape.push_back(static_cast<size_t>(d));
+            }
+            return shape;
+        }
+        
+        // Fills the row/column layout of a dataset from a shape of up to two
+        // dimensions; unit dimensions beyond the last two are dropped. Shapes
+        // whose element count, or its size in element_size-byte elements,
+        // does not fit in size_t are rejected before anything is allocated.
+        void apply_shape(Dataset& data, std::vector<size_t> shape, size_t element_size) {
+            while (shape.size() > 2 && shape.front() == 1) {
+                shape.erase(shape.begin());
+            }
+            if (shape.empty()) shape.push_back(1);
+            if (shape.size() > 2) {
+                throw std::runtime_error("Only 1-D and 2-D arrays are supported");
+            }
+            const size_t rows = shape.size() == 2 ? shape[0] : 1;
+            const size_t cols = shape.back();
+            if ((rows != 0 && cols > SIZE_MAX / rows) || rows * cols > SIZE_MAX / element_size) {
+                throw std::runtime_error("Shape [" + std::to_string(rows) + ", " + std::to_string(cols) +
+                                         "] is too large");
+            }
+            data.is_matrix = shape.size() == 2;
+            data.rows = rows;
+            data.cols = cols;
+        }
+        
+        // Uses mapped bytes in place when they already are native doubles,
+        // otherwise converts (and for Fortran order, transposes) into a buffer
+        Dataset dataset_from_mapping(std::shared_ptr<const Mapping> mapping, const std::string& path, size_t offset,
+                                     const DType& type, const std::vector<size_t>& shape, bool fortran_order) {
+            Dataset data;
+            apply_shape(data, shape, type.size);
+            const size_t count = data.rows * data.cols;
+            if (offset > mapping->size || count > (mapping->size - offset) / type.size) {
+                throw std::runtime_error("'" + path + "' is too small for the requested shape and offset");
+            }
+            
+            const unsigned char* base = mapping->data + offset;
+            if (type.kind == 'f' && type.size == 8 && type.big_endian == kHostBigEndian &&
+                offset % alignof(double) == 0 && (!fortran_order || !data.is_matrix)) {
+                data.values = reinterpret_cast<const double*>(base);
+                data.owner = std::move(mapping);
+                data.mapped = true;
+                return data;
+            }
+            
+            auto buffer = std::make_shared<Vector>(count);
+            double* out = buffer->data();
+            if (fortran_order && data.is_matrix) {
+                for (size_t j = 0; j < data.cols; j++) {
+                    for (size_t i = 0; i < data.rows; i++) {
+                        out[i * data.cols + j] = load_element(base + (j * data.rows + i) * type.size, type);
+                    }
+                }
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    out[i] = load_element(base + i * type.size, type);
+                }
+            }
+            data.values = buffer->data();
+            data.owner = std::move(buffer);
+            return data;
+        }
+        
+        Dataset read_raw(const std::string& path, const json::Object& spec) {
+            auto mapping = map_file(path);
+            DType type = parse_dtype(spec.count("dtype") && spec.at("dtype").is_string()
+                                     ? spec.at("dtype").as_string() : "float64");
+            size_t offset = size_argument(spec, "offset", 0);
+            
+            std::vector<size_t> shape;
+            if (spec.count("shape")) {
+                shape = shape_argument(spec.at("shape"), "shape");
+            } else {
+                if (offset > mapping->size) {
+                    throw std::runtime_error("Offset is past the end of '" + path + "'");
+                }
+                shape.push_back((mapping->size - offset) / type.size);
+            }
+            return dataset_from_mapping(std::move(mapping), path, offset, type, shape, false);
+        }
+        
+        // Value text following 'key': in the .npy header dictionary
+        std::string npy_field(const std::string& header, const std::string& key) {
+            size_t pos = header.find("'" + key + "'");
+            if (pos == std::string::npos) {
+                throw std::runtime_error("Malformed .npy header: missing '" + key + "'");
+            }
+            pos = header.find(':', pos);
+            size_t start = header.find_first_not_of(' ', pos + 1);
+            if (pos == std::string::npos || start == std::string::npos) {
+                throw std::runtime_error("Malformed .npy header");
+            }
+            
+            size_t end;
+            if (header[start] == '\'') {
+                end = header.find('\'', start + 1);
+                return header.substr(start + 1, end - start - 1);
+            }
+            if (header[start] == '(') {
+                end = header.find(')', start);
+                return header.substr(start + 1, end - start - 1);
+            }
+            end = header.find_first_of(",}", start);
+            return header.substr(start, end - start);
+        }
+        
+        Dataset read_npy(const std::string& path) {
+            auto mapping = map_file(path);
+            const unsigned char* p = mapping->data;
+            if (mapping->size < 10 || std::memcmp(p, "\x93NUMPY", 6) != 0) {
+                throw std::runtime_error("'" + path + "' is not a .npy file");
+            }
+            
+            size_t header_len;
+            size_t header_start;
+            if (p[6] == 1) {
+                header_len = p[8] | (p[9] << 8);
+                header_start = 10;
+            } else {
+                if (mapping->size < 12) throw std::runtime_error("Truncated .npy header");
+                header_len = p[8] | (p[9] << 8) | (p[10] << 16) | (static_cast<size_t>(p[11]) << 24);
+                header_start = 12;
+            }
+            if (header_start + header_len > mapping->size) {
+                throw std::runtime_error("Truncated .npy header");
+            }
+            std::string header(reinterpret_cast<const char*>(p + header_start), header_len);
+            
+            DType type = parse_dtype(npy_field(header, "descr"));
+            bool fortran_order = npy_field(header, "fortran_order").find("True") != std::string::npos;
+            
+            std::vector<size_t> shape;
+            std::string dims = npy_field(header, "shape");
+            for (size_t pos = 0; pos < dims.size();) {
+                size_t next = dims.find(',', pos);
+                std::string item = dims.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+                if (item.find_first_not_of(' ') != std::string::npos) {
+                    shape.push_back(std::stoull(item));
+                }
+                if (next == std::string::npos) break;
+                pos = next + 1;
+            }
+            
+            return dataset_from_mapping(std::move(mapping), path, header_start + header_len, type, shape, fortran_order);
+        }
+        
+#ifdef MATH_MCP_HAVE_HDF5
+        // Closes an HDF5 identifier on scope exit
+        struct H5Handle {
+            hid_t id;
+            herr_t (*close)(hid_t);
+            
+            ~H5Handle() {
+                if (id >= 0) close(id);
+            }
+        };
+        
+        Dataset read_hdf5(const std::string& path, const json::Object& spec) {
+            if (!spec.count("dataset") || !spec.at("dataset").is_string()) {
+                throw std::runtime_error("HDF5 inputs need a 'dataset' path");
+            }
+            const std::string& name = spec.at("dataset").as_string();
+            H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+            
+            H5Handle file{H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose};
+            if (file.id < 0) throw std::runtime_error("Cannot open HDF5 file '" + path + "'");
+            H5Handle dataset{H5Dopen2(file.id, name.c_str(), H5P_DEFAULT), H5Dclose};
+            if (dataset.id < 0) throw std::runtime_error("No dataset '" + name + "' in '" + path + "'");
+            H5Handle space{H5Dget_space(dataset.id), H5Sclose};
+            
+            int ndims = H5Sget_simple_extent_ndims(space.id);
+            if (ndims < 0) throw std::runtime_error("Cannot read the shape of '" + name + "'");
+            std::vector<hsize_t> dims(ndims);
+            H5Sget_simple_extent_dims(space.id, dims.data(), nullptr);
+            
+            std::vector<hsize_t> start(ndims, 0);
+            std::vector<hsize_t> count = dims;
+            if (spec.count("start")) {
+                std::vector<size_t> s = shape_argument(spec.at("start"), "start");
+                if ((int)s.size() != ndims) throw std::runtime_error("'start' must have one entry per dimension");
+                for (int d = 0; d < ndims; d++) {
+                    start[d] = s[d];
+                    count[d] = start[d] <= dims[d] ? dims[d] - start[d] : 0;
+                }
+            }
+            if (spec.count("count")) {
+                std::vector<size_t> c = shape_argument(spec.at("count"), "count");
+                if ((int)c.size() != ndims) throw std::runtime_error("'count' must have one entry per dimension");
+                for (int d = 0; d < ndims; d++) count[d] = c[d];
+            }
+            for (int d = 0; d < ndims; d++) {
+                if (start[d] + count[d] > dims[d]) {
+                    throw std::runtime_error("Hyperslab is outside dataset '" + name + "'");
+                }
+            }
+            
+            Dataset data;
+            apply_shape(data, std::vector<size_t>(count.begin(), count.end()), sizeof(double));
+            const size_t total = data.rows * data.cols;
+            auto buffer = std::make_shared<Vector>(total);
+            
+            if (total > 0) {
+                H5Sselect_hyperslab(space.id, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+                H5Handle memspace{H5Screate_simple(ndims, count.data(), nullptr), H5Sclose};
+                if (H5Dread(dataset.id, H5T_NATIVE_DOUBLE, memspace.id, space.id, H5P_DEFAULT, buffer->data()) < 0) {
+                    throw std::runtime_error("Failed to read dataset '" + name + "' as numbers");
+                }
+            }
+            
+            data.values = buffer->data();
+            data.owner = std::move(buffer);
+            return data;
+        }
+#endif
+    }
+    
+    bool is_file_spec(const json::Value& arg) {
+        return arg.is_object() && arg.as_object().count("path");
+    }
+    
+    Dataset read_array_file(const json::Value& spec) {
+        const auto& obj = spec.as_object();
+        if (!obj.at("path").is_string()) {
+            throw std::runtime_error("File input 'path' must be a string");
+        }
+        const std::string& path = obj.at("path").as_string();
+        
+        auto ends_with = [&](const char* suffix) {
+            size_t n = std::strlen(suffix);
+            return path.size() >= n && path.compare(path.size() - n, n, suffix) == 0;
+        };
+        std::string format = ends_with(".npy") ? "npy" : (ends_with(".h5") || ends_with(".hdf5")) ? "hdf5" : "raw";
+        if (obj.count("format")) {
+            if (!obj.at("format").is_string()) throw std::runtime_error("File input 'format' must be a string");
+            format = obj.at("format").as_string();
+        }
+        
+        if (format == "raw") return read_raw(path, obj);
+        if (format == "npy") return read_npy(path);
+        if (format == "hdf5") {
+#ifdef MATH_MCP_HAVE_HDF5
+            return read_hdf5(path, obj);
+#else
+            throw std::runtime_error("This server was built without HDF5 support");
+#endif
+        }
+        throw std::runtime_error("Unknown file format '" + format + "' (expected raw, npy or hdf5)");
+    }
+    
+}
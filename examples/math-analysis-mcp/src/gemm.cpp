@@ -0,0 +1,298 @@
+#include "gemm.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATH_OPS_X86 1
+#endif
+
+namespace math_ops {
+    
+    namespace {
+        
+        // Cache blocking: a KC x NR sliver of B stays in L1, an MC x KC block
+        // of A in L2, and a KC x NC panel of B in L3
+        constexpr size_t KC = 256;
+        constexpr size_t MC = 192;
+        constexpr size_t NC = 2048;
+        
+        // Below this many multiply-adds packing costs more than it saves
+        constexpr size_t kSmallProduct = 32 * 32 * 32;
+        // Below this many multiply-adds the product stays on one thread
+        constexpr size_t kParallelProduct = 128 * 128 * 128;
+        
+        // Microkernel: C[mr x nr] += alpha * Apanel * Bpanel over kc steps.
+        // Apanel holds kc columns of mr values, Bpanel kc rows of nr values.
+        using KernelFn = void (*)(size_t kc, const double* a, const double* b,
+                                  double* c, size_t ldc, double alpha);
+        
+        struct Kernel {
+            size_t mr;
+            size_t nr;
+            KernelFn fn;
+            const char* name;
+        };
+        
+        constexpr size_t kMaxMR = 8;
+        constexpr size_t kMaxNR = 16;
+        
+        void kernel_generic(size_t kc, const double* a, const double* b,
+                            double* c, size_t ldc, double alpha) {
+            constexpr size_t MR = 4, NR = 8;
+            double acc[MR][NR] = {};
+            for (size_t p = 0; p < kc; p++) {
+                for (size_t i = 0; i < MR; i++) {
+                    double av = a[p * MR + i];
+                    for (size_t j = 0; j < NR; j++) {
+                        acc[i][j] += av * b[p * NR + j];
+                    }
+                }
+            }
+            for (size_t i = 0; i < MR; i++) {
+                for (size_t j = 0; j < NR; j++) {
+                    c[i * ldc + j] += alpha * acc[i][j];
+                }
+            }
+        }
+        
+#ifdef MATH_OPS_X86
+        __attribute__((target("avx2,fma")))
+        void kernel_avx2(size_t kc, const double* a, const double* b,
+                         double* c, size_t ldc, double alpha) {
+            // 4 x 8 tile: eight ymm accumulators, two B loads per step
+            __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+            __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+            __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+            __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+            
+            for (size_t p = 0; p < kc; p++) {
+                __m256d b0 = _mm256_load_pd(b + p * 8);
+                __m256d b1 = _mm256_load_pd(b + p * 8 + 4);
+                __m256d a0 = _mm256_broadcast_sd(a + p * 4);
+                __m256d a1 = _mm256_broadcast_sd(a + p * 4 + 1);
+                c00 = _mm256_fmadd_pd(a0, b0, c00);
+                c01 = _mm256_fmadd_pd(a0, b1, c01);
+                c10 = _mm256_fmadd_pd(a1, b0, c10);
+                c11 = _mm256_fmadd_pd(a1, b1, c11);
+                __m256d a2 = _mm256_broadcast_sd(a + p * 4 + 2);
+                __m256d a3 = _mm256_broadcast_sd(a + p * 4 + 3);
+                c20 = _mm256_fmadd_pd(a2, b0, c20);
+                c21 = _mm256_fmadd_pd(a2, b1, c21);
+                c30 = _mm256_fmadd_pd(a3, b0, c30);
+                c31 = _mm256_fmadd_pd(a3, b1, c31);
+            }
+            
+            __m256d va = _mm256_set1_pd(alpha);
+            __m256d rows[4][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}};
+            for (size_t i = 0; i < 4; i++) {
+                double* row = c + i * ldc;
+                _mm256_storeu_pd(row, _mm256_fmadd_pd(va, rows[i][0], _mm256_loadu_pd(row)));
+                _mm256_storeu_pd(row + 4, _mm256_fmadd_pd(va, rows[i][1], _mm256_loadu_pd(row + 4)));
+            }
+        }
+        
+        __attribute__((target("avx512f")))
+        void kernel_avx512(size_t kc, const double* a, const double* b,
+                           double* c, size_t ldc, double alpha) {
+            // 8 x 16 tile: sixteen zmm accumulators, two B loads per step
+            __m512d acc[8][2];
+            for (size_t i = 0; i < 8; i++) {
+                acc[i][0] = _mm512_setzero_pd();
+                acc[i][1] = _mm512_setzero_pd();
+            }
+            
+            for (size_t p = 0; p < kc; p++) {
+                __m512d b0 = _mm512_load_pd(b + p * 16);
+                __m512d b1 = _mm512_load_pd(b + p * 16 + 8);
+                for (size_t i = 0; i < 8; i++) {
+                    __m512d ai = _mm512_set1_pd(a[p * 8 + i]);
+                    acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+                    acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+                }
+            }
+            
+            __m512d va = _mm512_set1_pd(alpha);
+            for (size_t i = 0; i < 8; i++) {
+                double* row = c + i * ldc;
+                _mm512_storeu_pd(row, _mm512_fmadd_pd(va, acc[i][0], _mm512_loadu_pd(row)));
+                _mm512_storeu_pd(row + 8, _mm512_fmadd_pd(va, acc[i][1], _mm512_loadu_pd(row + 8)));
+            }
+        }
+#endif
+        
+        const Kernel& select_kernel() {
+            static const Kernel kernel = [] {
+#ifdef MATH_OPS_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f")) {
+                    return Kernel{8, 16, kernel_avx512, "avx512"};
+                }
+                if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                    return Kernel{4, 8, kernel_avx2, "avx2"};
+                }
+#endif
+                return Kernel{4, 8, kernel_generic, "generic"};
+            }();
+            return kernel;
+        }
+        
+        struct FreeDeleter {
+            void operator()(double* p) const { std::free(p); }
+        };
+        using AlignedBuffer = std::unique_ptr<double[], FreeDeleter>;
+        
+        AlignedBuffer allocate_aligned(size_t count) {
+            size_t bytes = (count * sizeof(double) + 63) / 64 * 64;
+            void* p = std::aligned_alloc(64, std::max<size_t>(bytes, 64));
+            if (!p) throw std::bad_alloc();
+            return AlignedBuffer(static_cast<double*>(p));
+        }
+        
+        // Packs an mc x kc block of A into mr-row micro-panels, zero padded
+        void pack_a(size_t mc, size_t kc, const double* a, size_t lda, size_t mr, double* out) {
+            for (size_t ir = 0; ir < mc; ir += mr) {
+                size_t rows = std::min(mr, mc - ir);
+                for (size_t p = 0; p < kc; p++) {
+                    for (size_t i = 0; i < rows; i++) {
+                        out[i] = a[(ir + i) * lda + p];
+                    }
+                    for (size_t i = rows; i < mr; i++) {
+                        out[i] = 0.0;
+                    }
+                    out += mr;
+                }
+            }
+        }
+        
+        // Packs a kc x nc panel of B into nr-column micro-panels, zero padded
+        void pack_b(size_t kc, size_t nc, const double* b, size_t ldb, size_t nr, double* out) {
+            for (size_t jr = 0; jr < nc; jr += nr) {
+                size_t cols = std::min(nr, nc - jr);
+                for (size_t p = 0; p < kc; p++) {
+                    const double* src = b + p * ldb + jr;
+                    std::memcpy(out, src, cols * sizeof(double));
+                    for (size_t j = cols; j < nr; j++) {
+                        out[j] = 0.0;
+                    }
+                    out += nr;
+                }
+            }
+        }
+        
+        void scale_c(size_t m, size_t n, double beta, double* c, size_t ldc) {
+            if (beta == 1.0) return;
+            for (size_t i = 0; i < m; i++) {
+                double* row = c + i * ldc;
+                if (beta == 0.0) {
+                    std::fill(row, row + n, 0.0);
+                } else {
+                    for (size_t j = 0; j < n; j++) row[j] *= beta;
+                }
+            }
+        }
+        
+        // Unpacked i-k-j loop for products too small to amortize packing
+        void gemm_small(size_t m, size_t n, size_t k, double alpha,
+                        const double* a, size_t lda, const double* b, size_t ldb,
+                        double* c, size_t ldc) {
+            for (size_t i = 0; i < m; i++) {
+                double* c_row = c + i * ldc;
+                for (size_t p = 0; p < k; p++) {
+                    double av = alpha * a[i * lda + p];
+                    const double* b_row = b + p * ldb;
+                    for (size_t j = 0; j < n; j++) {
+                        c_row[j] += av * b_row[j];
+                    }
+                }
+            }
+        }
+        
+        void gemm_blocked(size_t m, size_t n, size_t k, double alpha,
+                          const double* a, size_t lda, const double* b, size_t ldb,
+                          double* c, size_t ldc) {
+            const Kernel& kernel = select_kernel();
+            const size_t mr = kernel.mr;
+            const size_t nr = kernel.nr;
+            
+            const size_t mc_max = std::min(MC, (m + mr - 1) / mr * mr);
+            const size_t nc_max = std::min(NC, (n + nr - 1) / nr * nr);
+            const size_t kc_max = std::min(KC, k);
+            AlignedBuffer a_pack = allocate_aligned(mc_max * kc_max);
+            AlignedBuffer b_pack = allocate_aligned(kc_max * nc_max);
+            alignas(64) double edge[kMaxMR * kMaxNR];
+            
+            for (size_t jc = 0; jc < n; jc += NC) {
+                size_t nc = std::min(NC, n - jc);
+                for (size_t pc = 0; pc < k; pc += KC) {
+                    size_t kc = std::min(KC, k - pc);
+                    pack_b(kc, nc, b + pc * ldb + jc, ldb, nr, b_pack.get());
+                    
+                    for (size_t ic = 0; ic < m; ic += MC) {
+                        size_t mc = std::min(MC, m - ic);
+                        pack_a(mc, kc, a + ic * lda + pc, lda, mr, a_pack.get());
+                        
+                        for (size_t jr = 0; jr < nc; jr += nr) {
+                            size_t cols = std::min(nr, nc - jr);
+                            const double* b_panel = b_pack.get() + jr * kc;
+                            for (size_t ir = 0; ir < mc; ir += mr) {
+                                size_t rows = std::min(mr, mc - ir);
+                                const double* a_panel = a_pack.get() + ir * kc;
+                                double* c_tile = c + (ic + ir) * ldc + jc + jr;
+                                
+                                if (rows == mr && cols == nr) {
+                                    kernel.fn(kc, a_panel, b_panel, c_tile, ldc, alpha);
+                                    continue;
+                                }
+                                
+                                // Partial tile at the matrix edge goes through a scratch tile
+                                std::fill(edge, edge + mr * nr, 0.0);
+                                kernel.fn(kc, a_panel, b_panel, edge, nr, alpha);
+                                for (size_t i = 0; i < rows; i++) {
+                                    for (size_t j = 0; j < cols; j++) {
+                                        c_tile[i * ldc + j] += edge[i * nr + j];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    void gemm(size_t m, size_t n, size_t k, double alpha,
+              const double* a, size_t lda, const double* b, size_t ldb,
+              double beta, double* c, size_t ldc) {
+        if (m == 0 || n == 0) return;
+        
+        scale_c(m, n, beta, c, ldc);
+        if (k == 0 || alpha == 0.0) return;
+        
+        const size_t work = m * n * k;
+        if (work < kSmallProduct) {
+            gemm_small(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+            return;
+        }
+        
+        if (work < kParallelProduct) {
+            gemm_blocked(m, n, k, alpha, a, lda, b, ldb, c, ldc);
+            return;
+        }
+        
+        // Each thread owns a band of C rows and packs its own panels
+        const size_t mr = select_kernel().mr;
+        parallel_for(m, std::max<size_t>(mr, kParallelProduct / (n * k) + 1), mr, [&](size_t begin, size_t end) {
+            gemm_blocked(end - begin, n, k, alpha, a + begin * lda, lda, b, ldb, c + begin * ldc, ldc);
+        });
+    }
+    
+    const char* gemm_kernel_name() {
+        return select_kernel().name;
+    }
+    
+}
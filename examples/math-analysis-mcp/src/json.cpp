@@ -1,8 +1,10 @@
 #include "json.hpp"
-#include <sstream>
-#include <iomanip>
 #include <stdexcept>
-#include <functional>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <cstdint>
+#include <cmath>
 
 namespace json {
     
@@ -10,242 +12,464 @@ namespace json {
         return stringify(*this);
     }
     
-    // Simple JSON parser - handles basic types needed for MCP
-    Value parse(const std::string& json_str) {
-        size_t pos = 0;
+    namespace {
         
-        std::function<void()> skip_whitespace = [&]() {
-            while (pos < json_str.length() && std::isspace(json_str[pos])) {
-                pos++;
-            }
-        };
+        // Nesting limit so hostile input cannot exhaust the stack
+        constexpr int kMaxDepth = 512;
+        
+        inline bool is_ws(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
         
-        std::function<Value()> parse_value = [&]() -> Value {
-            skip_whitespace();
+        inline bool is_digit(char c) {
+            return c >= '0' && c <= '9';
+        }
+        
+        // Single-pass recursive descent parser over a raw character range.
+        // Array elements are staged on one reusable value stack and moved into
+        // a right-sized Array when the closing bracket is seen, so large arrays
+        // never go through vector growth and string runs are appended in bulk.
+        class Parser {
+        public:
+            Parser(const char* begin, const char* end) : cur_(begin), end_(end) {}
             
-            if (pos >= json_str.length()) {
-                throw std::runtime_error("Unexpected end of JSON");
+            Value parse_document() {
+                Value value = parse_value(0);
+                skip_whitespace();
+                if (cur_ != end_) {
+                    throw std::runtime_error("Unexpected trailing characters in JSON");
+                }
+                return value;
             }
             
-            char c = json_str[pos];
+        private:
+            const char* cur_;
+            const char* end_;
+            std::vector<Value> stack_;
+            std::vector<double> numbers_;
             
-            if (c == 'n') {
-                if (json_str.substr(pos, 4) == "null") {
-                    pos += 4;
-                    return Value();
+            void skip_whitespace() {
+                while (cur_ != end_ && is_ws(*cur_)) {
+                    cur_++;
                 }
-                throw std::runtime_error("Invalid null value");
             }
             
-            if (c == 't') {
-                if (json_str.substr(pos, 4) == "true") {
-                    pos += 4;
-                    return Value(true);
+            bool consume_literal(const char* literal, size_t length) {
+                if (static_cast<size_t>(end_ - cur_) < length || std::memcmp(cur_, literal, length) != 0) {
+                    return false;
                 }
-                throw std::runtime_error("Invalid true value");
+                cur_ += length;
+                return true;
             }
             
-            if (c == 'f') {
-                if (json_str.substr(pos, 5) == "false") {
-                    pos += 5;
-                    return Value(false);
+            Value parse_value(int depth) {
+                skip_whitespace();
+                
+                if (cur_ == end_) {
+                    throw std::runtime_error("Unexpected end of JSON");
                 }
-                throw std::runtime_error("Invalid false value");
-            }
-            
-            if (c == '"') {
-                pos++; // Skip opening quote
-                std::string str;
-                while (pos < json_str.length() && json_str[pos] != '"') {
-                    if (json_str[pos] == '\\') {
-                        pos++;
-                        if (pos >= json_str.length()) break;
-                        switch (json_str[pos]) {
-                            case 'n': str += '\n'; break;
-                            case 't': str += '\t'; break;
-                            case 'r': str += '\r'; break;
-                            case '"': str += '"'; break;
-                            case '\\': str += '\\'; break;
-                            default: str += json_str[pos]; break;
-                        }
-                    } else {
-                        str += json_str[pos];
+                
+                switch (*cur_) {
+                    case 'n':
+                        if (consume_literal("null", 4)) return Value();
+                        throw std::runtime_error("Invalid null value");
+                    case 't':
+                        if (consume_literal("true", 4)) return Value(true);
+                        throw std::runtime_error("Invalid true value");
+                    case 'f':
+                        if (consume_literal("false", 5)) return Value(false);
+                        throw std::runtime_error("Invalid false value");
+                    case '"': {
+                        std::string str;
+                        parse_string(str);
+                        return Value(std::move(str));
                     }
-                    pos++;
-                }
-                if (pos >= json_str.length()) {
-                    throw std::runtime_error("Unterminated string");
+                    case '[':
+                        return parse_array(depth + 1);
+                    case '{':
+                        return parse_object(depth + 1);
+                    default:
+                        if (*cur_ == '-' || is_digit(*cur_)) {
+                            return parse_number();
+                        }
+                        throw std::runtime_error("Invalid JSON value");
                 }
-                pos++; // Skip closing quote
-                return Value(str);
             }
             
-            if (c == '[') {
-                pos++; // Skip opening bracket
-                Array arr;
+            Value parse_array(int depth) {
+                if (depth > kMaxDepth) {
+                    throw std::runtime_error("JSON nesting too deep");
+                }
+                cur_++; // Skip opening bracket
+                
+                const char* first = cur_;
                 skip_whitespace();
                 
-                if (pos < json_str.length() && json_str[pos] == ']') {
-                    pos++; // Skip closing bracket
-                    return Value(arr);
+                if (cur_ != end_ && *cur_ == ']') {
+                    cur_++;
+                    return Value(Array{});
                 }
                 
-                while (pos < json_str.length()) {
-                    arr.push_back(parse_value());
+                if (cur_ != end_ && (*cur_ == '-' || is_digit(*cur_))) {
+                    if (parse_number_array()) {
+                        return Value(NumberArray(numbers_.begin(), numbers_.end()));
+                    }
+                    // Mixed content: rescan the array generically
+                    cur_ = first;
+                    skip_whitespace();
+                }
+                
+                const size_t base = stack_.size();
+                while (true) {
+                    stack_.push_back(parse_value(depth));
                     skip_whitespace();
                     
-                    if (pos >= json_str.length()) break;
-                    
-                    if (json_str[pos] == ']') {
-                        pos++; // Skip closing bracket
-                        break;
+                    if (cur_ == end_) {
+                        throw std::runtime_error("Unterminated array");
                     }
-                    
-                    if (json_str[pos] == ',') {
-                        pos++; // Skip comma
+                    if (*cur_ == ',') {
+                        cur_++;
                         continue;
                     }
-                    
+                    if (*cur_ == ']') {
+                        cur_++;
+                        break;
+                    }
                     throw std::runtime_error("Expected ',' or ']' in array");
                 }
                 
-                return Value(arr);
+                Array arr(std::make_move_iterator(stack_.begin() + base),
+                          std::make_move_iterator(stack_.end()));
+                stack_.resize(base);
+                return Value(std::move(arr));
             }
             
-            if (c == '{') {
-                pos++; // Skip opening brace
+            // Reads a run of comma separated numbers up to the closing bracket
+            // into numbers_. Returns false, leaving cur_ unspecified, as soon
+            // as a non-numeric element shows up.
+            bool parse_number_array() {
+                numbers_.clear();
+                while (true) {
+                    skip_whitespace();
+                    if (cur_ == end_ || !(*cur_ == '-' || is_digit(*cur_))) {
+                        return false;
+                    }
+                    const char* start = cur_;
+                    scan_number();
+                    double value = 0.0;
+                    auto result = std::from_chars(start, cur_, value);
+                    if (result.ec != std::errc() || result.ptr != cur_) {
+                        throw std::runtime_error("Invalid number");
+                    }
+                    numbers_.push_back(value);
+                    
+                    skip_whitespace();
+                    if (cur_ == end_) {
+                        throw std::runtime_error("Unterminated array");
+                    }
+                    if (*cur_ == ',') {
+                        cur_++;
+                        continue;
+                    }
+                    if (*cur_ == ']') {
+                        cur_++;
+                        return true;
+                    }
+                    return false;
+                }
+            }
+            
+            Value parse_object(int depth) {
+                if (depth > kMaxDepth) {
+                    throw std::runtime_error("JSON nesting too deep");
+                }
+                cur_++; // Skip opening brace
+                
                 Object obj;
                 skip_whitespace();
                 
-                if (pos < json_str.length() && json_str[pos] == '}') {
-                    pos++; // Skip closing brace
-                    return Value(obj);
+                if (cur_ != end_ && *cur_ == '}') {
+                    cur_++;
+                    return Value(std::move(obj));
                 }
                 
-                while (pos < json_str.length()) {
-                    // Parse key
-                    Value key = parse_value();
-                    if (!key.is_string()) {
+                std::string key;
+                while (true) {
+                    skip_whitespace();
+                    if (cur_ == end_ || *cur_ != '"') {
                         throw std::runtime_error("Object key must be string");
                     }
+                    parse_string(key);
                     
                     skip_whitespace();
-                    if (pos >= json_str.length() || json_str[pos] != ':') {
+                    if (cur_ == end_ || *cur_ != ':') {
                         throw std::runtime_error("Expected ':' after object key");
                     }
-                    pos++; // Skip colon
+                    cur_++; // Skip colon
                     
-                    // Parse value
-                    Value value = parse_value();
-                    obj[key.as_string()] = value;
+                    obj.insert_or_assign(key, parse_value(depth));
                     
                     skip_whitespace();
-                    if (pos >= json_str.length()) break;
-                    
-                    if (json_str[pos] == '}') {
-                        pos++; // Skip closing brace
-                        break;
+                    if (cur_ == end_) {
+                        throw std::runtime_error("Unterminated object");
                     }
-                    
-                    if (json_str[pos] == ',') {
-                        pos++; // Skip comma
+                    if (*cur_ == ',') {
+                        cur_++;
                         continue;
                     }
-                    
+                    if (*cur_ == '}') {
+                        cur_++;
+                        break;
+                    }
                     throw std::runtime_error("Expected ',' or '}' in object");
                 }
                 
-                return Value(obj);
+                return Value(std::move(obj));
             }
             
-            // Parse number
-            if (c == '-' || std::isdigit(c)) {
-                std::string num_str;
-                bool is_double = false;
+            static void append_utf8(std::string& out, uint32_t cp) {
+                if (cp < 0x80) {
+                    out += static_cast<char>(cp);
+                } else if (cp < 0x800) {
+                    out += static_cast<char>(0xC0 | (cp >> 6));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                } else if (cp < 0x10000) {
+                    out += static_cast<char>(0xE0 | (cp >> 12));
+                    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                } else {
+                    out += static_cast<char>(0xF0 | (cp >> 18));
+                    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (cp & 0x3F));
+                }
+            }
+            
+            uint32_t parse_hex4() {
+                if (end_ - cur_ < 4) {
+                    throw std::runtime_error("Invalid unicode escape");
+                }
+                uint32_t cp = 0;
+                auto result = std::from_chars(cur_, cur_ + 4, cp, 16);
+                if (result.ec != std::errc() || result.ptr != cur_ + 4) {
+                    throw std::runtime_error("Invalid unicode escape");
+                }
+                cur_ += 4;
+                return cp;
+            }
+            
+            // Parses the string starting at the opening quote into out, reusing its capacity
+            void parse_string(std::string& out) {
+                out.clear();
+                cur_++; // Skip opening quote
                 
-                while (pos < json_str.length() && 
-                       (std::isdigit(json_str[pos]) || json_str[pos] == '-' || 
-                        json_str[pos] == '+' || json_str[pos] == '.' || 
-                        json_str[pos] == 'e' || json_str[pos] == 'E')) {
-                    if (json_str[pos] == '.' || json_str[pos] == 'e' || json_str[pos] == 'E') {
-                        is_double = true;
+                while (true) {
+                    const char* run = cur_;
+                    while (cur_ != end_ && *cur_ != '"' && *cur_ != '\\') {
+                        cur_++;
+                    }
+                    out.append(run, cur_);
+                    
+                    if (cur_ == end_) {
+                        throw std::runtime_error("Unterminated string");
+                    }
+                    if (*cur_ == '"') {
+                        cur_++; // Skip closing quote
+                        return;
+                    }
+                    
+                    cur_++; // Skip backslash
+                    if (cur_ == end_) {
+                        throw std::runtime_error("Unterminated string");
+                    }
+                    char escape = *cur_++;
+                    switch (escape) {
+                        case 'n': out += '\n'; break;
+                        case 't': out += '\t'; break;
+                        case 'r': out += '\r'; break;
+                        case 'b': out += '\b'; break;
+                        case 'f': out += '\f'; break;
+                        case 'u': {
+                            uint32_t cp = parse_hex4();
+                            if (cp >= 0xD800 && cp < 0xDC00 && end_ - cur_ >= 6 &&
+                                cur_[0] == '\\' && cur_[1] == 'u') {
+                                cur_ += 2;
+                                uint32_t low = parse_hex4();
+                                if (low >= 0xDC00 && low < 0xE000) {
+                                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                                } else {
+                                    append_utf8(out, cp);
+                                    cp = low;
+                                }
+                            }
+                            append_utf8(out, cp);
+                            break;
+                        }
+                        default: out += escape; break;
                     }
-                    num_str += json_str[pos];
-                    pos++;
                 }
+            }
+            
+            // Advances past a number token; returns true if it has a fraction or exponent
+            bool scan_number() {
+                bool is_double = false;
                 
-                if (is_double) {
-                    return Value(std::stod(num_str));
-                } else {
-                    return Value(std::stoi(num_str));
+                if (*cur_ == '-') cur_++;
+                while (cur_ != end_ && is_digit(*cur_)) cur_++;
+                if (cur_ != end_ && *cur_ == '.') {
+                    is_double = true;
+                    cur_++;
+                    while (cur_ != end_ && is_digit(*cur_)) cur_++;
+                }
+                if (cur_ != end_ && (*cur_ == 'e' || *cur_ == 'E')) {
+                    is_double = true;
+                    cur_++;
+                    if (cur_ != end_ && (*cur_ == '+' || *cur_ == '-')) cur_++;
+                    while (cur_ != end_ && is_digit(*cur_)) cur_++;
                 }
+                return is_double;
             }
             
-            throw std::runtime_error("Invalid JSON value");
+            Value parse_number() {
+                const char* start = cur_;
+                bool is_double = scan_number();
+                
+                if (!is_double) {
+                    int int_value = 0;
+                    auto result = std::from_chars(start, cur_, int_value);
+                    if (result.ec == std::errc() && result.ptr == cur_) {
+                        return Value(int_value);
+                    }
+                    if (result.ec != std::errc::result_out_of_range) {
+                        throw std::runtime_error("Invalid number");
+                    }
+                    // Integers beyond int range degrade to double instead of failing
+                }
+                
+                double double_value = 0.0;
+                auto result = std::from_chars(start, cur_, double_value);
+                if (result.ec != std::errc() || result.ptr != cur_) {
+                    throw std::runtime_error("Invalid number");
+                }
+                return Value(double_value);
+            }
         };
-        
-        return parse_value();
     }
     
-    std::string stringify(const Value& value) {
+    Value parse(std::string_view json_str) {
+        Parser parser(json_str.data(), json_str.data() + json_str.size());
+        return parser.parse_document();
+    }
+    
+    void Writer::write(const Value& value) {
         if (value.is_null()) {
-            return "null";
-        }
-        
-        if (value.is_bool()) {
-            return value.as_bool() ? "true" : "false";
-        }
-        
-        if (value.is_int()) {
-            return std::to_string(value.as_int());
-        }
-        
-        if (value.is_double()) {
-            std::ostringstream oss;
-            oss << std::fixed << std::setprecision(6) << value.as_double();
-            return oss.str();
-        }
-        
-        if (value.is_string()) {
-            std::string result = "\"";
-            for (char c : value.as_string()) {
-                switch (c) {
-                    case '"': result += "\\\""; break;
-                    case '\\': result += "\\\\"; break;
-                    case '\n': result += "\\n"; break;
-                    case '\t': result += "\\t"; break;
-                    case '\r': result += "\\r"; break;
-                    default: result += c; break;
-                }
-            }
-            result += "\"";
-            return result;
-        }
-        
-        if (value.is_array()) {
-            std::string result = "[";
+            out_ += "null";
+        } else if (value.is_bool()) {
+            out_ += value.as_bool() ? "true" : "false";
+        } else if (value.is_int()) {
+            write_int(value.as_int());
+        } else if (value.is_double()) {
+            write_double(value.as_double());
+        } else if (value.is_string()) {
+            write_string(value.as_string());
+        } else if (value.is_number_array()) {
+            const auto& arr = value.as_number_array();
+            // Shortest round-trip doubles rarely exceed 24 characters plus a comma
+            out_.reserve(out_.size() + arr.size() * 25 + 2);
+            out_ += '[';
+            for (size_t i = 0; i < arr.size(); i++) {
+                if (i > 0) out_ += ',';
+                write_double(arr[i]);
+            }
+            out_ += ']';
+        } else if (value.is_array()) {
             const auto& arr = value.as_array();
+            out_ += '[';
             for (size_t i = 0; i < arr.size(); i++) {
-                if (i > 0) result += ",";
-                result += stringify(arr[i]);
+                if (i > 0) out_ += ',';
+                write(arr[i]);
             }
-            result += "]";
-            return result;
-        }
-        
-        if (value.is_object()) {
-            std::string result = "{";
-            const auto& obj = value.as_object();
+            out_ += ']';
+        } else if (value.is_object()) {
+            out_ += '{';
             bool first = true;
-            for (const auto& [key, val] : obj) {
-                if (!first) result += ",";
+            for (const auto& [key, val] : value.as_object()) {
+                if (!first) out_ += ',';
                 first = false;
-                result += stringify(Value(key)) + ":" + stringify(val);
+                write_string(key);
+                out_ += ':';
+                write(val);
             }
-            result += "}";
-            return result;
+            out_ += '}';
+        } else if (value.is_raw()) {
+            const auto& raw = value.as_raw();
+            if (!raw.text) {
+                out_ += "null";
+            } else if (raw.as_string) {
+                write_string(*raw.text);
+            } else {
+                out_ += *raw.text;
+            }
+        } else {
+            out_ += "null";
         }
+    }
+    
+    void Writer::write_int(int value) {
+        char buf[16];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out_.append(buf, result.ptr);
+    }
+    
+    void Writer::write_double(double value) {
+        // JSON has no representation for NaN or infinity
+        if (!std::isfinite(value)) {
+            out_ += "null";
+            return;
+        }
+        char buf[32];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out_.append(buf, result.ptr);
+    }
+    
+    void Writer::write_string(std::string_view str) {
+        static const char hex[] = "0123456789abcdef";
         
-        return "null";
+        out_ += '"';
+        size_t run = 0;
+        for (size_t i = 0; i < str.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(str[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            out_.append(str.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+                case '"': out_ += "\\\""; break;
+                case '\\': out_ += "\\\\"; break;
+                case '\n': out_ += "\\n"; break;
+                case '\t': out_ += "\\t"; break;
+                case '\r': out_ += "\\r"; break;
+                case '\b': out_ += "\\b"; break;
+                case '\f': out_ += "\\f"; break;
+                default:
+                    out_ += "\\u00";
+                    out_ += hex[c >> 4];
+                    out_ += hex[c & 0xF];
+                    break;
+            }
+        }
+        out_.append(str.data() + run, str.size() - run);
+        out_ += '"';
+    }
+    
+    void stringify(const Value& value, std::string& out) {
+        Writer(out).write(value);
+    }
+    
+    std::string stringify(const Value& value) {
+        std::string result;
+        stringify(value, result);
+        return result;
     }
 }
\ No newline at end of file
@@ -1,44 +1,279 @@
 #include "mcp_server.hpp"
 #include "math_operations.hpp"
+#include "calculus.hpp"
+#include "small_matrix.hpp"
+#include "statistics_sketch.hpp"
+#include "dataset_store.hpp"
+#include "file_input.hpp"
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <limits>
 
-int main() {
+// Coefficients plus a human-readable equation for one polynomial fit
+static json::Value polynomial_to_json(const std::vector<double>& coefficients, int degree) {
+    json::Value result;
+    result["coefficients"] = math_ops::vector_to_json(coefficients);
+    result["degree"] = degree;
+    
+    // Build equation string
+    std::string equation = "y = ";
+    for (int i = coefficients.size() - 1; i >= 0; i--) {
+        if (i < (int)coefficients.size() - 1) {
+            equation += (coefficients[i] >= 0) ? " + " : " - ";
+            equation += std::to_string(std::abs(coefficients[i]));
+        } else {
+            equation += std::to_string(coefficients[i]);
+        }
+        
+        if (i > 1) {
+            equation += "x^" + std::to_string(i);
+        } else if (i == 1) {
+            equation += "x";
+        }
+    }
+    
+    result["equation"] = equation;
+    return result;
+}
+
+// Optional boolean tool argument, false when absent
+static bool flag_argument(const json::Object& obj, const char* key) {
+    auto it = obj.find(key);
+    if (it == obj.end()) return false;
+    if (!it->second.is_bool()) {
+        throw std::runtime_error(std::string("'") + key + "' must be a boolean");
+    }
+    return it->second.as_bool();
+}
+
+// Optional numeric tool argument; leaves `out` alone and returns false when absent
+static bool number_argument(const json::Object& obj, const char* key, double& out) {
+    auto it = obj.find(key);
+    if (it == obj.end()) return false;
+    if (it->second.is_double()) {
+        out = it->second.as_double();
+    } else if (it->second.is_int()) {
+        out = it->second.as_int();
+    } else {
+        throw std::runtime_error(std::string("'") + key + "' must be a number");
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    mcp::ServerOptions options;
+    size_t dataset_memory_mb = 1024;
+    
+    // ── simple flag loop ──
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if ((a == "-w" || a == "--workers") && i + 1 < argc) {
+            options.worker_threads = std::stoul(argv[++i]);
+        } else if ((a == "-q" || a == "--queue-capacity") && i + 1 < argc) {
+            options.queue_capacity = std::stoul(argv[++i]);
+        } else if ((a == "-m" || a == "--dataset-memory") && i + 1 < argc) {
+            dataset_memory_mb = std::stoul(argv[++i]);
+        } else if (a == "--max-frame-mb" && i + 1 < argc) {
+            options.max_frame_bytes = std::stoul(argv[++i]) << 20;
+        } else if (a == "--metrics") {
+            options.dump_metrics = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-w workers] [-q queue_capacity] [-m dataset_memory_mb] [--max-frame-mb n]"
+                      << " [--metrics]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    
     try {
-        mcp::Server server("MathAnalysisMCP", "1.0.0");
+        mcp::Server server("MathAnalysisMCP", "1.0.0", options);
+        math_ops::DatasetStore datasets(dataset_memory_mb << 20);
+        
+        // Register dataset store tools
+        json::Value load_schema;
+        load_schema["type"] = "object";
+        load_schema["properties"]["data"]["type"] = json::Value(json::Array{"array", "object"});
+        load_schema["required"] = json::Value(json::Array{"data"});
+        
+        server.register_tool("load_dataset",
+            "Store a vector or matrix on the server and return a handle. 'data' is an inline array or a file "
+            "spec {path, format, dtype, offset, shape, dataset, start, count}; files are mapped, not copied. "
+            "Any array argument of the other tools accepts the handle string or a file spec in place of the data",
+            load_schema,
+            [&datasets](const json::Value& params) -> json::Value {
+                if (!params.is_object() || params.as_object().find("data") == params.as_object().end()) {
+                    throw std::runtime_error("Missing 'data' parameter");
+                }
+                
+                const auto& data = params.as_object().at("data");
+                if (math_ops::is_file_spec(data)) {
+                    return datasets.describe(datasets.put(math_ops::read_array_file(data)));
+                }
+                
+                bool is_matrix = data.is_array() && !data.as_array().empty() &&
+                                 (data.as_array()[0].is_array() || data.as_array()[0].is_number_array());
+                std::string handle = is_matrix ? datasets.put(math_ops::json_to_matrix(data))
+                                               : datasets.put(math_ops::json_to_vector(data));
+                return datasets.describe(handle);
+            }
+        );
+        
+        json::Value release_schema;
+        release_schema["type"] = "object";
+        release_schema["properties"]["handle"]["type"] = "string";
+        release_schema["required"] = json::Value(json::Array{"handle"});
+        
+        server.register_tool("release_dataset",
+            "Free a stored dataset",
+            release_schema,
+            [&datasets](const json::Value& params) -> json::Value {
+                if (!params.is_object() || params.as_object().find("handle") == params.as_object().end() ||
+                    !params.as_object().at("handle").is_string()) {
+                    throw std::runtime_error("Missing 'handle' parameter");
+                }
+                
+                json::Value result;
+                result["released"] = datasets.release(params.as_object().at("handle").as_string());
+                return result;
+            }
+        );
+        
+        json::Value list_schema;
+        list_schema["type"] = "object";
+        
+        server.register_tool("list_datasets",
+            "List stored datasets with their shapes and the store's memory usage",
+            list_schema,
+            [&datasets](const json::Value&) -> json::Value {
+                return datasets.list();
+            }
+        );
         
         // Register statistical analysis tool
         json::Value stats_schema;
         stats_schema["type"] = "object";
-        stats_schema["properties"]["data"]["type"] = "array";
-        stats_schema["properties"]["data"]["items"]["type"] = "number";
+        stats_schema["properties"]["data"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        stats_schema["properties"]["statistics"]["type"] = "array";
+        stats_schema["properties"]["statistics"]["items"]["type"] = "string";
+        stats_schema["properties"]["statistics"]["items"]["enum"] = json::Value(json::Array{
+            "mean", "median", "mode", "standard_deviation", "variance", "minimum", "maximum", "range", "count"});
+        stats_schema["properties"]["include_summary"]["type"] = "boolean";
+        stats_schema["properties"]["compression"]["type"] = "number";
         stats_schema["required"] = json::Value(json::Array{"data"});
         
         server.register_tool("calculate_statistics", 
-            "Calculate comprehensive statistics (mean, median, mode, standard deviation, etc.) for a dataset",
+            "Calculate comprehensive statistics (mean, median, mode, standard deviation, etc.) for a dataset. "
+            "Pass 'statistics' to compute only the listed values; 'include_summary' adds a mergeable "
+            "summary (moments plus t-digest) for use with merge_statistics",
             stats_schema,
-            [](const json::Value& params) -> json::Value {
+            [&datasets](const json::Value& params) -> json::Value {
                 if (!params.is_object() || params.as_object().find("data") == params.as_object().end()) {
                     throw std::runtime_error("Missing 'data' parameter");
                 }
                 
-                std::vector<double> data = math_ops::json_to_vector(params.as_object().at("data"));
-                math_ops::Statistics stats = math_ops::calculate_statistics(data);
-                return math_ops::statistics_to_json(stats);
+                const auto& obj = params.as_object();
+                unsigned fields = math_ops::kStatAll;
+                if (obj.find("statistics") != obj.end()) {
+                    fields = math_ops::statistics_fields_from_json(obj.at("statistics"));
+                }
+                
+                auto data = datasets.resolve_vector(obj.at("data"));
+                math_ops::Statistics stats = math_ops::calculate_statistics(data.vector(), fields);
+                json::Value result = math_ops::statistics_to_json(stats);
+                
+                if (flag_argument(obj, "include_summary")) {
+                    double compression = 100.0;
+                    if (number_argument(obj, "compression", compression) &&
+                        !(std::isfinite(compression) && compression > 0.0)) {
+                        throw std::runtime_error("'compression' must be a positive number");
+                    }
+                    result["summary"] = math_ops::summary_to_json(math_ops::summarize(data.vector(), compression));
+                }
+                return result;
+            }
+        );
+        
+        // Register summary merge tool
+        json::Value merge_schema;
+        merge_schema["type"] = "object";
+        merge_schema["properties"]["summaries"]["type"] = "array";
+        merge_schema["properties"]["summaries"]["items"]["type"] = "object";
+        merge_schema["properties"]["percentiles"]["type"] = "array";
+        merge_schema["properties"]["percentiles"]["items"]["type"] = "number";
+        merge_schema["required"] = json::Value(json::Array{"summaries"});
+        
+        server.register_tool("merge_statistics",
+            "Merge summaries returned by calculate_statistics (include_summary) for chunks of a dataset. "
+            "Returns exact count, mean, variance and extremes, approximate median and percentiles "
+            "with their rank error, and the merged summary for further merging",
+            merge_schema,
+            [](const json::Value& params) -> json::Value {
+                if (!params.is_object() || params.as_object().find("summaries") == params.as_object().end()) {
+                    throw std::runtime_error("Missing 'summaries' parameter");
+                }
+                
+                const auto& obj = params.as_object();
+                const auto& summaries = obj.at("summaries");
+                if (!summaries.is_array() || summaries.as_array().empty()) {
+                    throw std::runtime_error("'summaries' must be a non-empty array of summary objects");
+                }
+                
+                math_ops::StatisticsSummary merged = math_ops::json_to_summary(summaries.as_array()[0]);
+                for (size_t i = 1; i < summaries.as_array().size(); i++) {
+                    merged.merge(math_ops::json_to_summary(summaries.as_array()[i]));
+                }
+                if (merged.moments.count == 0) {
+                    throw std::runtime_error("Cannot calculate statistics for empty dataset");
+                }
+                
+                std::vector<double> percentiles = {25.0, 50.0, 75.0};
+                if (obj.find("percentiles") != obj.end()) {
+                    percentiles = math_ops::json_to_vector(obj.at("percentiles"));
+                }
+                
+                const auto& m = merged.moments;
+                json::Value result;
+                result["mean"] = m.mean;
+                result["median"] = merged.digest.quantile(0.5);
+                result["variance"] = m.variance();
+                result["standard_deviation"] = std::sqrt(m.variance());
+                result["minimum"] = m.min;
+                result["maximum"] = m.max;
+                result["range"] = m.max - m.min;
+                result["count"] = math_ops::count_to_json(m.count);
+                
+                json::Array estimates;
+                for (double p : percentiles) {
+                    if (!(p >= 0.0 && p <= 100.0)) {
+                        throw std::runtime_error("Percentiles must be between 0 and 100");
+                    }
+                    json::Value estimate;
+                    estimate["percentile"] = p;
+                    estimate["value"] = merged.digest.quantile(p / 100.0);
+                    estimate["rank_error"] = merged.digest.rank_error(p / 100.0);
+                    estimates.push_back(std::move(estimate));
+                }
+                result["percentiles"] = json::Value(std::move(estimates));
+                result["summary"] = math_ops::summary_to_json(merged);
+                return result;
             }
         );
         
         // Register matrix multiplication tool
         json::Value matrix_mult_schema;
         matrix_mult_schema["type"] = "object";
-        matrix_mult_schema["properties"]["matrix_a"]["type"] = "array";
-        matrix_mult_schema["properties"]["matrix_b"]["type"] = "array";
+        matrix_mult_schema["properties"]["matrix_a"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        matrix_mult_schema["properties"]["matrix_b"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        matrix_mult_schema["properties"]["store_result"]["type"] = "boolean";
         matrix_mult_schema["required"] = json::Value(json::Array{"matrix_a", "matrix_b"});
         
         server.register_tool("multiply_matrices",
             "Multiply two matrices using standard matrix multiplication",
             matrix_mult_schema,
-            [](const json::Value& params) -> json::Value {
+            [&datasets](const json::Value& params) -> json::Value {
                 if (!params.is_object()) {
                     throw std::runtime_error("Invalid parameters");
                 }
@@ -48,10 +283,21 @@ int main() {
                     throw std::runtime_error("Missing matrix parameters");
                 }
                 
-                math_ops::Matrix a = math_ops::json_to_matrix(obj.at("matrix_a"));
-                math_ops::Matrix b = math_ops::json_to_matrix(obj.at("matrix_b"));
+                auto a = datasets.resolve_matrix(obj.at("matrix_a"));
+                auto b = datasets.resolve_matrix(obj.at("matrix_b"));
+                
+                // Small square products skip the general gemm path and its result allocation
+                if (!flag_argument(obj, "store_result")) {
+                    double small[math_ops::kSmallMatrixMax * math_ops::kSmallMatrixMax];
+                    if (math_ops::small_multiply(a.matrix(), b.matrix(), small)) {
+                        return math_ops::matrix_to_json(math_ops::MatrixView(small, a.rows, a.rows, a.rows));
+                    }
+                }
                 
-                math_ops::Matrix result = math_ops::multiply_matrices(a, b);
+                math_ops::Matrix result = math_ops::multiply_matrices(a.matrix(), b.matrix());
+                if (flag_argument(obj, "store_result")) {
+                    return datasets.describe(datasets.put(std::move(result)));
+                }
                 return math_ops::matrix_to_json(result);
             }
         );
@@ -59,14 +305,15 @@ int main() {
         // Register matrix-vector multiplication tool
         json::Value matvec_schema;
         matvec_schema["type"] = "object";
-        matvec_schema["properties"]["matrix"]["type"] = "array";
-        matvec_schema["properties"]["vector"]["type"] = "array";
+        matvec_schema["properties"]["matrix"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        matvec_schema["properties"]["vector"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        matvec_schema["properties"]["store_result"]["type"] = "boolean";
         matvec_schema["required"] = json::Value(json::Array{"matrix", "vector"});
         
         server.register_tool("multiply_matrix_vector",
             "Multiply a matrix by a vector",
             matvec_schema,
-            [](const json::Value& params) -> json::Value {
+            [&datasets](const json::Value& params) -> json::Value {
                 if (!params.is_object()) {
                     throw std::runtime_error("Invalid parameters");
                 }
@@ -76,26 +323,61 @@ int main() {
                     throw std::runtime_error("Missing matrix or vector parameters");
                 }
                 
-                math_ops::Matrix matrix = math_ops::json_to_matrix(obj.at("matrix"));
-                math_ops::Vector vector = math_ops::json_to_vector(obj.at("vector"));
+                auto matrix = datasets.resolve_matrix(obj.at("matrix"));
+                auto vector = datasets.resolve_vector(obj.at("vector"));
                 
-                math_ops::Vector result = math_ops::multiply_matrix_vector(matrix, vector);
+                math_ops::Vector result = math_ops::multiply_matrix_vector(matrix.matrix(), vector.vector());
+                if (flag_argument(obj, "store_result")) {
+                    return datasets.describe(datasets.put(std::move(result)));
+                }
                 return math_ops::vector_to_json(result);
             }
         );
         
+        // Register determinant tool
+        json::Value det_schema;
+        det_schema["type"] = "object";
+        det_schema["properties"]["matrix"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        det_schema["required"] = json::Value(json::Array{"matrix"});
+        
+        server.register_tool("determinant",
+            "Compute the determinant of a square matrix using LU decomposition with partial pivoting",
+            det_schema,
+            [&datasets](const json::Value& params) -> json::Value {
+                if (!params.is_object() || params.as_object().find("matrix") == params.as_object().end()) {
+                    throw std::runtime_error("Missing 'matrix' parameter");
+                }
+                
+                auto matrix = datasets.resolve_matrix(params.as_object().at("matrix"));
+                
+                double det = 0.0;
+                if (!math_ops::small_determinant(matrix.matrix(), det)) {
+                    det = math_ops::determinant(matrix.matrix());
+                }
+                
+                json::Value result;
+                result["determinant"] = det;
+                result["size"] = (int)matrix.rows;
+                return result;
+            }
+        );
+        
         // Register polynomial fitting tool
         json::Value polyfit_schema;
         polyfit_schema["type"] = "object";
-        polyfit_schema["properties"]["x_values"]["type"] = "array";
-        polyfit_schema["properties"]["y_values"]["type"] = "array";
-        polyfit_schema["properties"]["degree"]["type"] = "integer";
+        polyfit_schema["properties"]["x_values"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        polyfit_schema["properties"]["y_values"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        polyfit_schema["properties"]["degree"]["type"] = json::Value(json::Array{"integer", "array"});
+        polyfit_schema["properties"]["degree"]["items"]["type"] = "integer";
+        polyfit_schema["properties"]["method"]["type"] = "string";
+        polyfit_schema["properties"]["method"]["enum"] = json::Value(json::Array{"normal", "qr"});
         polyfit_schema["required"] = json::Value(json::Array{"x_values", "y_values", "degree"});
         
         server.register_tool("polynomial_fit",
-            "Fit a polynomial of specified degree to data points using least squares",
+            "Fit a polynomial of specified degree to data points using least squares. "
+            "Pass an array of degrees to fit several in one pass; method 'qr' trades speed for stability",
             polyfit_schema,
-            [](const json::Value& params) -> json::Value {
+            [&datasets](const json::Value& params) -> json::Value {
                 if (!params.is_object()) {
                     throw std::runtime_error("Invalid parameters");
                 }
@@ -106,41 +388,61 @@ int main() {
                     throw std::runtime_error("Missing required parameters");
                 }
                 
-                std::vector<double> x = math_ops::json_to_vector(obj.at("x_values"));
-                std::vector<double> y = math_ops::json_to_vector(obj.at("y_values"));
+                auto x_data = datasets.resolve_vector(obj.at("x_values"));
+                auto y_data = datasets.resolve_vector(obj.at("y_values"));
+                math_ops::VectorView x = x_data.vector();
+                math_ops::VectorView y = y_data.vector();
                 
-                int degree;
-                if (obj.at("degree").is_int()) {
-                    degree = obj.at("degree").as_int();
-                } else {
-                    throw std::runtime_error("Degree must be an integer");
+                math_ops::FitMethod method = math_ops::FitMethod::NormalEquations;
+                if (obj.find("method") != obj.end()) {
+                    const auto& method_val = obj.at("method");
+                    if (!method_val.is_string() || (method_val.as_string() != "normal" && method_val.as_string() != "qr")) {
+                        throw std::runtime_error("Method must be 'normal' or 'qr'");
+                    }
+                    if (method_val.as_string() == "qr") {
+                        method = math_ops::FitMethod::QR;
+                    }
+                }
+                
+                const auto& degree_val = obj.at("degree");
+                if (degree_val.is_int()) {
+                    int degree = degree_val.as_int();
+                    std::vector<double> coefficients = math_ops::polynomial_fit(x, y, degree, method);
+                    return polynomial_to_json(coefficients, degree);
                 }
                 
-                std::vector<double> coefficients = math_ops::polynomial_fit(x, y, degree);
+                if (!degree_val.is_number_array() && !degree_val.is_array()) {
+                    throw std::runtime_error("Degree must be an integer or an array of integers");
+                }
                 
-                json::Value result;
-                result["coefficients"] = math_ops::vector_to_json(coefficients);
-                result["degree"] = degree;
-                result["equation"] = "y = ";
-                
-                // Build equation string
-                std::string equation = "y = ";
-                for (int i = coefficients.size() - 1; i >= 0; i--) {
-                    if (i < (int)coefficients.size() - 1) {
-                        equation += (coefficients[i] >= 0) ? " + " : " - ";
-                        equation += std::to_string(std::abs(coefficients[i]));
-                    } else {
-                        equation += std::to_string(coefficients[i]);
+                std::vector<int> degrees;
+                // Checked before the cast: a degree outside int range is undefined behaviour
+                const double max_degree = std::min(static_cast<double>(x.size()) - 1.0,
+                                                   static_cast<double>(std::numeric_limits<int>::max()));
+                for (double d : math_ops::json_to_vector(degree_val)) {
+                    if (d != std::floor(d) || d < 0.0 || d > max_degree) {
+                        throw std::runtime_error("Degree must be an integer or an array of integers");
                     }
-                    
-                    if (i > 1) {
-                        equation += "x^" + std::to_string(i);
-                    } else if (i == 1) {
-                        equation += "x";
+                    degrees.push_back(static_cast<int>(d));
+                }
+                
+                // QR has no shared accumulation, so each degree is its own fit
+                std::vector<math_ops::Vector> fits;
+                if (method == math_ops::FitMethod::QR) {
+                    for (int degree : degrees) {
+                        fits.push_back(math_ops::polynomial_fit(x, y, degree, method));
                     }
+                } else {
+                    fits = math_ops::polynomial_fit_batch(x, y, degrees);
+                }
+                
+                json::Array fit_results;
+                for (size_t i = 0; i < fits.size(); i++) {
+                    fit_results.push_back(polynomial_to_json(fits[i], degrees[i]));
                 }
                 
-                result["equation"] = equation;
+                json::Value result;
+                result["fits"] = json::Value(std::move(fit_results));
                 return result;
             }
         );
@@ -148,45 +450,252 @@ int main() {
         // Register numerical differentiation tool
         json::Value diff_schema;
         diff_schema["type"] = "object";
-        diff_schema["properties"]["y_values"]["type"] = "array";
+        diff_schema["properties"]["y_values"]["type"] = json::Value(json::Array{"array", "string", "object"});
         diff_schema["properties"]["step_size"]["type"] = "number";
-        diff_schema["required"] = json::Value(json::Array{"y_values", "step_size"});
+        diff_schema["properties"]["x_values"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        diff_schema["properties"]["accuracy"]["type"] = "integer";
+        diff_schema["properties"]["accuracy"]["enum"] = json::Value(json::Array{2, 4, 6});
+        diff_schema["properties"]["store_result"]["type"] = "boolean";
+        diff_schema["required"] = json::Value(json::Array{"y_values"});
         
         server.register_tool("numerical_differentiate",
-            "Compute numerical derivative of discrete data points",
+            "Compute numerical derivative of discrete data points spaced 'step_size' apart, or at "
+            "increasing 'x_values'. 'accuracy' (2, 4 or 6) selects higher-order central stencils "
+            "on a uniform grid and cannot be combined with 'x_values'; without it the ends use "
+            "first-order differences",
             diff_schema,
-            [](const json::Value& params) -> json::Value {
+            [&datasets](const json::Value& params) -> json::Value {
                 if (!params.is_object()) {
                     throw std::runtime_error("Invalid parameters");
                 }
                 
                 const auto& obj = params.as_object();
-                if (obj.find("y_values") == obj.end() || obj.find("step_size") == obj.end()) {
+                bool has_x = obj.find("x_values") != obj.end();
+                double h = 0.0;
+                if (obj.find("y_values") == obj.end() || (!number_argument(obj, "step_size", h) && !has_x)) {
                     throw std::runtime_error("Missing required parameters");
                 }
                 
-                std::vector<double> y = math_ops::json_to_vector(obj.at("y_values"));
+                auto y = datasets.resolve_vector(obj.at("y_values"));
+                
+                math_ops::Vector derivative;
+                json::Value result;
+                if (has_x) {
+                    if (obj.find("accuracy") != obj.end()) {
+                        throw std::runtime_error("'accuracy' applies only to uniform grids (step_size)");
+                    }
+                    auto x = datasets.resolve_vector(obj.at("x_values"));
+                    derivative = math_ops::differentiate(x.vector(), y.vector());
+                } else if (obj.find("accuracy") != obj.end()) {
+                    if (!obj.at("accuracy").is_int()) {
+                        throw std::runtime_error("Accuracy must be an integer");
+                    }
+                    int accuracy = obj.at("accuracy").as_int();
+                    derivative = math_ops::differentiate(y.vector(), h, accuracy);
+                    result["accuracy"] = accuracy;
+                } else {
+                    derivative = math_ops::differentiate_numerical(y.vector(), h);
+                }
                 
-                double h;
-                if (obj.at("step_size").is_double()) {
-                    h = obj.at("step_size").as_double();
-                } else if (obj.at("step_size").is_int()) {
-                    h = obj.at("step_size").as_int();
+                if (flag_argument(obj, "store_result")) {
+                    result["derivative"] = datasets.describe(datasets.put(std::move(derivative)));
                 } else {
-                    throw std::runtime_error("Step size must be a number");
+                    result["derivative"] = math_ops::vector_to_json(derivative);
+                }
+                if (!has_x) {
+                    result["step_size"] = h;
+                }
+                result["points"] = (int)y.vector().size();
+                
+                return result;
+            }
+        );
+        
+        // Register numerical integration tool
+        json::Value integrate_schema;
+        integrate_schema["type"] = "object";
+        integrate_schema["properties"]["y_values"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        integrate_schema["properties"]["step_size"]["type"] = "number";
+        integrate_schema["properties"]["x_values"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        integrate_schema["properties"]["rule"]["type"] = "string";
+        integrate_schema["properties"]["rule"]["enum"] = json::Value(json::Array{"simpson", "trapezoid"});
+        integrate_schema["properties"]["cumulative"]["type"] = "boolean";
+        integrate_schema["properties"]["store_result"]["type"] = "boolean";
+        integrate_schema["required"] = json::Value(json::Array{"y_values"});
+        
+        server.register_tool("integrate",
+            "Integrate discrete data points spaced 'step_size' apart (default 1) or at increasing "
+            "'x_values', with Simpson's rule (default) or the trapezoid rule. 'cumulative' also "
+            "returns the running integral at every point",
+            integrate_schema,
+            [&datasets](const json::Value& params) -> json::Value {
+                if (!params.is_object()) {
+                    throw std::runtime_error("Invalid parameters");
+                }
+                
+                const auto& obj = params.as_object();
+                if (obj.find("y_values") == obj.end()) {
+                    throw std::runtime_error("Missing required parameters");
                 }
                 
-                math_ops::Vector derivative = math_ops::differentiate_numerical(y, h);
+                auto rule = math_ops::IntegrationRule::Simpson;
+                if (obj.find("rule") != obj.end()) {
+                    const auto& rule_val = obj.at("rule");
+                    if (!rule_val.is_string() || (rule_val.as_string() != "simpson" && rule_val.as_string() != "trapezoid")) {
+                        throw std::runtime_error("Rule must be 'simpson' or 'trapezoid'");
+                    }
+                    if (rule_val.as_string() == "trapezoid") {
+                        rule = math_ops::IntegrationRule::Trapezoid;
+                    }
+                }
+                
+                auto y = datasets.resolve_vector(obj.at("y_values"));
+                bool has_x = obj.find("x_values") != obj.end();
+                double h = 1.0;
+                number_argument(obj, "step_size", h);
                 
                 json::Value result;
-                result["derivative"] = math_ops::vector_to_json(derivative);
-                result["step_size"] = h;
-                result["points"] = (int)y.size();
+                if (flag_argument(obj, "cumulative")) {
+                    math_ops::Vector running;
+                    if (has_x) {
+                        auto x = datasets.resolve_vector(obj.at("x_values"));
+                        running = math_ops::cumulative_integral(x.vector(), y.vector(), rule);
+                    } else {
+                        running = math_ops::cumulative_integral(y.vector(), h, rule);
+                    }
+                    result["integral"] = running.back();
+                    if (flag_argument(obj, "store_result")) {
+                        result["cumulative"] = datasets.describe(datasets.put(std::move(running)));
+                    } else {
+                        result["cumulative"] = math_ops::vector_to_json(running);
+                    }
+                } else if (has_x) {
+                    auto x = datasets.resolve_vector(obj.at("x_values"));
+                    result["integral"] = math_ops::integrate(x.vector(), y.vector(), rule);
+                } else {
+                    result["integral"] = math_ops::integrate(y.vector(), h, rule);
+                }
+                
+                result["rule"] = rule == math_ops::IntegrationRule::Simpson ? "simpson" : "trapezoid";
+                if (!has_x) {
+                    result["step_size"] = h;
+                }
+                result["points"] = (int)y.vector().size();
                 
                 return result;
             }
         );
         
+        // Register batched small-matrix tool
+        json::Value batch_schema;
+        batch_schema["type"] = "object";
+        batch_schema["properties"]["operation"]["type"] = "string";
+        batch_schema["properties"]["operation"]["enum"] = json::Value(json::Array{"multiply", "transpose", "determinant"});
+        batch_schema["properties"]["size"]["type"] = "integer";
+        batch_schema["properties"]["size"]["minimum"] = (int)math_ops::kSmallMatrixMin;
+        batch_schema["properties"]["size"]["maximum"] = (int)math_ops::kSmallMatrixMax;
+        batch_schema["properties"]["matrices"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        batch_schema["properties"]["matrices_b"]["type"] = json::Value(json::Array{"array", "string", "object"});
+        batch_schema["properties"]["layout"]["type"] = "string";
+        batch_schema["properties"]["layout"]["enum"] = json::Value(json::Array{"aos", "soa"});
+        batch_schema["properties"]["store_result"]["type"] = "boolean";
+        batch_schema["required"] = json::Value(json::Array{"operation", "size", "matrices"});
+        
+        server.register_tool("batch_small_matrices",
+            "Multiply, transpose or take determinants of many n x n matrices (2 <= n <= 8) in one call. "
+            "'matrices' (and 'matrices_b' for multiply) is a flat array of count*n*n values, one row-major "
+            "matrix after another, or with layout 'soa' element-major: every matrix's (0,0), then every (0,1), ...",
+            batch_schema,
+            [&datasets](const json::Value& params) -> json::Value {
+                if (!params.is_object()) {
+                    throw std::runtime_error("Invalid parameters");
+                }
+                
+                const auto& obj = params.as_object();
+                if (obj.find("operation") == obj.end() || !obj.at("operation").is_string() ||
+                    obj.find("size") == obj.end() || !obj.at("size").is_int() ||
+                    obj.find("matrices") == obj.end()) {
+                    throw std::runtime_error("Missing 'operation', 'size' or 'matrices' parameter");
+                }
+                
+                const std::string& operation = obj.at("operation").as_string();
+                const int size = obj.at("size").as_int();
+                if (size < (int)math_ops::kSmallMatrixMin || size > (int)math_ops::kSmallMatrixMax) {
+                    throw std::runtime_error("Batched matrices must be between 2x2 and 8x8");
+                }
+                const size_t n = size;
+                const size_t elements = n * n;
+                
+                bool soa = false;
+                if (obj.find("layout") != obj.end()) {
+                    const std::string& layout = obj.at("layout").is_string() ? obj.at("layout").as_string() : "";
+                    if (layout != "aos" && layout != "soa") {
+                        throw std::runtime_error("Layout must be 'aos' or 'soa'");
+                    }
+                    soa = layout == "soa";
+                }
+                
+                auto a = datasets.resolve_vector(obj.at("matrices"));
+                const size_t count = a.vector().size() / elements;
+                if (count == 0 || a.vector().size() % elements != 0) {
+                    throw std::runtime_error("'matrices' must hold a whole number of " + std::to_string(n) + "x" +
+                                             std::to_string(n) + " matrices");
+                }
+                
+                // The kernels run on SoA data; AoS inputs are converted on the way in and out
+                auto as_soa = [&](const math_ops::Dataset& d, math_ops::Vector& scratch) {
+                    if (soa) {
+                        return d.vector().data();
+                    }
+                    scratch.resize(d.vector().size());
+                    math_ops::aos_to_soa(elements, count, d.vector().data(), scratch.data());
+                    return static_cast<const double*>(scratch.data());
+                };
+                math_ops::Vector a_scratch, b_scratch;
+                const double* a_soa = as_soa(a, a_scratch);
+                
+                math_ops::Vector result;
+                if (operation == "determinant") {
+                    result.resize(count);
+                    math_ops::batch_determinant_soa(n, count, a_soa, result.data());
+                } else {
+                    math_ops::Vector out(count * elements);
+                    if (operation == "multiply") {
+                        if (obj.find("matrices_b") == obj.end()) {
+                            throw std::runtime_error("Multiply needs 'matrices_b'");
+                        }
+                        auto b = datasets.resolve_vector(obj.at("matrices_b"));
+                        if (b.vector().size() != a.vector().size()) {
+                            throw std::runtime_error("'matrices' and 'matrices_b' must hold the same number of matrices");
+                        }
+                        math_ops::batch_multiply_soa(n, count, a_soa, as_soa(b, b_scratch), out.data());
+                    } else if (operation == "transpose") {
+                        math_ops::batch_transpose_soa(n, count, a_soa, out.data());
+                    } else {
+                        throw std::runtime_error("Unknown operation: " + operation);
+                    }
+                    
+                    if (soa) {
+                        result = std::move(out);
+                    } else {
+                        result.resize(out.size());
+                        math_ops::soa_to_aos(elements, count, out.data(), result.data());
+                    }
+                }
+                
+                json::Value response;
+                response["operation"] = operation;
+                response["size"] = size;
+                response["count"] = (int)count;
+                if (flag_argument(obj, "store_result")) {
+                    response["results"] = datasets.describe(datasets.put(std::move(result)));
+                } else {
+                    response["results"] = math_ops::vector_to_json(result);
+                }
+                return response;
+            }
+        );
+        
         // Run the server
         server.run();
         
@@ -1,99 +1,171 @@
 #include "math_operations.hpp"
+#include "calculus.hpp"
+#include "gemm.hpp"
+#include "parallel.hpp"
+#include "statistics_sketch.hpp"
 #include <algorithm>
 #include <cmath>
 #include <numeric>
 #include <stdexcept>
-#include <map>
+#include <iterator>
+#include <limits>
+#include <utility>
 
 namespace math_ops {
     
-    Statistics calculate_statistics(const std::vector<double>& data) {
+    namespace {
+        
+        // Output names, matching the keys written by statistics_to_json
+        const std::pair<const char*, unsigned> kStatisticNames[] = {
+            {"mean", kStatMean},
+            {"median", kStatMedian},
+            {"mode", kStatMode},
+            {"standard_deviation", kStatStdDev},
+            {"variance", kStatVariance},
+            {"minimum", kStatMin},
+            {"maximum", kStatMax},
+            {"range", kStatRange},
+            {"count", kStatCount},
+        };
+    }
+    
+    Statistics calculate_statistics(VectorView data, unsigned fields) {
         if (data.empty()) {
             throw std::runtime_error("Cannot calculate statistics for empty dataset");
         }
         
         Statistics stats;
+        stats.fields = fields;
         stats.count = data.size();
+        const size_t n = data.size();
+        
+        // Mean, spread and extremes from one parallel pass over the input
+        const bool need_m2 = fields & (kStatVariance | kStatStdDev);
+        const bool need_moments = need_m2 || (fields & (kStatMean | kStatMin | kStatMax | kStatRange));
+        if (need_moments) {
+            constexpr size_t grain = 1 << 18;
+            const size_t chunks = std::min(max_threads(), std::max<size_t>(1, n / grain));
+            std::vector<MomentSummary> partials(chunks);
+            const size_t chunk = (n + chunks - 1) / chunks;
+            parallel_for(chunks, 1, 1, [&](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; c++) {
+                    size_t lo = c * chunk;
+                    size_t hi = std::min(n, lo + chunk);
+                    if (lo < hi) {
+                        partials[c] = summarize_moments(data.data() + lo, hi - lo, need_m2);
+                    }
+                }
+            });
+            
+            MomentSummary total;
+            for (const auto& part : partials) {
+                total.merge(part);
+            }
+            
+            stats.mean = total.mean;
+            stats.variance = total.m2 / n;
+            stats.std_dev = std::sqrt(stats.variance);
+            stats.min = total.min;
+            stats.max = total.max;
+            stats.range = stats.max - stats.min;
+        }
         
-        // Calculate mean
-        stats.mean = std::accumulate(data.begin(), data.end(), 0.0) / data.size();
-        
-        // Calculate variance and standard deviation
-        double variance_sum = 0.0;
-        for (double val : data) {
-            variance_sum += (val - stats.mean) * (val - stats.mean);
+        if (!(fields & (kStatMedian | kStatMode))) {
+            return stats;
         }
-        stats.variance = variance_sum / data.size();
-        stats.std_dev = std::sqrt(stats.variance);
         
-        // Calculate min and max
-        auto minmax = std::minmax_element(data.begin(), data.end());
-        stats.min = *minmax.first;
-        stats.max = *minmax.second;
-        stats.range = stats.max - stats.min;
+        std::vector<double> work(data.begin(), data.end());
         
-        // Calculate median
-        std::vector<double> sorted_data = data;
-        std::sort(sorted_data.begin(), sorted_data.end());
+        if (!(fields & kStatMode)) {
+            // Median alone only needs selection, not a full sort
+            auto mid = work.begin() + n / 2;
+            std::nth_element(work.begin(), mid, work.end());
+            stats.median = *mid;
+            if (n % 2 == 0) {
+                stats.median = (*std::max_element(work.begin(), mid) + *mid) / 2.0;
+            }
+            return stats;
+        }
         
-        if (sorted_data.size() % 2 == 0) {
-            stats.median = (sorted_data[sorted_data.size()/2 - 1] + sorted_data[sorted_data.size()/2]) / 2.0;
+        // Mode by counting runs of the sorted copy, which also yields the median;
+        // ties go to the smallest value
+        std::sort(work.begin(), work.end());
+        if (n % 2 == 0) {
+            stats.median = (work[n / 2 - 1] + work[n / 2]) / 2.0;
         } else {
-            stats.median = sorted_data[sorted_data.size()/2];
+            stats.median = work[n / 2];
         }
         
-        // Calculate mode (most frequent value)
-        std::map<double, int> frequency;
-        for (double val : data) {
-            frequency[val]++;
+        size_t best_count = 0;
+        for (size_t i = 0; i < n;) {
+            size_t j = i + 1;
+            while (j < n && work[j] == work[i]) j++;
+            if (j - i > best_count) {
+                best_count = j - i;
+                stats.mode = work[i];
+            }
+            i = j;
         }
         
-        auto max_freq = std::max_element(frequency.begin(), frequency.end(),
-            [](const auto& a, const auto& b) { return a.second < b.second; });
-        stats.mode = max_freq->first;
-        
         return stats;
     }
     
-    Matrix multiply_matrices(const Matrix& a, const Matrix& b) {
-        if (a.empty() || b.empty() || a[0].size() != b.size()) {
-            throw std::runtime_error("Invalid matrix dimensions for multiplication");
+    unsigned statistics_fields_from_json(const json::Value& names) {
+        if (!names.is_array()) {
+            throw std::runtime_error("Expected an array of statistic names");
         }
         
-        size_t rows = a.size();
-        size_t cols = b[0].size();
-        size_t inner = a[0].size();
-        
-        Matrix result(rows, Vector(cols, 0.0));
-        
-        for (size_t i = 0; i < rows; i++) {
-            for (size_t j = 0; j < cols; j++) {
-                for (size_t k = 0; k < inner; k++) {
-                    result[i][j] += a[i][k] * b[k][j];
+        unsigned fields = 0;
+        for (const auto& name : names.as_array()) {
+            if (!name.is_string()) {
+                throw std::runtime_error("Expected an array of statistic names");
+            }
+            unsigned flag = 0;
+            for (const auto& [key, value] : kStatisticNames) {
+                if (name.as_string() == key) {
+                    flag = value;
+                    break;
                 }
             }
+            if (flag == 0) {
+                throw std::runtime_error("Unknown statistic: " + name.as_string());
+            }
+            fields |= flag;
+        }
+        return fields;
+    }
+    
+    Matrix multiply_matrices(MatrixView a, MatrixView b) {
+        if (a.empty() || b.empty() || a.cols() != b.rows()) {
+            throw std::runtime_error("Invalid matrix dimensions for multiplication");
         }
         
+        Matrix result(a.rows(), b.cols());
+        gemm(a.rows(), b.cols(), a.cols(), 1.0, a.data(), a.stride(), b.data(), b.stride(),
+             0.0, result.data(), result.stride());
         return result;
     }
     
-    Vector multiply_matrix_vector(const Matrix& m, const Vector& v) {
-        if (m.empty() || m[0].size() != v.size()) {
+    Vector multiply_matrix_vector(MatrixView m, VectorView v) {
+        if (m.empty() || m.cols() != v.size()) {
             throw std::runtime_error("Invalid dimensions for matrix-vector multiplication");
         }
         
-        Vector result(m.size(), 0.0);
+        Vector result(m.rows(), 0.0);
         
-        for (size_t i = 0; i < m.size(); i++) {
+        for (size_t i = 0; i < m.rows(); i++) {
+            const double* row = m.row(i);
+            double sum = 0.0;
             for (size_t j = 0; j < v.size(); j++) {
-                result[i] += m[i][j] * v[j];
+                sum += row[j] * v[j];
             }
+            result[i] = sum;
         }
         
         return result;
     }
     
-    double dot_product(const Vector& a, const Vector& b) {
+    double dot_product(VectorView a, VectorView b) {
         if (a.size() != b.size()) {
             throw std::runtime_error("Vectors must have same size for dot product");
         }
@@ -106,80 +178,200 @@ namespace math_ops {
         return result;
     }
     
-    Matrix transpose(const Matrix& m) {
+    Matrix transpose(MatrixView m) {
         if (m.empty()) {
             return Matrix();
         }
         
-        size_t rows = m[0].size();
-        size_t cols = m.size();
-        
-        Matrix result(rows, Vector(cols));
-        
-        for (size_t i = 0; i < rows; i++) {
-            for (size_t j = 0; j < cols; j++) {
-                result[i][j] = m[j][i];
+        Matrix result(m.cols(), m.rows());
+        
+        // Tile so both the reads and the writes stay within a few cache lines
+        constexpr size_t tile = 32;
+        for (size_t i0 = 0; i0 < m.rows(); i0 += tile) {
+            size_t i1 = std::min(m.rows(), i0 + tile);
+            for (size_t j0 = 0; j0 < m.cols(); j0 += tile) {
+                size_t j1 = std::min(m.cols(), j0 + tile);
+                for (size_t i = i0; i < i1; i++) {
+                    const double* src = m.row(i);
+                    for (size_t j = j0; j < j1; j++) {
+                        result(j, i) = src[j];
+                    }
+                }
             }
         }
         
         return result;
     }
     
-    double determinant(const Matrix& m) {
-        if (m.empty() || m.size() != m[0].size()) {
-            throw std::runtime_error("Matrix must be square for determinant");
-        }
+    namespace {
         
-        size_t n = m.size();
+        // Panel width for the blocked factorization; below twice this the
+        // unblocked loop is faster
+        constexpr size_t kLuBlock = 64;
         
-        if (n == 1) {
-            return m[0][0];
+        void swap_rows(MutableMatrixView a, size_t r1, size_t r2) {
+            if (r1 != r2) {
+                std::swap_ranges(a.row(r1), a.row(r1) + a.cols(), a.row(r2));
+            }
         }
         
-        if (n == 2) {
-            return m[0][0] * m[1][1] - m[0][1] * m[1][0];
+        // Factors columns [col0, col1) of rows [col0, n). Pivot rows are
+        // swapped across the full width so earlier L columns and the trailing
+        // block stay consistent. Eliminates only inside the panel unless
+        // col1 == n.
+        int lu_panel(MutableMatrixView a, size_t col0, size_t col1, std::vector<size_t>& pivots) {
+            const size_t n = a.rows();
+            int sign = 1;
+            
+            for (size_t j = col0; j < col1; j++) {
+                size_t pivot = j;
+                double pivot_abs = std::fabs(a(j, j));
+                for (size_t i = j + 1; i < n; i++) {
+                    double v = std::fabs(a(i, j));
+                    if (v > pivot_abs) {
+                        pivot_abs = v;
+                        pivot = i;
+                    }
+                }
+                
+                pivots[j] = pivot;
+                if (pivot != j) {
+                    swap_rows(a, j, pivot);
+                    sign = -sign;
+                }
+                if (pivot_abs == 0.0) {
+                    continue; // Singular column, nothing to eliminate
+                }
+                
+                const double* pivot_row = a.row(j);
+                const double inv = 1.0 / pivot_row[j];
+                for (size_t i = j + 1; i < n; i++) {
+                    double* row = a.row(i);
+                    double l = row[j] * inv;
+                    row[j] = l;
+                    if (l == 0.0) continue;
+                    for (size_t c = j + 1; c < col1; c++) {
+                        row[c] -= l * pivot_row[c];
+                    }
+                }
+            }
+            
+            return sign;
+        }
+    }
+    
+    int lu_factor(MutableMatrixView a, std::vector<size_t>& pivots) {
+        if (!a.is_square()) {
+            throw std::runtime_error("LU factorization requires a square matrix");
         }
         
-        // For larger matrices, use cofactor expansion
-        double det = 0.0;
-        for (size_t j = 0; j < n; j++) {
-            // Create minor matrix
-            Matrix minor(n-1, Vector(n-1));
-            for (size_t r = 1; r < n; r++) {
-                for (size_t c = 0, mc = 0; c < n; c++) {
-                    if (c != j) {
-                        minor[r-1][mc] = m[r][c];
-                        mc++;
+        const size_t n = a.rows();
+        pivots.resize(n);
+        
+        if (n < 2 * kLuBlock) {
+            return lu_panel(a, 0, n, pivots);
+        }
+        
+        int sign = 1;
+        for (size_t k0 = 0; k0 < n; k0 += kLuBlock) {
+            const size_t kb = std::min(kLuBlock, n - k0);
+            const size_t k1 = k0 + kb;
+            
+            sign *= lu_panel(a, k0, k1, pivots);
+            if (k1 == n) break;
+            
+            // U12 = L11^-1 * A12 (unit lower triangular solve, row by row)
+            const size_t trailing = n - k1;
+            for (size_t i = k0 + 1; i < k1; i++) {
+                double* row = a.row(i) + k1;
+                for (size_t p = k0; p < i; p++) {
+                    double l = a(i, p);
+                    if (l == 0.0) continue;
+                    const double* src = a.row(p) + k1;
+                    for (size_t c = 0; c < trailing; c++) {
+                        row[c] -= l * src[c];
                     }
                 }
             }
             
-            double sign = (j % 2 == 0) ? 1.0 : -1.0;
-            det += sign * m[0][j] * determinant(minor);
+            // A22 -= L21 * U12
+            gemm(trailing, trailing, kb, -1.0,
+                 a.row(k1) + k0, a.stride(),
+                 a.row(k0) + k1, a.stride(),
+                 1.0, a.row(k1) + k1, a.stride());
         }
         
-        return det;
+        return sign;
     }
     
-    double integrate_simpson(const std::vector<double>& y_values, double h) {
-        if (y_values.size() < 3 || y_values.size() % 2 == 0) {
-            throw std::runtime_error("Simpson's rule requires odd number of points >= 3");
+    void lu_solve(MatrixView lu, const std::vector<size_t>& pivots, Vector& b) {
+        const size_t n = lu.rows();
+        if (b.size() != n || pivots.size() != n) {
+            throw std::runtime_error("Invalid dimensions for LU solve");
+        }
+        
+        for (size_t i = 0; i < n; i++) {
+            std::swap(b[i], b[pivots[i]]);
         }
         
-        double result = y_values[0] + y_values[y_values.size() - 1];
+        // Forward substitution with the unit lower factor
+        for (size_t i = 1; i < n; i++) {
+            const double* row = lu.row(i);
+            double sum = b[i];
+            for (size_t j = 0; j < i; j++) {
+                sum -= row[j] * b[j];
+            }
+            b[i] = sum;
+        }
         
-        for (size_t i = 1; i < y_values.size() - 1; i++) {
-            if (i % 2 == 1) {
-                result += 4 * y_values[i];
-            } else {
-                result += 2 * y_values[i];
+        // Back substitution with the upper factor
+        for (size_t i = n; i-- > 0;) {
+            const double* row = lu.row(i);
+            double sum = b[i];
+            for (size_t j = i + 1; j < n; j++) {
+                sum -= row[j] * b[j];
+            }
+            if (row[i] == 0.0) {
+                throw std::runtime_error("Singular matrix in LU solve");
+            }
+            b[i] = sum / row[i];
+        }
+    }
+    
+    double determinant(MatrixView m) {
+        if (m.empty() || !m.is_square()) {
+            throw std::runtime_error("Matrix must be square for determinant");
+        }
+        
+        Matrix lu = Matrix::from_view(m);
+        std::vector<size_t> pivots;
+        int sign = lu_factor(lu.view(), pivots);
+        
+        // Multiply the pivots as mantissa/exponent pairs so large matrices do
+        // not overflow or underflow before the final result
+        double mantissa = sign;
+        long exponent = 0;
+        for (size_t i = 0; i < lu.rows(); i++) {
+            int e = 0;
+            mantissa = std::frexp(mantissa * lu(i, i), &e);
+            exponent += e;
+            if (mantissa == 0.0) {
+                return 0.0;
             }
         }
         
-        return result * h / 3.0;
+        exponent = std::clamp(exponent, -100000L, 100000L);
+        return std::ldexp(mantissa, static_cast<int>(exponent));
+    }
+    
+    double integrate_simpson(VectorView y_values, double h) {
+        if (y_values.size() < 3 || y_values.size() % 2 == 0) {
+            throw std::runtime_error("Simpson's rule requires odd number of points >= 3");
+        }
+        return integrate(y_values, h, IntegrationRule::Simpson);
     }
     
-    Vector differentiate_numerical(const std::vector<double>& y_values, double h) {
+    Vector differentiate_numerical(VectorView y_values, double h) {
         if (y_values.size() < 2) {
             throw std::runtime_error("Need at least 2 points for differentiation");
         }
@@ -189,10 +381,13 @@ namespace math_ops {
         // Forward difference for first point
         result[0] = (y_values[1] - y_values[0]) / h;
         
-        // Central difference for middle points
-        for (size_t i = 1; i < y_values.size() - 1; i++) {
-            result[i] = (y_values[i+1] - y_values[i-1]) / (2.0 * h);
-        }
+        // Central difference for middle points, split across threads for
+        // long signals
+        parallel_for(y_values.size() - 2, 1 << 18, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin + 1; i < end + 1; i++) {
+                result[i] = (y_values[i+1] - y_values[i-1]) / (2.0 * h);
+            }
+        });
         
         // Backward difference for last point
         result[y_values.size() - 1] = (y_values[y_values.size() - 1] - y_values[y_values.size() - 2]) / h;
@@ -200,94 +395,264 @@ namespace math_ops {
         return result;
     }
     
-    std::vector<double> polynomial_fit(const std::vector<double>& x, const std::vector<double>& y, int degree) {
-        if (x.size() != y.size() || x.size() < degree + 1) {
-            throw std::runtime_error("Insufficient data points for polynomial fit");
+    namespace {
+        
+        // Affine map x -> (x - center) / scale onto [-1, 1]
+        struct FitScaling {
+            double center = 0.0;
+            double scale = 1.0;
+        };
+        
+        FitScaling fit_scaling(VectorView x) {
+            auto minmax = std::minmax_element(x.begin(), x.end());
+            FitScaling scaling;
+            scaling.center = 0.5 * (*minmax.first + *minmax.second);
+            double half_range = 0.5 * (*minmax.second - *minmax.first);
+            scaling.scale = half_range > 0.0 ? half_range : 1.0;
+            return scaling;
         }
         
-        size_t n = x.size();
-        size_t m = degree + 1;
-        
-        // Create Vandermonde matrix
-        Matrix A(n, Vector(m));
-        for (size_t i = 0; i < n; i++) {
-            for (size_t j = 0; j < m; j++) {
-                A[i][j] = std::pow(x[i], j);
+        void check_fit_input(VectorView x, VectorView y, int degree) {
+            if (degree < 0) {
+                throw std::runtime_error("Polynomial degree must be non-negative");
+            }
+            if (x.size() != y.size() || x.size() < static_cast<size_t>(degree) + 1) {
+                throw std::runtime_error("Insufficient data points for polynomial fit");
             }
         }
         
-        // Solve normal equations: (A^T * A) * coeffs = A^T * y
-        Matrix At = transpose(A);
-        Matrix AtA = multiply_matrices(At, A);
-        Vector Aty = multiply_matrix_vector(At, y);
+        // Rewrites coefficients of p(t), t = (x - center) / scale, as
+        // coefficients of x by Horner composition with the linear map
+        Vector unscale_coefficients(const Vector& a, const FitScaling& scaling) {
+            const double inv = 1.0 / scaling.scale;
+            const double shift = -scaling.center * inv;
+            
+            Vector result(a.size(), 0.0);
+            for (size_t k = a.size(); k-- > 0;) {
+                // result = result * (inv * x + shift) + a[k]
+                for (size_t j = a.size() - 1; j > 0; j--) {
+                    result[j] = result[j] * shift + result[j - 1] * inv;
+                }
+                result[0] = result[0] * shift + a[k];
+            }
+            return result;
+        }
         
-        // Simple Gaussian elimination for square system
-        std::vector<double> coeffs(m);
-        Matrix augmented(m, Vector(m + 1));
+        // Power sums of the scaled abscissae: s[k] = sum t^k for k <= 2d and
+        // r[k] = sum t^k y for k <= d. Samples are processed in cache-sized
+        // blocks with the running powers kept in a small buffer, so every
+        // inner loop is a contiguous, vectorizable sweep.
+        void accumulate_power_sums(VectorView x, VectorView y,
+                                   const FitScaling& scaling, size_t max_degree,
+                                   Vector& s, Vector& r) {
+            constexpr size_t block = 256;
+            const double inv = 1.0 / scaling.scale;
+            
+            s.assign(2 * max_degree + 1, 0.0);
+            r.assign(max_degree + 1, 0.0);
+            
+            double t[block];
+            double power[block];
+            for (size_t i0 = 0; i0 < x.size(); i0 += block) {
+                const size_t len = std::min(block, x.size() - i0);
+                const double* yb = y.data() + i0;
+                for (size_t i = 0; i < len; i++) {
+                    t[i] = (x[i0 + i] - scaling.center) * inv;
+                    power[i] = 1.0;
+                }
+                
+                for (size_t k = 0; k <= 2 * max_degree; k++) {
+                    double sum = 0.0;
+                    double weighted = 0.0;
+                    for (size_t i = 0; i < len; i++) {
+                        sum += power[i];
+                        weighted += power[i] * yb[i];
+                    }
+                    s[k] += sum;
+                    if (k <= max_degree) {
+                        r[k] += weighted;
+                    }
+                    for (size_t i = 0; i < len; i++) {
+                        power[i] *= t[i];
+                    }
+                }
+            }
+        }
         
-        for (size_t i = 0; i < m; i++) {
-            for (size_t j = 0; j < m; j++) {
-                augmented[i][j] = AtA[i][j];
+        // Solves the (d+1)x(d+1) Hankel normal equations built from the power sums
+        Vector solve_normal_equations(const Vector& s, const Vector& r, size_t degree) {
+            const size_t m = degree + 1;
+            Matrix normal(m, m);
+            for (size_t i = 0; i < m; i++) {
+                for (size_t j = 0; j < m; j++) {
+                    normal(i, j) = s[i + j];
+                }
+            }
+            
+            Vector coeffs(r.begin(), r.begin() + m);
+            std::vector<size_t> pivots;
+            lu_factor(normal.view(), pivots);
+            for (size_t i = 0; i < m; i++) {
+                if (normal(i, i) == 0.0) {
+                    throw std::runtime_error("Data does not determine a unique polynomial of this degree");
+                }
             }
-            augmented[i][m] = Aty[i];
+            lu_solve(normal, pivots, coeffs);
+            return coeffs;
         }
         
-        // Forward elimination
-        for (size_t i = 0; i < m; i++) {
-            for (size_t k = i + 1; k < m; k++) {
-                if (augmented[i][i] != 0) {
-                    double factor = augmented[k][i] / augmented[i][i];
-                    for (size_t j = i; j < m + 1; j++) {
-                        augmented[k][j] -= factor * augmented[i][j];
+        // Householder QR least squares on the scaled Vandermonde matrix
+        Vector solve_qr(VectorView x, VectorView y,
+                        const FitScaling& scaling, size_t degree) {
+            const size_t n = x.size();
+            const size_t m = degree + 1;
+            const double inv = 1.0 / scaling.scale;
+            
+            // Vandermonde columns by repeated multiplication instead of pow
+            Matrix a(n, m);
+            Vector b(y.begin(), y.end());
+            for (size_t i = 0; i < n; i++) {
+                double t = (x[i] - scaling.center) * inv;
+                double* row = a.row(i);
+                double p = 1.0;
+                for (size_t j = 0; j < m; j++) {
+                    row[j] = p;
+                    p *= t;
+                }
+            }
+            
+            Vector v(n);
+            Vector dots(m + 1);
+            for (size_t j = 0; j < m; j++) {
+                double norm = 0.0;
+                for (size_t i = j; i < n; i++) {
+                    norm += a(i, j) * a(i, j);
+                }
+                norm = std::sqrt(norm);
+                if (norm == 0.0) {
+                    throw std::runtime_error("Data does not determine a unique polynomial of this degree");
+                }
+                
+                // v = a[j:, j] + sign * |a[j:, j]| e_1, reflector H = I - 2 v v^T / v^T v
+                const double alpha = a(j, j) > 0.0 ? -norm : norm;
+                double vnorm = 0.0;
+                for (size_t i = j; i < n; i++) {
+                    v[i] = a(i, j);
+                }
+                v[j] -= alpha;
+                for (size_t i = j; i < n; i++) {
+                    vnorm += v[i] * v[i];
+                }
+                const double tau = 2.0 / vnorm;
+                
+                // Apply H to the trailing columns and to b, sweeping rows so
+                // the row-major storage is read contiguously
+                std::fill(dots.begin(), dots.end(), 0.0);
+                for (size_t i = j; i < n; i++) {
+                    const double* row = a.row(i);
+                    for (size_t c = j + 1; c < m; c++) {
+                        dots[c] += v[i] * row[c];
+                    }
+                    dots[m] += v[i] * b[i];
+                }
+                for (size_t i = j; i < n; i++) {
+                    double* row = a.row(i);
+                    const double f = tau * v[i];
+                    for (size_t c = j + 1; c < m; c++) {
+                        row[c] -= f * dots[c];
                     }
+                    b[i] -= f * dots[m];
                 }
+                a(j, j) = alpha;
             }
+            
+            // Back substitution with R
+            Vector coeffs(m);
+            for (size_t i = m; i-- > 0;) {
+                double sum = b[i];
+                for (size_t j = i + 1; j < m; j++) {
+                    sum -= a(i, j) * coeffs[j];
+                }
+                coeffs[i] = sum / a(i, i);
+            }
+            return coeffs;
+        }
+    }
+    
+    std::vector<double> polynomial_fit(VectorView x, VectorView y, int degree,
+                                       FitMethod method) {
+        check_fit_input(x, y, degree);
+        
+        FitScaling scaling = fit_scaling(x);
+        if (method == FitMethod::QR) {
+            return unscale_coefficients(solve_qr(x, y, scaling, degree), scaling);
         }
         
-        // Back substitution
-        for (int i = m - 1; i >= 0; i--) {
-            coeffs[i] = augmented[i][m];
-            for (size_t j = i + 1; j < m; j++) {
-                coeffs[i] -= augmented[i][j] * coeffs[j];
-            }
-            coeffs[i] /= augmented[i][i];
+        Vector s, r;
+        accumulate_power_sums(x, y, scaling, degree, s, r);
+        return unscale_coefficients(solve_normal_equations(s, r, degree), scaling);
+    }
+    
+    std::vector<Vector> polynomial_fit_batch(VectorView x, VectorView y,
+                                             const std::vector<int>& degrees) {
+        if (degrees.empty()) {
+            throw std::runtime_error("No polynomial degrees requested");
+        }
+        
+        int max_degree = *std::max_element(degrees.begin(), degrees.end());
+        for (int degree : degrees) {
+            check_fit_input(x, y, degree);
         }
         
-        return coeffs;
+        // The sums for the largest degree contain those of every smaller one
+        FitScaling scaling = fit_scaling(x);
+        Vector s, r;
+        accumulate_power_sums(x, y, scaling, max_degree, s, r);
+        
+        std::vector<Vector> fits;
+        fits.reserve(degrees.size());
+        for (int degree : degrees) {
+            fits.push_back(unscale_coefficients(solve_normal_equations(s, r, degree), scaling));
+        }
+        return fits;
     }
     
     json::Value statistics_to_json(const Statistics& stats) {
-        json::Value result;
-        result["mean"] = stats.mean;
-        result["median"] = stats.median;
-        result["mode"] = stats.mode;
-        result["standard_deviation"] = stats.std_dev;
-        result["variance"] = stats.variance;
-        result["minimum"] = stats.min;
-        result["maximum"] = stats.max;
-        result["range"] = stats.range;
-        result["count"] = (int)stats.count;
+        const double values[] = {
+            stats.mean, stats.median, stats.mode, stats.std_dev, stats.variance,
+            stats.min, stats.max, stats.range,
+        };
+        
+        json::Value result = json::Value(json::Object{});
+        for (size_t i = 0; i < std::size(values); i++) {
+            if (stats.fields & kStatisticNames[i].second) {
+                result[kStatisticNames[i].first] = values[i];
+            }
+        }
+        if (stats.fields & kStatCount) {
+            result["count"] = count_to_json(stats.count);
+        }
         return result;
     }
     
-    json::Value matrix_to_json(const Matrix& m) {
-        json::Array result;
-        for (const auto& row : m) {
-            json::Array json_row;
-            for (double val : row) {
-                json_row.push_back(json::Value(val));
-            }
-            result.push_back(json::Value(json_row));
+    json::Value count_to_json(uint64_t count) {
+        if (count <= static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+            return json::Value(static_cast<int>(count));
         }
-        return json::Value(result);
+        return json::Value(static_cast<double>(count));
     }
     
-    json::Value vector_to_json(const Vector& v) {
+    json::Value matrix_to_json(MatrixView m) {
         json::Array result;
-        for (double val : v) {
-            result.push_back(json::Value(val));
+        result.reserve(m.rows());
+        for (size_t i = 0; i < m.rows(); i++) {
+            result.emplace_back(json::NumberArray(m.row(i), m.row(i) + m.cols()));
         }
-        return json::Value(result);
+        return json::Value(std::move(result));
+    }
+    
+    json::Value vector_to_json(VectorView v) {
+        return json::Value(json::NumberArray(v.begin(), v.end()));
     }
     
     Matrix json_to_matrix(const json::Value& json_val) {
@@ -295,34 +660,59 @@ namespace math_ops {
             throw std::runtime_error("Expected array for matrix");
         }
         
-        Matrix result;
-        for (const auto& row_val : json_val.as_array()) {
-            if (!row_val.is_array()) {
-                throw std::runtime_error("Expected array for matrix row");
+        const auto& rows = json_val.as_array();
+        if (rows.empty()) {
+            return Matrix();
+        }
+        
+        // Size the buffer from the first row, then copy every row straight in
+        auto row_length = [](const json::Value& row_val) -> size_t {
+            if (row_val.is_number_array()) return row_val.as_number_array().size();
+            if (row_val.is_array()) return row_val.as_array().size();
+            throw std::runtime_error("Expected array for matrix row");
+        };
+        
+        const size_t cols = row_length(rows[0]);
+        Matrix result(rows.size(), cols);
+        for (size_t i = 0; i < rows.size(); i++) {
+            const auto& row_val = rows[i];
+            if (row_length(row_val) != cols) {
+                throw std::runtime_error("Matrix rows must have equal length");
+            }
+            
+            double* dst = result.row(i);
+            if (row_val.is_number_array()) {
+                const auto& row = row_val.as_number_array();
+                std::copy(row.begin(), row.end(), dst);
+                continue;
             }
             
-            Vector row;
             for (const auto& val : row_val.as_array()) {
                 if (val.is_int()) {
-                    row.push_back(val.as_int());
+                    *dst++ = val.as_int();
                 } else if (val.is_double()) {
-                    row.push_back(val.as_double());
+                    *dst++ = val.as_double();
                 } else {
                     throw std::runtime_error("Expected numeric value in matrix");
                 }
             }
-            result.push_back(row);
         }
         
         return result;
     }
     
     Vector json_to_vector(const json::Value& json_val) {
+        if (json_val.is_number_array()) {
+            const auto& values = json_val.as_number_array();
+            return Vector(values.begin(), values.end());
+        }
+        
         if (!json_val.is_array()) {
             throw std::runtime_error("Expected array for vector");
         }
         
         Vector result;
+        result.reserve(json_val.as_array().size());
         for (const auto& val : json_val.as_array()) {
             if (val.is_int()) {
                 result.push_back(val.as_int());
@@ -0,0 +1,25 @@
+#include "matrix.hpp"
+#include <algorithm>
+
+namespace math_ops {
+    
+    Matrix::Matrix(std::initializer_list<std::initializer_list<double>> rows)
+        : rows_(rows.size()), cols_(rows.size() ? rows.begin()->size() : 0) {
+        data_.reserve(rows_ * cols_);
+        for (const auto& row : rows) {
+            if (row.size() != cols_) {
+                throw std::runtime_error("Matrix rows must have equal length");
+            }
+            data_.insert(data_.end(), row.begin(), row.end());
+        }
+    }
+    
+    Matrix Matrix::from_view(MatrixView view) {
+        Matrix result(view.rows(), view.cols());
+        for (size_t i = 0; i < view.rows(); i++) {
+            std::copy(view.row(i), view.row(i) + view.cols(), result.row(i));
+        }
+        return result;
+    }
+    
+}
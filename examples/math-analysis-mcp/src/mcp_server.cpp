@@ -1,39 +1,540 @@
 #include "mcp_server.hpp"
+#include "cbor.hpp"
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace mcp {
     
-    Server::Server(const std::string& name, const std::string& version) 
-        : server_name_(name), server_version_(version), initialized_(false) {}
+    namespace {
+        
+        // Buffered serial-mode output is flushed at least this often
+        constexpr size_t kFlushThreshold = 1 << 16;
+        
+        // Batch requests arrive as arrays; the parser packs all-number arrays,
+        // which are batches of invalid entries
+        bool take_batch(json::Value& request, json::Array& entries) {
+            if (request.is_array()) {
+                entries = std::move(request.as_array());
+                return true;
+            }
+            if (request.is_number_array()) {
+                for (double v : request.as_number_array()) {
+                    entries.emplace_back(v);
+                }
+                return true;
+            }
+            return false;
+        }
+        
+        // True when initialize params carry
+        // capabilities.experimental.transport.encoding == "cbor"
+        bool client_requests_cbor(const json::Value& params) {
+            const json::Value* node = &params;
+            for (const char* key : {"capabilities", "experimental", "transport"}) {
+                if (!node->is_object()) return false;
+                auto it = node->as_object().find(key);
+                if (it == node->as_object().end()) return false;
+                node = &it->second;
+            }
+            if (!node->is_object()) return false;
+            auto it = node->as_object().find("encoding");
+            return it != node->as_object().end() && it->second.is_string() && it->second.as_string() == "cbor";
+        }
+    }
+    
+    Server::Server(const std::string& name, const std::string& version, const ServerOptions& options) 
+        : server_name_(name), server_version_(version), options_(options), initialized_(false),
+          transport_(Transport::JsonLines), requested_transport_(Transport::JsonLines),
+          started_(std::chrono::steady_clock::now()) {}
     
     void Server::register_tool(const std::string& name, const std::string& description, 
-                              const json::Value& input_schema, ToolHandler handler) {
+                              const json::Value& input_schema, ToolHandler handler,
+                              const ToolOptions& options) {
         tool_handlers_[name] = handler;
         tool_descriptions_[name] = description;
         tool_schemas_[name] = input_schema;
+        tool_options_[name] = options;
+        tool_metrics_[name] = std::make_unique<EndpointMetrics>();
+        if (options.max_concurrency > 0) {
+            tool_slots_[name].limit = options.max_concurrency;
+        }
     }
     
     void Server::run() {
-        std::string line;
-        while (std::getline(std::cin, line)) {
-            if (line.empty()) continue;
+        // Private stream buffers: output is written in batches and in_avail()
+        // can tell whether more input is already waiting. cin is untied so
+        // reads neither flush cout nor touch it from the reader thread while
+        // the writer thread is using it.
+        std::ios::sync_with_stdio(false);
+        std::cin.tie(nullptr);
+        
+        if (options_.worker_threads > 0) {
+            run_concurrent();
+        } else {
+            run_serial();
+        }
+        
+        if (options_.dump_metrics) {
+            std::cerr << json::stringify(handle_metrics()) << std::endl;
+        }
+    }
+    
+    void Server::run_serial() {
+        std::string message;
+        output_buffer_.clear();
+        while (read_message(message)) {
+            process_message(message, output_buffer_);
+            apply_requested_transport();
             
+            // Hold responses while the client has more requests queued
+            if (std::cin.rdbuf()->in_avail() <= 0 || output_buffer_.size() >= kFlushThreshold) {
+                write_output(output_buffer_, true);
+                output_buffer_.clear();
+            }
+        }
+        write_output(output_buffer_, true);
+    }
+    
+    void Server::run_concurrent() {
+        WorkQueue<Job> jobs(options_.queue_capacity);
+        // Unbounded so workers never stall behind a slow client
+        WorkQueue<std::string> responses;
+        
+        // Single writer: responses go out in completion order, matched by id,
+        // and the stream is flushed whenever the queue runs dry
+        std::thread writer([&] {
+            std::string data;
+            while (responses.pop(data)) {
+                write_output(data, responses.empty());
+            }
+            std::cout.flush();
+        });
+        
+        std::vector<std::thread> workers;
+        workers.reserve(options_.worker_threads);
+        for (size_t i = 0; i < options_.worker_threads; i++) {
+            workers.emplace_back([&] {
+                Job job;
+                while (jobs.pop(job)) {
+                    execute_job(std::move(job), jobs, responses);
+                }
+            });
+        }
+        
+        std::string message;
+        while (read_message(message)) {
+            // Everything up to the initialize handshake is handled inline so
+            // later requests never race ahead of it or of a transport switch
+            if (!initialized_) {
+                std::string out;
+                if (process_message(message, out)) {
+                    responses.push(std::move(out));
+                }
+                apply_requested_transport();
+                continue;
+            }
+            
+            Job job;
+            job.message = std::move(message);
+            job.received = std::chrono::steady_clock::now();
+            jobs.push(std::move(job));
+        }
+        
+        jobs.close();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        responses.close();
+        writer.join();
+    }
+    
+    void Server::execute_job(Job job, WorkQueue<Job>& jobs, WorkQueue<std::string>& responses) {
+        if (!job.parsed) {
+            job.trace.bytes_in = job.message.size();
+            update_max(peak_request_bytes_, job.message.size());
+            // The tree may be handed to other workers (batch entries, calls
+            // waiting for a tool slot), so it goes into an arena of its own
+            job.arena = acquire_arena();
+            json::ArenaScope parse_scope(*job.arena);
+            parse_scope.keep();
+            auto parse_start = std::chrono::steady_clock::now();
             try {
-                json::Value request = json::parse(line);
-                json::Value response = handle_request(request);
+                job.request = decode_message(job.message);
+                job.parsed = true;
+                job.trace.parse_ns = elapsed_ns(parse_start);
+            } catch (const std::exception& e) {
+                job.trace.parse_ns = elapsed_ns(parse_start);
+                std::string out;
+                finish_response(job.trace, create_error_response(-32700, "Parse error", json::Value()), out);
+                responses.push(std::move(out));
+                return;
+            }
+            std::string().swap(job.message);
+            
+            json::Array entries;
+            if (take_batch(job.request, entries)) {
+                record_batch(job.trace);
+                dispatch_batch(std::move(entries), job.arena, jobs, responses);
+                return;
+            }
+        }
+        
+        ToolSlots* slots = find_tool_slots(job.request);
+        if (slots) {
+            std::lock_guard<std::mutex> lock(tool_slots_mutex_);
+            if (slots->active >= slots->limit) {
+                slots->waiting.push_back(std::move(job));
+                return;
+            }
+            slots->active++;
+        }
+        
+        while (true) {
+            // Time since the reader handed the job over, less its own parse
+            job.trace.queued = true;
+            job.trace.queue_ns = elapsed_ns(job.received) - job.trace.parse_ns;
+            
+            // The response tree and handler temporaries live in this thread's
+            // arena until the response is encoded
+            {
+                json::ArenaScope scope(json::thread_arena());
+                json::Value response = handle_request(job.request, job.trace);
+                job.trace.arena_bytes = scope.used() + (job.arena ? job.arena->used() : 0);
+                if (job.batch) {
+                    finish_batch_entry(job, response, responses);
+                } else {
+                    std::string out;
+                    if (finish_response(job.trace, response, out)) {
+                        responses.push(std::move(out));
+                    }
+                }
+            }
+            if (!slots) {
+                return;
+            }
+            
+            // Hand the slot straight to the next waiting call of the same tool
+            std::lock_guard<std::mutex> lock(tool_slots_mutex_);
+            if (slots->waiting.empty()) {
+                slots->active--;
+                return;
+            }
+            job = std::move(slots->waiting.front());
+            slots->waiting.pop_front();
+        }
+    }
+    
+    void Server::dispatch_batch(json::Array entries, const std::shared_ptr<json::Arena>& arena,
+                                WorkQueue<Job>& jobs, WorkQueue<std::string>& responses) {
+        if (entries.empty()) {
+            std::string out;
+            serialize_response(create_error_response(-32600, "Invalid Request", json::Value()), out);
+            responses.push(std::move(out));
+            return;
+        }
+        
+        auto batch = std::make_shared<Batch>();
+        batch->responses.resize(entries.size());
+        batch->remaining = entries.size();
+        
+        // Entries go to idle workers through the job queue. This worker keeps
+        // the first one, and any the full queue turns away, instead of blocking
+        // on a queue that only workers drain.
+        std::vector<Job> local;
+        const auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < entries.size(); i++) {
+            Job entry;
+            entry.arena = arena;
+            entry.received = now;
+            entry.request = std::move(entries[i]);
+            entry.parsed = true;
+            entry.batch = batch;
+            entry.batch_index = i;
+            if (i == 0 || !jobs.try_push(entry)) {
+                local.push_back(std::move(entry));
+            }
+        }
+        for (auto& entry : local) {
+            execute_job(std::move(entry), jobs, responses);
+        }
+    }
+    
+    void Server::finish_batch_entry(Job& job, const json::Value& response, WorkQueue<std::string>& responses) {
+        Batch& batch = *job.batch;
+        std::string& slot = batch.responses[job.batch_index];
+        auto encode_start = std::chrono::steady_clock::now();
+        if (!response.is_null()) {
+            encode_message(response, slot);
+        }
+        job.trace.stringify_ns += elapsed_ns(encode_start);
+        record_request(job.trace, response, slot.size());
+        if (batch.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        
+        std::string out;
+        if (serialize_batch(batch.responses, out)) {
+            batch_metrics_.bytes_out.fetch_add(out.size(), std::memory_order_relaxed);
+            update_max(peak_response_bytes_, out.size());
+            responses.push(std::move(out));
+        }
+    }
+    
+    Server::ToolSlots* Server::find_tool_slots(const json::Value& request) {
+        if (tool_slots_.empty() || !request.is_object()) {
+            return nullptr;
+        }
+        
+        const auto& obj = request.as_object();
+        auto method_it = obj.find("method");
+        auto params_it = obj.find("params");
+        if (method_it == obj.end() || !method_it->second.is_string() || method_it->second.as_string() != "tools/call" ||
+            params_it == obj.end() || !params_it->second.is_object()) {
+            return nullptr;
+        }
+        
+        const auto& params = params_it->second.as_object();
+        auto name_it = params.find("name");
+        if (name_it == params.end() || !name_it->second.is_string()) {
+            return nullptr;
+        }
+        
+        auto slots_it = tool_slots_.find(name_it->second.as_string());
+        return slots_it != tool_slots_.end() ? &slots_it->second : nullptr;
+    }
+    
+    std::shared_ptr<json::Arena> Server::acquire_arena() {
+        std::unique_ptr<json::Arena> arena;
+        {
+            std::lock_guard<std::mutex> lock(arena_pool_mutex_);
+            if (!arena_pool_.empty()) {
+                arena = std::move(arena_pool_.back());
+                arena_pool_.pop_back();
+            }
+        }
+        if (!arena) {
+            arena = std::make_unique<json::Arena>();
+        }
+        
+        // Released by the last job holding it, once its response is encoded
+        return std::shared_ptr<json::Arena>(arena.release(), [this](json::Arena* released) {
+            released->rewind({});
+            std::unique_ptr<json::Arena> owned(released);
+            std::lock_guard<std::mutex> lock(arena_pool_mutex_);
+            if (arena_pool_.size() < 2 * options_.worker_threads) {
+                arena_pool_.push_back(std::move(owned));
+            }
+        });
+    }
+    
+    bool Server::process_message(const std::string& message, std::string& out) {
+        // Everything from the parsed request to the encoded response is
+        // released in one step when this returns
+        json::ArenaScope scope(json::thread_arena());
+        RequestTrace trace;
+        trace.bytes_in = message.size();
+        update_max(peak_request_bytes_, message.size());
+        
+        json::Value response;
+        auto parse_start = std::chrono::steady_clock::now();
+        try {
+            json::Value request = decode_message(message);
+            trace.parse_ns = elapsed_ns(parse_start);
+            
+            json::Array entries;
+            if (take_batch(request, entries)) {
+                record_batch(trace);
+                if (entries.empty()) {
+                    RequestTrace entry_trace;
+                    return finish_response(entry_trace, create_error_response(-32600, "Invalid Request", json::Value()), out);
+                }
                 
-                if (!response.is_null()) {
-                    write_line(json::stringify(response));
+                std::vector<std::string> responses(entries.size());
+                for (size_t i = 0; i < entries.size(); i++) {
+                    json::ArenaScope entry_scope(json::thread_arena());
+                    RequestTrace entry_trace;
+                    json::Value entry_response = handle_request(entries[i], entry_trace);
+                    entry_trace.arena_bytes = scope.used();
+                    auto encode_start = std::chrono::steady_clock::now();
+                    if (!entry_response.is_null()) {
+                        encode_message(entry_response, responses[i]);
+                    }
+                    entry_trace.stringify_ns += elapsed_ns(encode_start);
+                    record_request(entry_trace, entry_response, responses[i].size());
                 }
-            } catch (const std::exception& e) {
-                json::Value error_response = create_error_response(-32700, "Parse error", json::Value());
-                write_line(json::stringify(error_response));
+                
+                const size_t start = out.size();
+                bool written = serialize_batch(responses, out);
+                batch_metrics_.bytes_out.fetch_add(out.size() - start, std::memory_order_relaxed);
+                update_max(peak_response_bytes_, out.size() - start);
+                return written;
             }
+            response = handle_request(request, trace);
+        } catch (const std::exception& e) {
+            trace.parse_ns = elapsed_ns(parse_start);
+            response = create_error_response(-32700, "Parse error", json::Value());
+        }
+        trace.arena_bytes = scope.used();
+        return finish_response(trace, response, out);
+    }
+    
+    // Encodes a response and records the request's trace
+    bool Server::finish_response(RequestTrace& trace, const json::Value& response, std::string& out) {
+        const size_t start = out.size();
+        auto encode_start = std::chrono::steady_clock::now();
+        bool written = serialize_response(response, out);
+        trace.stringify_ns += elapsed_ns(encode_start);
+        record_request(trace, response, out.size() - start);
+        return written;
+    }
+    
+    void Server::record_request(const RequestTrace& trace, const json::Value& response, size_t bytes_out) {
+        EndpointMetrics& m = trace.endpoint ? *trace.endpoint : method_metrics_;
+        m.requests.fetch_add(1, std::memory_order_relaxed);
+        if (trace.error || (response.is_object() && response.as_object().count("error"))) {
+            m.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (trace.bytes_in > 0) {
+            m.bytes_in.fetch_add(trace.bytes_in, std::memory_order_relaxed);
+            m.parse.record(trace.parse_ns);
+        }
+        if (trace.queued) {
+            m.queue.record(trace.queue_ns);
         }
+        m.handler.record(trace.handler_ns);
+        m.stringify.record(trace.stringify_ns);
+        m.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+        update_max(peak_response_bytes_, bytes_out);
+        update_max(peak_arena_bytes_, trace.arena_bytes);
+    }
+    
+    void Server::record_batch(const RequestTrace& trace) {
+        batch_metrics_.requests.fetch_add(1, std::memory_order_relaxed);
+        batch_metrics_.bytes_in.fetch_add(trace.bytes_in, std::memory_order_relaxed);
+        batch_metrics_.parse.record(trace.parse_ns);
+    }
+    
+    json::Value Server::decode_message(const std::string& message) {
+        if (transport_ == Transport::CborFrames) {
+            return cbor::decode(message);
+        }
+        return json::parse(message);
+    }
+    
+    void Server::encode_message(const json::Value& message, std::string& out) {
+        if (transport_ == Transport::CborFrames) {
+            cbor::encode(message, out);
+        } else {
+            json::stringify(message, out);
+        }
+    }
+    
+    // Terminates the message that starts at out[start]. CBOR frames reserve
+    // their length prefix up front and have it filled in here; a payload the
+    // prefix cannot hold throws std::length_error.
+    void Server::frame_message(std::string& out, size_t start) {
+        if (transport_ == Transport::CborFrames) {
+            const size_t size = out.size() - start - 4;
+            if (size > UINT32_MAX) {
+                throw std::length_error("CBOR frame of " + std::to_string(size) + " bytes exceeds the 32-bit length prefix");
+            }
+            const uint32_t len = static_cast<uint32_t>(size);
+            for (int i = 0; i < 4; i++) {
+                out[start + i] = static_cast<char>((len >> (8 * (3 - i))) & 0xff);
+            }
+        } else {
+            out += '\n';
+        }
+    }
+    
+    bool Server::serialize_response(const json::Value& response, std::string& out) {
+        if (response.is_null()) {
+            return false;
+        }
+        
+        const size_t start = out.size();
+        if (transport_ == Transport::CborFrames) {
+            out.append(4, '\0');
+        }
+        encode_message(response, out);
+        try {
+            frame_message(out, start);
+        } catch (const std::length_error&) {
+            out.resize(start);
+            json::Value id;
+            if (response.is_object()) {
+                auto it = response.as_object().find("id");
+                if (it != response.as_object().end()) {
+                    id = it->second;
+                }
+            }
+            return serialize_response(create_error_response(-32603, "Response too large", id), out);
+        }
+        return true;
+    }
+    
+    // Joins already encoded batch entries into one array message; a batch of
+    // notifications only gets no reply
+    bool Server::serialize_batch(const std::vector<std::string>& responses, std::string& out) {
+        size_t count = 0;
+        size_t bytes = 0;
+        for (const auto& response : responses) {
+            if (!response.empty()) {
+                count++;
+                bytes += response.size() + 1;
+            }
+        }
+        if (count == 0) {
+            return false;
+        }
+        
+        const size_t start = out.size();
+        out.reserve(start + bytes + 16);
+        if (transport_ == Transport::CborFrames) {
+            out.append(4, '\0');
+            cbor::encode_array_head(count, out);
+            for (const auto& response : responses) {
+                out += response;
+            }
+        } else {
+            out += '[';
+            bool first = true;
+            for (const auto& response : responses) {
+                if (response.empty()) continue;
+                if (!first) out += ',';
+                out += response;
+                first = false;
+            }
+            out += ']';
+        }
+        try {
+            frame_message(out, start);
+        } catch (const std::length_error&) {
+            out.resize(start);
+            return serialize_response(create_error_response(-32603, "Response too large", json::Value()), out);
+        }
+        return true;
+    }
+    
+    void Server::apply_requested_transport() {
+        transport_ = requested_transport_;
+    }
+    
+    // Routes a request, timing it as the handler phase less any result
+    // encoding the tool call did itself
+    json::Value Server::handle_request(const json::Value& request, RequestTrace& trace) {
+        auto start = std::chrono::steady_clock::now();
+        json::Value response = route_request(request, trace);
+        const uint64_t total = elapsed_ns(start);
+        trace.handler_ns = total > trace.stringify_ns ? total - trace.stringify_ns : 0;
+        return response;
     }
     
-    json::Value Server::handle_request(const json::Value& request) {
+    json::Value Server::route_request(const json::Value& request, RequestTrace& trace) {
         if (!request.is_object()) {
             return create_error_response(-32600, "Invalid Request", json::Value());
         }
@@ -53,9 +554,12 @@ namespace mcp {
             return create_error_response(-32600, "Invalid Request", json::Value());
         }
         
-        std::string method = obj.at("method").as_string();
-        json::Value id = obj.find("id") != obj.end() ? obj.at("id") : json::Value();
-        json::Value params = obj.find("params") != obj.end() ? obj.at("params") : json::Value();
+        static const json::Value null_value;
+        const std::string& method = obj.at("method").as_string();
+        auto id_it = obj.find("id");
+        json::Value id = id_it != obj.end() ? id_it->second : json::Value();
+        auto params_it = obj.find("params");
+        const json::Value& params = params_it != obj.end() ? params_it->second : null_value;
         
         try {
             if (method == "initialize") {
@@ -76,7 +580,11 @@ namespace mcp {
             }
             
             if (method == "tools/call") {
-                return create_success_response(handle_tools_call(params), id);
+                return create_success_response(handle_tools_call(params, trace), id);
+            }
+            
+            if (method == "server/metrics") {
+                return create_success_response(handle_metrics(), id);
             }
             
             return create_error_response(-32601, "Method not found", id);
@@ -86,7 +594,8 @@ namespace mcp {
     }
     
     json::Value Server::handle_initialize(const json::Value& params) {
-        initialized_ = true;
+        // The transport can only be negotiated by the first initialize
+        const bool first = !initialized_.exchange(true);
         
         json::Value result;
         result["protocolVersion"] = "2024-11-05";
@@ -97,6 +606,13 @@ namespace mcp {
         capabilities["resources"]["listChanged"] = false;
         capabilities["prompts"]["listChanged"] = false;
         capabilities["experimental"] = json::Value(json::Object{});
+        capabilities["experimental"]["server/metrics"] = json::Value(json::Object{});
+        if (first && client_requests_cbor(params)) {
+            requested_transport_ = Transport::CborFrames;
+            capabilities["experimental"]["transport"]["encoding"] = "cbor";
+            capabilities["experimental"]["transport"]["framing"] = "uint32-be-length";
+            capabilities["experimental"]["transport"]["typedArrays"] = "rfc8746";
+        }
         
         result["capabilities"] = capabilities;
         
@@ -116,13 +632,16 @@ namespace mcp {
         for (const auto& [name, handler] : tool_handlers_) {
             json::Value tool;
             tool["name"] = name;
-            tool["description"] = tool_descriptions_[name];
-            tool["inputSchema"] = tool_schemas_[name];
+            tool["description"] = tool_descriptions_.at(name);
+            tool["inputSchema"] = tool_schemas_.at(name);
             
-            json::Value output_schema;
-            output_schema["type"] = "object";
-            output_schema["additionalProperties"] = true;
-            tool["outputSchema"] = output_schema;
+            // Text-only tools never send structuredContent, so they must not promise a schema
+            if (tool_options_.at(name).output_mode != OutputMode::TextOnly) {
+                json::Value output_schema;
+                output_schema["type"] = "object";
+                output_schema["additionalProperties"] = true;
+                tool["outputSchema"] = output_schema;
+            }
             
             tools.push_back(tool);
         }
@@ -131,7 +650,7 @@ namespace mcp {
         return result;
     }
     
-    json::Value Server::handle_tools_call(const json::Value& params) {
+    json::Value Server::handle_tools_call(const json::Value& params, RequestTrace& trace) {
         if (!params.is_object()) {
             throw std::runtime_error("Invalid params for tools/call");
         }
@@ -142,48 +661,86 @@ namespace mcp {
             throw std::runtime_error("Missing or invalid tool name");
         }
         
-        std::string tool_name = obj.at("name").as_string();
+        const std::string& tool_name = obj.at("name").as_string();
         
-        if (tool_handlers_.find(tool_name) == tool_handlers_.end()) {
+        auto handler_it = tool_handlers_.find(tool_name);
+        if (handler_it == tool_handlers_.end()) {
             throw std::runtime_error("Unknown tool: " + tool_name);
         }
         
-        json::Value arguments = obj.find("arguments") != obj.end() ? obj.at("arguments") : json::Value();
+        // Arguments are passed by reference so large payloads are never copied
+        static const json::Value null_value;
+        auto args_it = obj.find("arguments");
+        const json::Value& arguments = args_it != obj.end() ? args_it->second : null_value;
         
+        trace.endpoint = tool_metrics_.at(tool_name).get();
+        OutputMode mode = tool_options_.at(tool_name).output_mode;
+        json::Value payload;
         try {
-            json::Value tool_result = tool_handlers_[tool_name](arguments);
-            
+            payload = handler_it->second(arguments);
+        } catch (const std::exception& e) {
+            trace.error = true;
+            payload = json::Value();
+            payload["error"] = e.what();
+        }
+        
+        auto encode_start = std::chrono::steady_clock::now();
+        json::Value result = create_tool_result(std::move(payload), mode);
+        trace.stringify_ns += elapsed_ns(encode_start);
+        return result;
+    }
+    
+    json::Value Server::handle_metrics() {
+        json::Value result;
+        result["uptime_seconds"] = elapsed_ns(started_) / 1e9;
+        
+        json::Value tools = json::Value(json::Object{});
+        for (const auto& [name, metrics] : tool_metrics_) {
+            tools[name] = metrics->to_json();
+        }
+        result["tools"] = std::move(tools);
+        result["methods"] = method_metrics_.to_json();
+        result["batches"] = batch_metrics_.to_json();
+        result["write"] = write_latency_.to_json();
+        result["bytes_written"] = static_cast<double>(bytes_written_.load(std::memory_order_relaxed));
+        result["peak_request_bytes"] = static_cast<double>(peak_request_bytes_.load(std::memory_order_relaxed));
+        result["peak_response_bytes"] = static_cast<double>(peak_response_bytes_.load(std::memory_order_relaxed));
+        result["peak_arena_bytes"] = static_cast<double>(peak_arena_bytes_.load(std::memory_order_relaxed));
+        return result;
+    }
+    
+    json::Value Server::create_tool_result(json::Value payload, OutputMode mode) {
+        // Binary clients read structuredContent; leaving out the JSON text
+        // keeps number arrays as typed arrays end to end
+        if (transport_ == Transport::CborFrames && mode != OutputMode::TextOnly) {
             json::Value result;
-            
-            // Create content array
-            json::Array content;
-            json::Value content_item;
-            content_item["type"] = "text";
-            content_item["text"] = json::stringify(tool_result);
-            content.push_back(content_item);
-            
-            result["content"] = json::Value(content);
+            result["content"] = json::Value(json::Array{});
             result["isError"] = false;
-            result["structuredContent"] = tool_result;
-            
+            result["structuredContent"] = std::move(payload);
             return result;
-        } catch (const std::exception& e) {
-            json::Value error_result;
-            error_result["error"] = e.what();
-            
-            json::Array content;
+        }
+        
+        // Serialize the payload once; the text content and structuredContent
+        // both refer to the same buffer instead of holding separate copies
+        auto text = std::make_shared<std::string>();
+        json::stringify(payload, *text);
+        
+        json::Array content;
+        if (mode != OutputMode::StructuredOnly) {
             json::Value content_item;
             content_item["type"] = "text";
-            content_item["text"] = json::stringify(error_result);
-            content.push_back(content_item);
-            
-            json::Value result;
-            result["content"] = json::Value(content);
-            result["isError"] = false;
-            result["structuredContent"] = error_result;
-            
-            return result;
+            content_item["text"] = json::RawJson{text, true};
+            content.push_back(std::move(content_item));
         }
+        
+        json::Value result;
+        result["content"] = json::Value(std::move(content));
+        result["isError"] = false;
+        if (mode != OutputMode::TextOnly) {
+            result["structuredContent"] = json::RawJson{text, false};
+        }
+        
+        return result;
     }
     
     json::Value Server::create_error_response(int code, const std::string& message, const json::Value& id) {
@@ -199,22 +756,44 @@ namespace mcp {
         return response;
     }
     
-    json::Value Server::create_success_response(const json::Value& result, const json::Value& id) {
+    json::Value Server::create_success_response(json::Value result, const json::Value& id) {
         json::Value response;
         response["jsonrpc"] = "2.0";
         response["id"] = id;
-        response["result"] = result;
+        response["result"] = std::move(result);
         return response;
     }
     
-    std::string Server::read_line() {
-        std::string line;
-        std::getline(std::cin, line);
-        return line;
+    bool Server::read_message(std::string& message) {
+        if (transport_ == Transport::JsonLines) {
+            while (std::getline(std::cin, message)) {
+                if (!message.empty()) return true;
+            }
+            return false;
+        }
+        
+        unsigned char prefix[4];
+        if (!std::cin.read(reinterpret_cast<char*>(prefix), 4)) {
+            return false;
+        }
+        const size_t len = (static_cast<size_t>(prefix[0]) << 24) | (prefix[1] << 16) | (prefix[2] << 8) | prefix[3];
+        // The stream can't be resynchronized past a bogus length, so the session ends here
+        if (len > options_.max_frame_bytes) {
+            std::cerr << "Rejected CBOR frame of " << len << " bytes (limit " << options_.max_frame_bytes << ")"
+                      << std::endl;
+            return false;
+        }
+        message.resize(len);
+        return len == 0 || static_cast<bool>(std::cin.read(&message[0], len));
     }
     
-    void Server::write_line(const std::string& line) {
-        std::cout << line << std::endl;
-        std::cout.flush();
+    void Server::write_output(const std::string& data, bool flush) {
+        auto start = std::chrono::steady_clock::now();
+        std::cout.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (flush) {
+            std::cout.flush();
+        }
+        write_latency_.record(elapsed_ns(start));
+        bytes_written_.fetch_add(data.size(), std::memory_order_relaxed);
     }
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "metrics.hpp"
+#include <algorithm>
+
+namespace mcp {
+    
+    size_t Histogram::bucket_of(uint64_t value) {
+        if (value < static_cast<uint64_t>(kSubBuckets)) {
+            return static_cast<size_t>(value);
+        }
+        const int exponent = 63 - __builtin_clzll(value);
+        const int shift = exponent - kSubBits;
+        const size_t sub = (value >> shift) & (kSubBuckets - 1);
+        return static_cast<size_t>(shift + 1) * kSubBuckets + sub;
+    }
+    
+    uint64_t Histogram::bucket_top(size_t bucket) {
+        if (bucket < static_cast<size_t>(kSubBuckets)) {
+            return bucket;
+        }
+        const int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+        const uint64_t sub = bucket % kSubBuckets;
+        return ((kSubBuckets + sub) << shift) + ((uint64_t(1) << shift) - 1);
+    }
+    
+    void Histogram::record(uint64_t value) {
+        buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        update_max(max_, value);
+    }
+    
+    uint64_t Histogram::quantile(double q) const {
+        const uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(bucket_top(i), max_.load(std::memory_order_relaxed));
+            }
+        }
+        return max_.load(std::memory_order_relaxed);
+    }
+    
+    json::Value Histogram::to_json() const {
+        json::Value result;
+        const uint64_t total = count();
+        result["count"] = static_cast<double>(total);
+        if (total == 0) {
+            return result;
+        }
+        
+        auto us = [](uint64_t ns) { return ns / 1000.0; };
+        result["mean_us"] = us(sum_.load(std::memory_order_relaxed)) / total;
+        result["p50_us"] = us(quantile(0.5));
+        result["p90_us"] = us(quantile(0.9));
+        result["p99_us"] = us(quantile(0.99));
+        result["p999_us"] = us(quantile(0.999));
+        result["max_us"] = us(max_.load(std::memory_order_relaxed));
+        return result;
+    }
+    
+    json::Value EndpointMetrics::to_json() const {
+        json::Value result;
+        result["requests"] = static_cast<double>(requests.load(std::memory_order_relaxed));
+        result["errors"] = static_cast<double>(errors.load(std::memory_order_relaxed));
+        result["bytes_in"] = static_cast<double>(bytes_in.load(std::memory_order_relaxed));
+        result["bytes_out"] = static_cast<double>(bytes_out.load(std::memory_order_relaxed));
+        result["parse"] = parse.to_json();
+        if (queue.count() > 0) {
+            result["queue"] = queue.to_json();
+        }
+        result["handler"] = handler.to_json();
+        result["stringify"] = stringify.to_json();
+        return result;
+    }
+    
+}
@@ -0,0 +1,289 @@
+#include "small_matrix.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MATH_OPS_X86 1
+#endif
+
+namespace math_ops {
+    
+    namespace {
+        
+        bool small_square(MatrixView m) {
+            return m.is_square() && m.rows() >= kSmallMatrixMin && m.rows() <= kSmallMatrixMax;
+        }
+        
+        void check_batch_size(size_t n) {
+            if (n < kSmallMatrixMin || n > kSmallMatrixMax) {
+                throw std::runtime_error("Batched matrices must be between 2x2 and 8x8");
+            }
+        }
+        
+        // One element of W matrices as a GCC/Clang vector: 2 lanes for SSE2,
+        // 4 for AVX2 and 8 for AVX-512. The batched kernels are written
+        // on these directly, so the pivot selects compile to blends instead of
+        // depending on the -O2 vectorizer to if-convert them. Unaligned and
+        // alias-safe so groups can be loaded from anywhere in a plane.
+        template <size_t W>
+        struct Lanes {
+            typedef double vector __attribute__((vector_size(W * sizeof(double))));
+            typedef vector unaligned __attribute__((aligned(sizeof(double)), may_alias));
+        };
+        
+        // The kernels are always inlined into the target-specific entry points
+        // below, so they are compiled for whichever vector width those enable.
+        // They take only pointers, keeping wide vectors out of any call ABI.
+        
+        // One group of products; element e of each operand's group starts at
+        // e * stride
+        template <size_t W, size_t N>
+        __attribute__((always_inline)) inline
+        void multiply_group(size_t stride, const double* a, const double* b, double* out) {
+            using V = typename Lanes<W>::vector;
+            using U = typename Lanes<W>::unaligned;
+            for (size_t i = 0; i < N; i++) {
+                for (size_t j = 0; j < N; j++) {
+                    V acc = *reinterpret_cast<const U*>(a + (i * N) * stride) *
+                            *reinterpret_cast<const U*>(b + j * stride);
+                    for (size_t k = 1; k < N; k++) {
+                        acc += *reinterpret_cast<const U*>(a + (i * N + k) * stride) *
+                               *reinterpret_cast<const U*>(b + (k * N + j) * stride);
+                    }
+                    *reinterpret_cast<U*>(out + (i * N + j) * stride) = acc;
+                }
+            }
+        }
+        
+        // Gaussian elimination with partial pivoting on a group of matrices
+        // at once, as in the scalar determinant<N>, with the pivot search and
+        // row swaps done as per-lane selects
+        template <size_t W, size_t N>
+        __attribute__((always_inline)) inline
+        void determinant_group(size_t stride, const double* in, double* out) {
+            using V = typename Lanes<W>::vector;
+            using U = typename Lanes<W>::unaligned;
+            V m[N * N];
+            for (size_t e = 0; e < N * N; e++) {
+                m[e] = *reinterpret_cast<const U*>(in + e * stride);
+            }
+            
+            const V zero = {};
+            const V one = zero + 1.0;
+            V det = one;
+            for (size_t k = 0; k < N; k++) {
+                V pivot = zero + static_cast<double>(k);
+                V best = m[k * N + k] < zero ? -m[k * N + k] : m[k * N + k];
+                for (size_t r = k + 1; r < N; r++) {
+                    const V v = m[r * N + k] < zero ? -m[r * N + k] : m[r * N + k];
+                    pivot = v > best ? zero + static_cast<double>(r) : pivot;
+                    best = v > best ? v : best;
+                }
+                
+                for (size_t r = k + 1; r < N; r++) {
+                    const auto swap = pivot == zero + static_cast<double>(r);
+                    det = swap ? -det : det;
+                    for (size_t c = k; c < N; c++) {
+                        const V top = m[k * N + c];
+                        const V other = m[r * N + c];
+                        m[k * N + c] = swap ? other : top;
+                        m[r * N + c] = swap ? top : other;
+                    }
+                }
+                
+                // A zero pivot zeroes the determinant; its reciprocal is
+                // taken as 0 so the rest of that lane stays finite
+                const V p = m[k * N + k];
+                det *= p;
+                const auto nonzero = p != zero;
+                const V inverse = nonzero ? one / (nonzero ? p : one) : zero;
+                for (size_t r = k + 1; r < N; r++) {
+                    const V factor = m[r * N + k] * inverse;
+                    for (size_t c = k + 1; c < N; c++) {
+                        m[r * N + c] -= factor * m[k * N + c];
+                    }
+                }
+            }
+            *reinterpret_cast<U*>(out) = det;
+        }
+        
+        // Copies the last `lanes` matrices of SoA data with `count` matrices
+        // into a zero-padded group with stride W
+        template <size_t W, size_t N>
+        __attribute__((always_inline)) inline
+        void gather_tail(size_t count, size_t lanes, const double* in, double* group) {
+            std::fill(group, group + N * N * W, 0.0);
+            for (size_t e = 0; e < N * N; e++) {
+                std::copy(in + e * count + count - lanes, in + (e + 1) * count, group + e * W);
+            }
+        }
+        
+        // Whole batches: full groups straight from the planes, then the last
+        // few matrices padded out to a full group
+        template <size_t W, size_t N>
+        __attribute__((always_inline)) inline
+        void multiply_all(size_t count, const double* a, const double* b, double* out) {
+            const size_t full = count - count % W;
+            for (size_t start = 0; start < full; start += W) {
+                multiply_group<W, N>(count, a + start, b + start, out + start);
+            }
+            if (full < count) {
+                double group_a[N * N * W], group_b[N * N * W], group_out[N * N * W];
+                gather_tail<W, N>(count, count - full, a, group_a);
+                gather_tail<W, N>(count, count - full, b, group_b);
+                multiply_group<W, N>(W, group_a, group_b, group_out);
+                for (size_t e = 0; e < N * N; e++) {
+                    std::copy(group_out + e * W, group_out + e * W + (count - full), out + e * count + full);
+                }
+            }
+        }
+        
+        template <size_t W, size_t N>
+        __attribute__((always_inline)) inline
+        void determinant_all(size_t count, const double* m, double* out) {
+            const size_t full = count - count % W;
+            for (size_t start = 0; start < full; start += W) {
+                determinant_group<W, N>(count, m + start, out + start);
+            }
+            if (full < count) {
+                double group[N * N * W], det[W];
+                gather_tail<W, N>(count, count - full, m, group);
+                determinant_group<W, N>(W, group, det);
+                std::copy(det, det + (count - full), out + full);
+            }
+        }
+        
+        template <size_t N>
+        void multiply_generic(size_t count, const double* a, const double* b, double* out) {
+            multiply_all<2, N>(count, a, b, out);
+        }
+        
+        template <size_t N>
+        void determinant_generic(size_t count, const double* m, double* out) {
+            determinant_all<2, N>(count, m, out);
+        }
+        
+#ifdef MATH_OPS_X86
+        template <size_t N>
+        __attribute__((target("avx2,fma")))
+        void multiply_avx2(size_t count, const double* a, const double* b, double* out) {
+            multiply_all<4, N>(count, a, b, out);
+        }
+        
+        template <size_t N>
+        __attribute__((target("avx2,fma")))
+        void determinant_avx2(size_t count, const double* m, double* out) {
+            determinant_all<4, N>(count, m, out);
+        }
+        
+        template <size_t N>
+        __attribute__((target("avx512f")))
+        void multiply_avx512(size_t count, const double* a, const double* b, double* out) {
+            multiply_all<8, N>(count, a, b, out);
+        }
+        
+        template <size_t N>
+        __attribute__((target("avx512f")))
+        void determinant_avx512(size_t count, const double* m, double* out) {
+            determinant_all<8, N>(count, m, out);
+        }
+#endif
+        
+        enum class LaneWidth { Generic, Avx2, Avx512 };
+        
+        LaneWidth select_lane_width() {
+            static const LaneWidth width = [] {
+#ifdef MATH_OPS_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f")) {
+                    return LaneWidth::Avx512;
+                }
+                if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                    return LaneWidth::Avx2;
+                }
+#endif
+                return LaneWidth::Generic;
+            }();
+            return width;
+        }
+        
+    }
+    
+    bool small_multiply(MatrixView a, MatrixView b, double* out) {
+        if (!small_square(a) || !small_square(b) || a.rows() != b.rows()) {
+            return false;
+        }
+        return dispatch_small_size(a.rows(), [&](auto size) {
+            constexpr size_t N = decltype(size)::value;
+            auto c = multiply(SmallMatrix<N, N>::from_view(a), SmallMatrix<N, N>::from_view(b));
+            std::copy(c.data.begin(), c.data.end(), out);
+        });
+    }
+    
+    bool small_determinant(MatrixView m, double& det) {
+        if (!small_square(m)) {
+            return false;
+        }
+        return dispatch_small_size(m.rows(), [&](auto size) {
+            constexpr size_t N = decltype(size)::value;
+            det = determinant(SmallMatrix<N, N>::from_view(m));
+        });
+    }
+    
+    void batch_multiply_soa(size_t n, size_t count, const double* a, const double* b, double* out) {
+        check_batch_size(n);
+        dispatch_small_size(n, [&](auto size) {
+            constexpr size_t N = decltype(size)::value;
+            switch (select_lane_width()) {
+#ifdef MATH_OPS_X86
+                case LaneWidth::Avx512: multiply_avx512<N>(count, a, b, out); return;
+                case LaneWidth::Avx2: multiply_avx2<N>(count, a, b, out); return;
+#endif
+                default: multiply_generic<N>(count, a, b, out); return;
+            }
+        });
+    }
+    
+    void batch_transpose_soa(size_t n, size_t count, const double* m, double* out) {
+        check_batch_size(n);
+        // In SoA form a transpose only permutes the element planes
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                std::memcpy(out + (j * n + i) * count, m + (i * n + j) * count, count * sizeof(double));
+            }
+        }
+    }
+    
+    void batch_determinant_soa(size_t n, size_t count, const double* m, double* out) {
+        check_batch_size(n);
+        dispatch_small_size(n, [&](auto size) {
+            constexpr size_t N = decltype(size)::value;
+            switch (select_lane_width()) {
+#ifdef MATH_OPS_X86
+                case LaneWidth::Avx512: determinant_avx512<N>(count, m, out); return;
+                case LaneWidth::Avx2: determinant_avx2<N>(count, m, out); return;
+#endif
+                default: determinant_generic<N>(count, m, out); return;
+            }
+        });
+    }
+    
+    void aos_to_soa(size_t elements, size_t count, const double* in, double* out) {
+        for (size_t b = 0; b < count; b++) {
+            for (size_t e = 0; e < elements; e++) {
+                out[e * count + b] = in[b * elements + e];
+            }
+        }
+    }
+    
+    void soa_to_aos(size_t elements, size_t count, const double* in, double* out) {
+        for (size_t e = 0; e < elements; e++) {
+            for (size_t b = 0; b < count; b++) {
+                out[b * elements + e] = in[e * count + b];
+            }
+        }
+    }
+
+}
@@ -0,0 +1,302 @@
+#include "statistics_sketch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace math_ops {
+    
+    void MomentSummary::merge(const MomentSummary& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        const double n = static_cast<double>(count + other.count);
+        const double delta = other.mean - mean;
+        mean += delta * (other.count / n);
+        m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / n);
+        count += other.count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    
+    MomentSummary summarize_moments(const double* data, size_t n, bool with_m2) {
+        // One fused sum/min/max sweep per block, then a centred sweep over the
+        // same block while it is still in cache
+        constexpr size_t block = 1024;
+        MomentSummary total;
+        
+        for (size_t i0 = 0; i0 < n; i0 += block) {
+            const double* x = data + i0;
+            const size_t len = std::min(block, n - i0);
+            
+            double sum = 0.0;
+            double lo = x[0];
+            double hi = x[0];
+            for (size_t i = 0; i < len; i++) {
+                sum += x[i];
+                lo = x[i] < lo ? x[i] : lo;
+                hi = x[i] > hi ? x[i] : hi;
+            }
+            
+            MomentSummary part;
+            part.count = len;
+            part.mean = sum / len;
+            part.min = lo;
+            part.max = hi;
+            if (with_m2) {
+                double m2 = 0.0;
+                for (size_t i = 0; i < len; i++) {
+                    double d = x[i] - part.mean;
+                    m2 += d * d;
+                }
+                part.m2 = m2;
+            }
+            total.merge(part);
+        }
+        
+        return total;
+    }
+    
+    TDigest::TDigest(double compression) : compression_(compression) {
+        if (!(compression >= 10.0 && compression <= 10000.0)) {
+            throw std::runtime_error("t-digest compression must be between 10 and 10000");
+        }
+    }
+    
+    double TDigest::scale_k(double q) const {
+        return compression_ / (2.0 * M_PI) * std::asin(2.0 * q - 1.0);
+    }
+    
+    double TDigest::scale_q(double k) const {
+        double limit = compression_ / 4.0;
+        if (k >= limit) return 1.0;
+        if (k <= -limit) return 0.0;
+        return (std::sin(k * 2.0 * M_PI / compression_) + 1.0) / 2.0;
+    }
+    
+    void TDigest::add(const double* data, size_t n) {
+        const size_t flush_at = static_cast<size_t>(compression_ * 10);
+        for (size_t i = 0; i < n; i++) {
+            buffer_.push_back({data[i], 1.0});
+            min_ = std::min(min_, data[i]);
+            max_ = std::max(max_, data[i]);
+            if (buffer_.size() >= flush_at) {
+                flush();
+            }
+        }
+        total_weight_ += n;
+    }
+    
+    void TDigest::merge(const TDigest& other) {
+        other.flush();
+        buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+        total_weight_ += other.total_weight_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        flush();
+    }
+    
+    const std::vector<TDigest::Centroid>& TDigest::centroids() const {
+        flush();
+        return centroids_;
+    }
+    
+    // Folds buffered points into the centroid list: sort everything by mean
+    // and greedily merge neighbours while the merged centroid spans at most
+    // one unit of the scale function
+    void TDigest::flush() const {
+        if (buffer_.empty()) return;
+        
+        buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+        std::sort(buffer_.begin(), buffer_.end(),
+                  [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+        
+        double total = 0.0;
+        for (const auto& c : buffer_) total += c.weight;
+        
+        centroids_.clear();
+        Centroid current = buffer_[0];
+        double weight_before = 0.0;
+        double q_limit = scale_q(scale_k(0.0) + 1.0) * total;
+        
+        for (size_t i = 1; i < buffer_.size(); i++) {
+            const Centroid& next = buffer_[i];
+            if (weight_before + current.weight + next.weight <= q_limit) {
+                current.weight += next.weight;
+                current.mean += (next.mean - current.mean) * next.weight / current.weight;
+            } else {
+                weight_before += current.weight;
+                centroids_.push_back(current);
+                q_limit = scale_q(scale_k(weight_before / total) + 1.0) * total;
+                current = next;
+            }
+        }
+        centroids_.push_back(current);
+        buffer_.clear();
+    }
+    
+    double TDigest::quantile(double q) const {
+        flush();
+        if (centroids_.empty()) {
+            throw std::runtime_error("Cannot estimate quantiles of an empty digest");
+        }
+        q = std::clamp(q, 0.0, 1.0);
+        if (centroids_.size() == 1) {
+            return centroids_[0].mean;
+        }
+        
+        // Interpolate between centroid centres, anchoring the ends at min/max
+        const double target = q * total_weight_;
+        const Centroid& first = centroids_.front();
+        if (target < first.weight / 2.0) {
+            return min_ + (first.mean - min_) * (target / (first.weight / 2.0));
+        }
+        
+        double cumulative = first.weight / 2.0;
+        for (size_t i = 0; i + 1 < centroids_.size(); i++) {
+            const Centroid& left = centroids_[i];
+            const Centroid& right = centroids_[i + 1];
+            double step = (left.weight + right.weight) / 2.0;
+            if (target < cumulative + step) {
+                double t = (target - cumulative) / step;
+                return left.mean + t * (right.mean - left.mean);
+            }
+            cumulative += step;
+        }
+        
+        const Centroid& last = centroids_.back();
+        double tail = total_weight_ - cumulative;
+        if (tail <= 0.0) {
+            return max_;
+        }
+        return last.mean + (max_ - last.mean) * std::min(1.0, (target - cumulative) / tail);
+    }
+    
+    double TDigest::rank_error(double q) const {
+        flush();
+        if (centroids_.empty() || total_weight_ <= 0.0) {
+            return 0.0;
+        }
+        
+        // Interpolation error is bounded by the weight of the centroid that
+        // spans the requested rank
+        const double target = std::clamp(q, 0.0, 1.0) * total_weight_;
+        double cumulative = 0.0;
+        for (const auto& c : centroids_) {
+            cumulative += c.weight;
+            if (target <= cumulative) {
+                return c.weight / 2.0 / total_weight_;
+            }
+        }
+        return centroids_.back().weight / 2.0 / total_weight_;
+    }
+    
+    TDigest TDigest::from_centroids(double compression, std::vector<Centroid> centroids, double min, double max) {
+        TDigest digest(compression);
+        for (const auto& c : centroids) {
+            if (!(c.weight > 0.0)) {
+                throw std::runtime_error("t-digest centroid weights must be positive");
+            }
+            digest.total_weight_ += c.weight;
+        }
+        digest.buffer_ = std::move(centroids);
+        digest.min_ = min;
+        digest.max_ = max;
+        digest.flush();
+        return digest;
+    }
+    
+    void StatisticsSummary::merge(const StatisticsSummary& other) {
+        moments.merge(other.moments);
+        digest.merge(other.digest);
+    }
+    
+    StatisticsSummary summarize(VectorView data, double compression) {
+        StatisticsSummary summary{MomentSummary(), TDigest(compression)};
+        if (!data.empty()) {
+            summary.moments = summarize_moments(data.data(), data.size());
+            summary.digest.add(data.data(), data.size());
+        }
+        return summary;
+    }
+    
+    json::Value summary_to_json(const StatisticsSummary& summary) {
+        const auto& centroids = summary.digest.centroids();
+        json::NumberArray means;
+        json::NumberArray weights;
+        means.reserve(centroids.size());
+        weights.reserve(centroids.size());
+        for (const auto& c : centroids) {
+            means.push_back(c.mean);
+            weights.push_back(c.weight);
+        }
+        
+        json::Value result;
+        result["type"] = "tdigest_summary";
+        result["count"] = static_cast<double>(summary.moments.count);
+        result["mean"] = summary.moments.mean;
+        result["m2"] = summary.moments.m2;
+        if (summary.moments.count > 0) {
+            result["minimum"] = summary.moments.min;
+            result["maximum"] = summary.moments.max;
+        }
+        result["compression"] = summary.digest.compression();
+        result["centroid_means"] = json::Value(std::move(means));
+        result["centroid_weights"] = json::Value(std::move(weights));
+        return result;
+    }
+    
+    StatisticsSummary json_to_summary(const json::Value& json_val) {
+        if (!json_val.is_object()) {
+            throw std::runtime_error("Expected summary object");
+        }
+        const auto& obj = json_val.as_object();
+        
+        auto number = [&](const char* key, bool required) -> double {
+            auto it = obj.find(key);
+            if (it == obj.end()) {
+                if (required) throw std::runtime_error(std::string("Summary is missing '") + key + "'");
+                return 0.0;
+            }
+            if (it->second.is_int()) return it->second.as_int();
+            if (it->second.is_double()) return it->second.as_double();
+            throw std::runtime_error(std::string("Summary field '") + key + "' must be a number");
+        };
+        auto numbers = [&](const char* key) -> json::NumberArray {
+            auto it = obj.find(key);
+            if (it == obj.end()) throw std::runtime_error(std::string("Summary is missing '") + key + "'");
+            if (it->second.is_number_array()) return it->second.as_number_array();
+            if (it->second.is_array() && it->second.as_array().empty()) return {};
+            throw std::runtime_error(std::string("Summary field '") + key + "' must be an array of numbers");
+        };
+        
+        double count = number("count", true);
+        if (count < 0 || count != std::floor(count)) {
+            throw std::runtime_error("Summary count must be a non-negative integer");
+        }
+        
+        MomentSummary moments;
+        moments.count = static_cast<size_t>(count);
+        moments.mean = number("mean", true);
+        moments.m2 = number("m2", true);
+        if (moments.count > 0) {
+            moments.min = number("minimum", true);
+            moments.max = number("maximum", true);
+        }
+        
+        json::NumberArray means = numbers("centroid_means");
+        json::NumberArray weights = numbers("centroid_weights");
+        if (means.size() != weights.size()) {
+            throw std::runtime_error("Summary centroid arrays must have equal length");
+        }
+        std::vector<TDigest::Centroid> centroids(means.size());
+        for (size_t i = 0; i < means.size(); i++) {
+            centroids[i] = {means[i], weights[i]};
+        }
+        
+        double compression = obj.count("compression") ? number("compression", true) : 100.0;
+        return StatisticsSummary{moments, TDigest::from_centroids(compression, std::move(centroids), moments.min, moments.max)};
+    }
+    
+}
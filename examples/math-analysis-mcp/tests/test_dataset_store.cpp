@@ -0,0 +1,65 @@
+// Tests of how the dataset store resolves and keeps tool array arguments
+#include "dataset_store.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    
+    int failures = 0;
+    
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            failures++;                                                                     \
+        }                                                                                   \
+    } while (0)
+    
+    void test_inline_vectors_are_borrowed() {
+        math_ops::DatasetStore store(1 << 20);
+        json::Value arg = json::parse("[1.5, 2, 3.25]");
+        CHECK(arg.is_number_array());
+        
+        auto data = store.resolve_vector(arg);
+        CHECK(data.values == arg.as_number_array().data());
+        CHECK(!data.owner && !data.is_matrix && data.cols == 3);
+        
+        // storing a borrowed view copies it, so the handle outlives the request
+        std::string handle = store.put(data);
+        auto stored = store.get(handle);
+        CHECK(stored.owner != nullptr);
+        CHECK(stored.values != arg.as_number_array().data());
+        CHECK(stored.cols == 3 && stored.values[2] == 3.25);
+        arg = json::Value();
+        CHECK(store.get(handle).values[0] == 1.5);
+    }
+    
+    void test_mixed_arrays_are_converted() {
+        math_ops::DatasetStore store(1 << 20);
+        json::Value arg = json::parse("[1, 2.5, 3]");
+        auto data = store.resolve_vector(arg);
+        CHECK(data.cols == 3 && data.values[1] == 2.5);
+        
+        auto matrix = store.resolve_matrix(json::parse("[[1, 2], [3, 4]]"));
+        CHECK(matrix.is_matrix && matrix.owner != nullptr && matrix.values[3] == 4);
+        
+        bool threw = false;
+        try {
+            store.resolve_matrix(json::parse("[1, 2]"));
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+    
+}
+
+int main() {
+    test_inline_vectors_are_borrowed();
+    test_mixed_arrays_are_converted();
+    if (failures == 0) {
+        std::cout << "All dataset store tests passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// Tests of the file inputs of the math tools (raw and .npy files; HDF5 when built with it)
+#include "file_input.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    
+    int failures = 0;
+    
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            failures++;                                                                     \
+        }                                                                                   \
+    } while (0)
+    
+    // A file under /tmp removed at the end of the scope
+    struct TempFile {
+        std::string path;
+        
+        TempFile(const std::string& name, const std::string& bytes)
+            : path("/tmp/math_tests." + std::to_string(getpid()) + "." + name) {
+            std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        
+        ~TempFile() { std::remove(path.c_str()); }
+    };
+    
+    std::string doubles(const std::vector<double>& values) {
+        return std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+    }
+    
+    // Runs read_array_file on spec and returns the error message, empty if it succeeded
+    std::string read_error(const std::string& spec) {
+        try {
+            math_ops::read_array_file(json::parse(spec));
+        } catch (const std::exception& e) {
+            return e.what();
+        }
+        return std::string();
+    }
+    
+    std::string npy(const std::string& shape, const std::string& body) {
+        std::string header = "{'descr': '<f8', 'fortran_order': False, 'shape': (" + shape + "), }";
+        header.append(64 - (10 + header.size() + 1) % 64, ' ');
+        header += '\n';
+        std::string out = "\x93NUMPY";
+        out += '\x01';
+        out += '\x00';
+        out += static_cast<char>(header.size() & 0xff);
+        out += static_cast<char>(header.size() >> 8);
+        return out + header + body;
+    }
+    
+    void test_raw_shapes() {
+        TempFile file("raw.bin", doubles({1, 2, 3, 4, 5, 6}));
+        auto data = math_ops::read_array_file(json::parse("{\"path\": \"" + file.path + "\", \"shape\": [2, 3]}"));
+        CHECK(data.is_matrix && data.rows == 2 && data.cols == 3);
+        CHECK(data.mapped);
+        CHECK(data.values[5] == 6);
+        
+        CHECK(read_error("{\"path\": \"" + file.path + "\", \"shape\": [4, 3]}").find("too small") != std::string::npos);
+    }
+    
+    void test_oversized_shapes() {
+        TempFile file("raw.bin", doubles({1, 2, 3, 4}));
+        // rows * cols wraps to 0, which passed the size check before the overflow guard
+        CHECK(read_error("{\"path\": \"" + file.path + "\", \"shape\": [4294967296, 4294967296]}")
+              .find("too large") != std::string::npos);
+        // the element count fits in size_t, its size in bytes does not
+        CHECK(read_error("{\"path\": \"" + file.path + "\", \"shape\": [2305843009213693952]}")
+              .find("too large") != std::string::npos);
+        CHECK(read_error("{\"path\": \"" + file.path + "\", \"dtype\": \"uint8\", \"shape\": [0, 18446744073709549568]}")
+              .empty());
+        
+        TempFile header("big.npy", npy("4294967296, 4294967296", doubles({1, 2})));
+        CHECK(read_error("{\"path\": \"" + header.path + "\"}").find("too large") != std::string::npos);
+        TempFile fine("fine.npy", npy("1, 2", doubles({1, 2})));
+        CHECK(read_error("{\"path\": \"" + fine.path + "\"}").empty());
+    }
+    
+}
+
+int main() {
+    test_raw_shapes();
+    test_oversized_shapes();
+    if (failures == 0) {
+        std::cout << "All file input tests passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}